@@ -1,80 +1,114 @@
-#ifndef ARP_H
-#define ARP_H
-
-#include <stdint.h>
-#include <time.h>
-#include "config.h"
-#include "net.h"
-#include "utils.h"
-#define ARP_HW_ETHER 0x1 // 以太网
-#define ARP_REQUEST 0x1  // ARP请求包
-#define ARP_REPLY 0x2    // ARP响应包
-
-typedef enum arp_state
-{
-    ARP_PENDING, //等待响应
-    ARP_VALID,   //有效
-    ARP_INVALID, //无效
-} arp_state_t;
-
-typedef struct arp_entry
-{
-    arp_state_t state;        //状态
-    time_t timeout;           //超时时间戳
-    uint8_t ip[NET_IP_LEN];   //ip地址
-    uint8_t mac[NET_MAC_LEN]; //mac地址
-} arp_entry_t;
-
-typedef struct arp_buf
-{
-    int valid;               //有效位
-    buf_t buf;               //数据包
-    uint8_t ip[NET_IP_LEN];  //目的ip地址
-    net_protocol_t protocol; //上层协议
-} arp_buf_t;
-
-#pragma pack(1)
-typedef struct arp_pkt
-{
-    uint16_t hw_type, pro_type;      // 硬件类型和协议类型
-    uint8_t hw_len, pro_len;         // 硬件地址长 + 协议地址长
-    uint16_t opcode;                 // 请求/响应
-    uint8_t sender_mac[NET_MAC_LEN]; // 发送包硬件地址
-    uint8_t sender_ip[NET_IP_LEN];   // 发送包协议地址
-    uint8_t target_mac[NET_MAC_LEN]; // 接收方硬件地址
-    uint8_t target_ip[NET_IP_LEN];   // 接收方协议地址
-} arp_pkt_t;
-
-#pragma pack()
-
-/**
- * @brief 初始化arp协议
- * 
- */
-void arp_init();
-
-/**
- * @brief 处理一个收到的数据包
- * 
- * @param buf 要处理的数据包
- */
-void arp_in(buf_t *buf);
-
-/**
- * @brief 处理一个要发送的数据包
- * 
- * @param buf 要处理的数据包
- * @param ip 目标ip地址
- * @param protocol 上层协议
- */
-void arp_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol);
-
-/**
- * @brief 更新arp表
- * 
- * @param ip ip地址
- * @param mac mac地址
- * @param state 表项的状态
- */
-void arp_update(uint8_t *ip, uint8_t *mac, arp_state_t state);
+#ifndef ARP_H
+#define ARP_H
+
+#include <stdint.h>
+#include <time.h>
+#include "config.h"
+#include "net.h"
+#include "utils.h"
+#include "timer.h"
+#define ARP_HW_ETHER 0x1 // 以太网
+#define ARP_REQUEST 0x1  // ARP请求包
+#define ARP_REPLY 0x2    // ARP响应包
+
+typedef enum arp_state
+{
+    ARP_PENDING, //等待响应
+    ARP_VALID,   //有效
+    ARP_INVALID, //无效
+} arp_state_t;
+
+typedef struct arp_entry
+{
+    arp_state_t state;        //状态
+    uint64_t timeout;         //加入表的时间(毫秒，单调时钟)，等待响应时为上次发送arp请求的时间
+    uint8_t ip[NET_IP_LEN];   //ip地址
+    uint8_t mac[NET_MAC_LEN]; //mac地址
+    uint8_t referenced;       //CLOCK置换算法的访问位
+    uint8_t retries;          //等待响应时已重传arp请求的次数
+    uint16_t pending_nr;      //等待队列中的数据包数
+    buf_t *pending;           //等待地址解析的数据包队列，通过buf->next链接，持有引用，上层协议记在buf->protocol
+    buf_t *pending_tail;      //等待队列尾
+    timer_entry_t timer;      //有效时为老化定时器，等待响应时为重传定时器
+} arp_entry_t;
+
+/**
+ * @brief arp层状态，每个协议栈实例一份
+ *        表项连续存放，另用开放寻址的哈希索引按ip地址定位表项
+ * 
+ */
+typedef struct arp_layer
+{
+    arp_entry_t *table;       //arp地址转换表
+    int table_size;           //arp表容量
+    struct arp_index *index;  //哈希索引，线性探测，大小为2的幂且不小于容量的2倍
+    uint32_t index_mask;
+    int index_shift;          //哈希值取乘积的高位
+    int *free_slots;          //空闲表项栈
+    int free_nr;
+    int clock_hand;           //CLOCK置换算法的指针
+} arp_layer_t;
+
+
+#pragma pack(1)
+typedef struct arp_pkt
+{
+    uint16_t hw_type, pro_type;      // 硬件类型和协议类型
+    uint8_t hw_len, pro_len;         // 硬件地址长 + 协议地址长
+    uint16_t opcode;                 // 请求/响应
+    uint8_t sender_mac[NET_MAC_LEN]; // 发送包硬件地址
+    uint8_t sender_ip[NET_IP_LEN];   // 发送包协议地址
+    uint8_t target_mac[NET_MAC_LEN]; // 接收方硬件地址
+    uint8_t target_ip[NET_IP_LEN];   // 接收方协议地址
+} arp_pkt_t;
+
+#pragma pack()
+
+/**
+ * @brief 初始化arp协议
+ * 
+ * @return int 成功为0，失败为-1
+ */
+int arp_init();
+
+/**
+ * @brief 处理一个收到的数据包
+ * 
+ * @param buf 要处理的数据包
+ */
+void arp_in(buf_t *buf);
+
+/**
+ * @brief 处理一个要发送的数据包
+ * 
+ * @param buf 要处理的数据包
+ * @param ip 目标ip地址
+ * @param protocol 上层协议
+ */
+void arp_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol);
+
+/**
+ * @brief 从arp表中根据ip地址查找mac地址
+ * 
+ * @param ip 欲转换的ip地址
+ * @return uint8_t* mac地址，未找到时为NULL
+ */
+uint8_t *arp_lookup(uint8_t *ip);
+
+/**
+ * @brief 更新arp表
+ * 
+ * @param ip ip地址
+ * @param mac mac地址
+ * @param state 表项的状态
+ */
+void arp_update(uint8_t *ip, uint8_t *mac, arp_state_t state);
+
+/**
+ * @brief 按给定容量重新分配arp表，原有表项全部清空
+ * 
+ * @param max_entry arp表容量
+ * @return int 成功为0，失败为-1
+ */
+int arp_table_init(int max_entry);
 #endif
\ No newline at end of file
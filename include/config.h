@@ -1,31 +1,101 @@
-#ifndef CONFIG_H
-#define CONFIG_H
-
-#define DRIVER_IF_NAME "ens33" //使用的物理网卡名称\
-
-/* #define DRIVER_IF_IP      \
-    {                     \
-        192, 168, 163, 103 \
-    } //自定义网卡ip地址 */
-#define DRIVER_IF_IP      \
-    {                     \
-        192, 168, 133, 103 \
-    } //自定义网卡ip地址
-
-#define DRIVER_IF_MAC                      \
-    {                                      \
-        0x11, 0x22, 0x33, 0x44, 0x55, 0x66 \
-    }                     //自定义网卡mac地址
-
-
-#define ETHERNET_MTU 1500 //以太网最大传输单元
-
-#define ARP_MAX_ENTRY 16       //arp表最大长度
-#define ARP_TIMEOUT_SEC 60 * 5 //arp表过期时间
-#define ARP_MIN_INTERVAL 1     //向相同地址发送arp请求的最小间隔
-
-#define IP_DEFALUT_TTL 64 //IP默认TTL
-
-#define UDP_MAX_HANDLER 16 //最多的UDP处理程序数
-
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#define DRIVER_IF_NAME "ens33" //使用的物理网卡名称\
+
+/* #define DRIVER_IF_IP      \
+    {                     \
+        192, 168, 163, 103 \
+    } //自定义网卡ip地址 */
+#define DRIVER_IF_IP      \
+    {                     \
+        192, 168, 133, 103 \
+    } //自定义网卡ip地址
+#define DRIVER_IF_PREFIX_LEN 24 //网卡所在子网的前缀长度，初始化时添加对应的直连路由
+#define DRIVER_IF_GATEWAY \
+    {                     \
+        0, 0, 0, 0        \
+    } //默认网关，全0时默认路由按直连处理，所有目的地址都直接arp
+
+#define DRIVER_IF_MAC                      \
+    {                                      \
+        0x11, 0x22, 0x33, 0x44, 0x55, 0x66 \
+    }                     //自定义网卡mac地址
+
+#define DRIVER_PCAP 0    //libpcap驱动
+#define DRIVER_TPACKET 1 //AF_PACKET TPACKET_V3 mmap接收环驱动
+#define DRIVER_TAP 2     //TAP虚拟网卡驱动，不需要物理网卡
+
+#ifndef DRIVER_TYPE
+#define DRIVER_TYPE DRIVER_PCAP //使用的网卡驱动，编译时可用-DDRIVER_TYPE=DRIVER_TPACKET或DRIVER_TAP切换
+#endif
+
+#define TPACKET_BLOCK_SIZE (1 << 20) //接收环每个块的大小，必须为页大小的整数倍
+#define TPACKET_BLOCK_NR 16          //接收环块数
+#define TPACKET_FRAME_SIZE 2048      //接收环帧大小(仅用于计算帧数，V3中帧长度可变)
+#define TPACKET_BLOCK_TIMEOUT 10     //块未填满时交给用户态的超时时间(毫秒)
+
+#define TAP_IF_NAME "tap0" //TAP虚拟网卡名称，不存在时自动创建
+#define TAP_OFFLOAD 1      //TAP驱动是否通过virtio-net头部把UDP校验和与分片交给内核
+#ifndef DRIVER_TX_OFFLOAD
+#define DRIVER_TX_OFFLOAD (DRIVER_TYPE == DRIVER_TAP && TAP_OFFLOAD) //驱动能否替协议栈计算UDP校验和并分片
+#endif
+
+#define ETHERNET_MTU 1500 //以太网默认最大传输单元，每块网卡可在运行时用ethernet_set_mtu()修改
+#define ETHERNET_MIN_MTU 68                   //网卡MTU下限(IPv4要求的最小值)
+#define ETHERNET_MAX_MTU (BUF_JUMBO_LEN - 14) //网卡MTU上限，巨型帧
+#define ETHERNET_RX_BATCH 32 //一次批量接收的最大数据包数
+#define ETHERNET_TX_BATCH 64 //发送队列长度，队列满或批量发送结束时一次交给驱动
+
+#define BUF_HEADROOM 128   //缓冲区数据前预留的协议头空间
+#define BUF_JUMBO_LEN 9014 //巨型帧缓冲区的数据长度(9000字节MTU + 以太网帧报头)
+#define BUF_SLAB_NR 64     //缓冲池不够时一次向系统申请的缓冲区个数
+#define BUF_THREAD_CACHE_SIZE (8 << 20) //协议栈线程以外的线程各自缓存的buffer最多占用的内存
+
+#define NET_POLL_BUDGET 64 //一次协议栈轮询最多处理的数据包数
+#define NET_BURST_MAX 256  //各层一次成批处理的最大数据包数，更多时分段处理
+#define NET_EVENT_LOOP 1          //主循环使用epoll事件循环，为0时一直轮询
+#define NET_BUSY_POLL_USEC 50     //收到数据包后继续忙轮询的时间(微秒)，之后阻塞等待
+#define TIMER_TICK_MS 10           //时间轮的精度(毫秒)，定时器(如arp表老化)在到期后的第一次协议栈轮询中处理
+
+#define RSS_WORKERS 0       //大于0时启用软件RSS：一个接收线程按流哈希把数据帧分发给这么多个工作线程
+#define RSS_MAX_WORKERS 64  //工作线程数上限
+#define RSS_QUEUE_SIZE 1024 //每个工作线程的分发队列长度，必须为2的幂
+
+#define ARP_MAX_ENTRY 1024     //arp表默认容量，运行时可用arp_table_init()调整
+#define ARP_TIMEOUT_SEC 60 * 5 //arp表过期时间
+#define ARP_MIN_INTERVAL 1     //向相同地址发送arp请求的最小间隔(秒)，重传间隔从它开始逐次加倍
+#define ARP_MAX_RETRY 3        //arp请求的最多重传次数，仍无响应时丢弃等待的数据包
+#define ARP_PENDING_MAX 64     //每个未解析地址最多缓存的数据包数，足够容纳最大udp包的全部分片
+
+#define IP_DEFALUT_TTL 64 //IP默认TTL
+#define IP_FRAG_TIMEOUT_SEC 30      //分片重组超时时间
+#ifndef IP_FRAG_MEM_MAX
+#define IP_FRAG_MEM_MAX (4 << 20)   //分片重组占用内存上限，超过时先淘汰最早的数据报
+#endif
+#define IP_FRAG_HASH_SIZE 256       //分片重组哈希表桶数，必须为2的幂
+#ifndef IP_LOOPBACK                 //测试在CMakeLists.txt中显式指定，ip_frag关闭、ip_loopback打开
+#define IP_LOOPBACK 1               //发给本机ip的数据报不经过arp和驱动，直接放入环回队列交给接收方
+#endif
+#define IP_LOOPBACK_QUEUE 256       //环回队列长度，满时丢弃
+
+#define ICMP_ERR_RATE 1000        //全局每秒最多发送的icmp差错报文数，为0时不限速
+#define ICMP_ERR_BURST 100        //全局令牌桶容量，即允许的突发数
+#define ICMP_ERR_SRC_RATE 10      //向同一源地址每秒最多发送的icmp差错报文数，为0时不限速
+#define ICMP_ERR_SRC_BURST 10     //每个源地址令牌桶的容量
+#define ICMP_ERR_SRC_BUCKETS 1024 //按源地址哈希的令牌桶数，必须为2的幂
+#define ICMP_ECHO_MAX 256         //同时等待应答的回显请求数上限，必须为2的幂
+#define ICMP_ECHO_TIMEOUT_MS 1000 //回显请求等待应答的时间(毫秒)，超过后认为丢失
+
+#define ROUTE_MAX 4096       //路由表容量
+#define ROUTE_CACHE_SIZE 256 //按目的地址直接映射的路由缓存项数，必须为2的幂
+#define IP_PMTU_DISC 0           //为1时不分片发送的数据报设置DF位，由路径上的路由器回送"需要分片"来发现路径MTU
+#define PMTU_CACHE_SIZE 256      //按目的地址直接映射的路径MTU缓存项数，必须为2的幂
+#define PMTU_TIMEOUT_SEC (60 * 10) //路径MTU的有效期，过期后重新使用路由MTU探测
+#define PMTU_MIN 552             //接受的最小路径MTU，防止伪造的icmp报文把MTU压得过小
+
+#define UDP_RING_SIZE 1024 //以接收队列方式打开udp端口时的默认队列长度
+#define UDP_FLOW_CACHE_SIZE 256 //早期分流的流缓存项数，必须为2的幂
+#define UDP_CONN_REFRESH_MS 1000 //已连接的udp流重新查找路由和arp表的间隔(毫秒)，期间使用缓存的mac地址
+
 #endif
\ No newline at end of file
@@ -1,35 +1,84 @@
-#ifndef DRIVER_H
-#define DRIVER_H
-#include "utils.h"
-#ifndef PCAP_BUF_SIZE
-#define PCAP_BUF_SIZE 1024
-#endif
-/**
- * @brief 打开网卡
- * 
- * @return int 成功为0，失败为-1
- */
-int driver_open();
-
-/**
- * @brief 试图从网卡接收数据包
- * 
- * @param buf 收到的数据包
- * @return int 数据包的长度，未收到为0，错误为-1
- */
-int driver_recv(buf_t *buf);
-
-/**
- * @brief 使用网卡发送一个数据包
- * 
- * @param buf 要发送的数据包
- * @return int 成功为0，失败为-1
- */
-int driver_send(buf_t *buf);
-
-/**
- * @brief 关闭网卡
- * 
- */
-void driver_close();
+#ifndef DRIVER_H
+#define DRIVER_H
+#include "utils.h"
+struct driver_layer;
+#ifndef PCAP_BUF_SIZE
+#define PCAP_BUF_SIZE 1024
+#endif
+/**
+ * @brief 打开网卡
+ * 
+ * @return int 成功为0，失败为-1
+ */
+int driver_open();
+
+/**
+ * @brief 打开一个只用于发送的网卡句柄，不接收数据帧
+ *        RSS工作线程各自打开一个，发送时不与其他线程共享驱动状态
+ *
+ * @param rx 接收线程打开网卡时的驱动状态
+ * @return int 成功为0，失败为-1
+ */
+int driver_open_tx(struct driver_layer *rx);
+
+/**
+ * @brief 试图从网卡接收数据包
+ *        使用TPACKET驱动时，buf->data直接指向内核共享的接收环，
+ *        数据在下一次调用driver_recv前有效
+ *
+ * @param buf 收到的数据包
+ * @return int 数据包的长度，未收到为0，错误为-1
+ */
+int driver_recv(buf_t *buf);
+
+/**
+ * @brief 使用网卡发送一个数据包
+ * 
+ * @param buf 要发送的数据包
+ * @return int 成功为0，失败为-1
+ */
+int driver_send(buf_t *buf);
+
+/**
+ * @brief 试图从网卡批量接收数据包
+ *        使用TPACKET驱动时，收到的数据在下一次调用driver_recv_batch或driver_recv前有效
+ *
+ * @param bufs 接收缓冲区数组
+ * @param max 最多接收的数据包数
+ * @return int 收到的数据包数，未收到为0，错误为-1
+ */
+int driver_recv_batch(buf_t **bufs, int max);
+
+/**
+ * @brief 使用网卡批量发送数据包
+ *        尽量用一次系统调用发出全部数据包
+ *
+ * @param bufs 要发送的数据包数组
+ * @param n 数据包数
+ * @return int 成功发送的数据包数，失败为-1
+ */
+int driver_send_batch(buf_t **bufs, int n);
+
+/**
+ * @brief 获取网卡可用于epoll等待的描述符
+ *        描述符可读时表示有数据包可以接收
+ *
+ * @return int 描述符，驱动不支持时为-1
+ */
+int driver_get_fd();
+
+/**
+ * @brief 网卡MTU改变时通知驱动
+ *        协议栈自己创建的虚拟网卡同步修改设备MTU，物理网卡的MTU由系统配置，驱动不修改
+ *
+ * @param mtu 新的MTU
+ * @return int 成功为0，失败为-1
+ */
+int driver_set_mtu(int mtu);
+
+/**
+ * @brief 关闭网卡
+ * 
+ */
+void driver_close();
 #endif
\ No newline at end of file
@@ -1,47 +1,97 @@
-#ifndef ETHERNET_H
-#define ETHERNET_H
-#include <stdint.h>
-#include "net.h"
-#include "utils.h"
-
-#pragma pack(1)
-
-typedef struct ether_hdr
-{
-    uint8_t dest[NET_MAC_LEN]; // 目标mac地址
-    uint8_t src[NET_MAC_LEN];  // 源mac地址
-    uint16_t protocol;         // 协议/长度
-} ether_hdr_t;
-#pragma pack()
-
-/**
- * @brief 初始化以太网协议
- * 
- * @return int 成功为0，失败为-1
- */
-int ethernet_init();
-
-/**
- * @brief 处理一个收到的数据包
- * 
- * @param buf 要处理的数据包
- */
-void ethernet_in(buf_t *buf);
-
-/**
- * @brief 处理一个要发送的数据包
- * 
- * @param buf 要处理的数据包
- * @param mac 目标ip地址
- * @param protocol 上层协议
- */
-void ethernet_out(buf_t *buf, const uint8_t *mac, net_protocol_t protocol);
-
-/**
- * @brief 一次以太网轮询
- * 
- */
-void ethernet_poll();
-
-static const uint8_t ether_broadcast_mac[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}; //以太网广播mac地址
+#ifndef ETHERNET_H
+#define ETHERNET_H
+#include <stdint.h>
+#include "net.h"
+#include "utils.h"
+
+#pragma pack(1)
+
+typedef struct ether_hdr
+{
+    uint8_t dest[NET_MAC_LEN]; // 目标mac地址
+    uint8_t src[NET_MAC_LEN];  // 源mac地址
+    uint16_t protocol;         // 协议/长度
+} ether_hdr_t;
+#pragma pack()
+
+/**
+ * @brief 初始化以太网协议
+ * 
+ * @return int 成功为0，失败为-1
+ */
+int ethernet_init();
+
+/**
+ * @brief 处理一个收到的数据包
+ * 
+ * @param buf 要处理的数据包
+ */
+void ethernet_in(buf_t *buf);
+
+/**
+ * @brief 成批处理收到的数据帧
+ *        按协议类型分类，ip数据报组成一批交给ip_in_burst()
+ * 
+ * @param bufs 要处理的数据帧
+ * @param n 数据帧数
+ */
+void ethernet_in_burst(buf_t **bufs, int n);
+
+/**
+ * @brief 处理一个要发送的数据包
+ * 
+ * @param buf 要处理的数据包
+ * @param mac 目标ip地址
+ * @param protocol 上层协议
+ */
+void ethernet_out(buf_t *buf, const uint8_t *mac, net_protocol_t protocol);
+
+/**
+ * @brief 把封装好的数据帧交给驱动，批量发送期间先放入发送队列
+ * 
+ * @param buf 已填好以太网包头的数据帧
+ */
+void ethernet_xmit(buf_t *buf);
+
+/**
+ * @brief 把收到的数据帧原地改写后发回给发送方
+ *        buf必须带有BUF_FLAG_RX_FRAME标志，以太网包头仍在头部空间中；
+ *        目的mac直接取原来的源mac，不查arp表，协议类型不变
+ * 
+ * @param buf 去掉以太网包头后的数据包
+ */
+void ethernet_reply(buf_t *buf);
+
+/**
+ * @brief 修改当前协议栈的网卡MTU
+ *        同时通知驱动，接收缓冲区在之后的轮询中按新的MTU更换
+ * 
+ * @param mtu 新的MTU，在ETHERNET_MIN_MTU与ETHERNET_MAX_MTU之间
+ * @return int 成功为0，失败为-1
+ */
+int ethernet_set_mtu(int mtu);
+
+/**
+ * @brief 一次以太网轮询
+ * 
+ * @param budget 最多处理的数据包数
+ * @return int 处理的数据包数
+ */
+int ethernet_poll(int budget);
+
+/**
+ * @brief 开始批量发送
+ *        之后ethernet_out()发送的数据帧先放入发送队列，可以嵌套调用
+ * 
+ */
+void ethernet_batch_begin();
+
+/**
+ * @brief 结束批量发送
+ *        最外层结束时把发送队列中的数据帧一次交给驱动
+ * 
+ */
+void ethernet_batch_end();
+
+static const uint8_t ether_broadcast_mac[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}; //以太网广播mac地址
 #endif
\ No newline at end of file
@@ -1,46 +1,96 @@
-#ifndef ICMP_H
-#define ICMP_H
-#include <stdint.h>
-#include "utils.h"
-#define ICMP_WRONG_LEN 20+8+8
-#pragma pack(1)
-typedef struct icmp_hdr
-{
-    uint8_t type;      // 类型
-    uint8_t code;      // 代码
-    uint16_t checksum; // ICMP报文的校验和
-    uint16_t id;       // 标识符
-    uint16_t seq;      // 序号
-} icmp_hdr_t;
-
-#pragma pack()
-typedef enum icmp_type
-{
-    ICMP_TYPE_ECHO_REQUEST = 8, // 回显请求
-    ICMP_TYPE_ECHO_REPLY = 0,   // 回显响应
-    ICMP_TYPE_UNREACH = 3,      // 目的不可达
-} icmp_type_t;
-
-typedef enum icmp_code
-{
-    ICMP_CODE_PROTOCOL_UNREACH = 2, // 协议不可达
-    ICMP_CODE_PORT_UNREACH = 3      // 端口不可达
-} icmp_code_t;
-
-/**
- * @brief 处理一个收到的数据包
- * 
- * @param buf 要处理的数据包
- * @param src_ip 源ip地址
- */
-void icmp_in(buf_t *buf, uint8_t *src_ip);
-
-/**
- * @brief 发送icmp不可达
- * 
- * @param recv_buf 收到的ip数据包
- * @param src_ip 源ip地址
- * @param code icmp code，协议不可达或端口不可达
- */
-void icmp_unreachable(buf_t *recv_buf, uint8_t *src_ip, icmp_code_t code);
-#endif
+#ifndef ICMP_H
+#define ICMP_H
+#include <stdint.h>
+#include "utils.h"
+#define ICMP_WRONG_LEN 20+8+8
+#pragma pack(1)
+typedef struct icmp_hdr
+{
+    uint8_t type;      // 类型
+    uint8_t code;      // 代码
+    uint16_t checksum; // ICMP报文的校验和
+    uint16_t id;       // 标识符
+    uint16_t seq;      // 序号
+} icmp_hdr_t;
+
+#pragma pack()
+typedef enum icmp_type
+{
+    ICMP_TYPE_ECHO_REQUEST = 8, // 回显请求
+    ICMP_TYPE_ECHO_REPLY = 0,   // 回显响应
+    ICMP_TYPE_UNREACH = 3,      // 目的不可达
+} icmp_type_t;
+
+typedef enum icmp_code
+{
+    ICMP_CODE_PROTOCOL_UNREACH = 2, // 协议不可达
+    ICMP_CODE_PORT_UNREACH = 3,     // 端口不可达
+    ICMP_CODE_FRAG_NEEDED = 4       // 需要分片但设置了DF位
+} icmp_code_t;
+
+/**
+ * @brief icmp差错报文计数
+ * 
+ */
+typedef struct icmp_stats
+{
+    uint64_t err_sent;            //发出的差错报文数
+    uint64_t err_suppressed;      //超出全局速率被丢弃的差错报文数
+    uint64_t err_suppressed_src;  //超出单个源地址速率被丢弃的差错报文数
+} icmp_stats_t;
+
+/**
+ * @brief 回显请求结果的回调
+ * 
+ * @param ip 请求的目的地址
+ * @param seq 序列号
+ * @param len 数据长度
+ * @param rtt_ns 往返时间(纳秒)，超时为-1
+ */
+typedef void (*icmp_echo_handler_t)(uint8_t *ip, uint16_t seq, int len, int64_t rtt_ns);
+
+/**
+ * @brief 初始化icmp协议
+ * 
+ * @return int 成功为0，失败为-1
+ */
+int icmp_init();
+
+/**
+ * @brief 获取当前协议栈的icmp计数
+ * 
+ * @return const icmp_stats_t* 计数
+ */
+const icmp_stats_t *icmp_get_stats();
+
+/**
+ * @brief 处理一个收到的数据包
+ * 
+ * @param buf 要处理的数据包
+ * @param src_ip 源ip地址
+ */
+void icmp_in(buf_t *buf, uint8_t *src_ip);
+
+/**
+ * @brief 发送一个回显请求(ping)
+ *        请求按序列号记录在等待表中，收到应答或超过ICMP_ECHO_TIMEOUT_MS后调用handler，
+ *        超时由时间轮在协议栈轮询中处理，不阻塞
+ * 
+ * @param ip 目的ip地址
+ * @param seq 序列号
+ * @param len 数据长度
+ * @param handler 结果回调
+ * @return int 成功为0，同一槽位的请求仍在等待或分配失败为-1
+ */
+int icmp_echo_request(uint8_t *ip, uint16_t seq, int len, icmp_echo_handler_t handler);
+
+/**
+ * @brief 发送icmp不可达
+ *        经过全局和按源地址的令牌桶限速，超出速率时丢弃并计数
+ * 
+ * @param recv_buf 收到的ip数据包
+ * @param src_ip 源ip地址
+ * @param code icmp code，协议不可达或端口不可达
+ */
+void icmp_unreachable(buf_t *recv_buf, uint8_t *src_ip, icmp_code_t code);
+#endif
@@ -1,45 +1,84 @@
-#ifndef IP_H
-#define IP_H
-#include <stdint.h>
-#include "net.h"
-#include "utils.h"
-#pragma pack(1)
-
-typedef struct ip_hdr
-{
-    uint8_t hdr_len : 4;         // 首部长, 4字节为单位
-    uint8_t version : 4;         // 版本号
-    uint8_t tos;                 // 服务类型
-    uint16_t total_len;          // 总长度
-    uint16_t id;                 // 标识符
-    uint16_t flags_fragment;     // 标志与分段
-    uint8_t ttl;                 // 存活时间
-    uint8_t protocol;            // 上层协议
-    uint16_t hdr_checksum;       // 首部校验和
-    uint8_t src_ip[NET_IP_LEN];  // 源IP
-    uint8_t dest_ip[NET_IP_LEN]; // 目标IP
-} ip_hdr_t;
-#pragma pack()
-
-#define IP_HDR_LEN_PER_BYTE (4)    //ip包头长度单位
-#define IP_HDR_OFFSET_PER_BYTE (8) //ip分片偏移长度单位
-#define IP_VERSION_4 (4)           //ipv4
-#define IP_MORE_FRAGMENT 1 << 5    //ip分片mf位
-#define CHECK_LEN 10                // 输入checksum数组的长度
-#define IP_HDR_LEN 20               //ip数据报头一般为20字节
-/**
- * @brief 处理一个收到的数据包
- * 
- * @param buf 要处理的包
- */
-void ip_in(buf_t *buf);
-
-/**
- * @brief 处理一个要发送的ip数据包
- * 
- * @param buf 要处理的包
- * @param ip 目标ip地址
- * @param protocol 上层协议
- */
-void ip_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol);
+#ifndef IP_H
+#define IP_H
+#include <stdint.h>
+#include "net.h"
+#include "utils.h"
+#pragma pack(1)
+
+typedef struct ip_hdr
+{
+    uint8_t hdr_len : 4;         // 首部长, 4字节为单位
+    uint8_t version : 4;         // 版本号
+    uint8_t tos;                 // 服务类型
+    uint16_t total_len;          // 总长度
+    uint16_t id;                 // 标识符
+    uint16_t flags_fragment;     // 标志与分段
+    uint8_t ttl;                 // 存活时间
+    uint8_t protocol;            // 上层协议
+    uint16_t hdr_checksum;       // 首部校验和
+    uint8_t src_ip[NET_IP_LEN];  // 源IP
+    uint8_t dest_ip[NET_IP_LEN]; // 目标IP
+} ip_hdr_t;
+#pragma pack()
+
+#define IP_HDR_LEN_PER_BYTE (4)    //ip包头长度单位
+#define IP_HDR_OFFSET_PER_BYTE (8) //ip分片偏移长度单位
+#define IP_VERSION_4 (4)           //ipv4
+#define IP_MORE_FRAGMENT 1 << 5    //ip分片mf位
+#define IP_DONT_FRAGMENT 1 << 6    //ip不分片df位
+#define IP_HDR_LEN 20               //ip数据报头一般为20字节
+/**
+ * @brief 初始化ip协议
+ * 
+ * @return int 成功为0，失败为-1
+ */
+int ip_init();
+
+/**
+ * @brief 处理一个收到的数据包
+ * 
+ * @param buf 要处理的包
+ */
+void ip_in(buf_t *buf);
+
+/**
+ * @brief 成批处理收到的数据包
+ *        命中流缓存的udp数据报直接交给处理程序，其余的逐个检查，udp数据报组成一批交给udp_in_burst()
+ * 
+ * @param bufs 要处理的包
+ * @param n 包数
+ */
+void ip_in_burst(buf_t **bufs, int n);
+
+/**
+ * @brief 分配一个发出的数据报的标识符
+ * 
+ * @return uint16_t 标识符
+ */
+uint16_t ip_next_id();
+
+/**
+ * @brief 判断目的地址是否走环回路径
+ * 
+ * @param ip 目的ip地址
+ * @return int 是本机地址且启用了环回为1，否则为0
+ */
+int ip_is_local(const uint8_t *ip);
+
+/**
+ * @brief 把环回队列中的数据报交给接收方，在协议栈轮询中调用
+ * 
+ * @param budget 最多处理的数据报数
+ * @return int 处理的数据报数
+ */
+int ip_loopback_poll(int budget);
+
+/**
+ * @brief 处理一个要发送的ip数据包
+ * 
+ * @param buf 要处理的包
+ * @param ip 目标ip地址
+ * @param protocol 上层协议
+ */
+void ip_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol);
 #endif
\ No newline at end of file
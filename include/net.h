@@ -1,33 +1,90 @@
-#ifndef NET_H
-#define NET_H
-#include "config.h"
-#include <stdint.h>
-typedef enum net_protocol
-{
-    NET_PROTOCOL_ARP = 0x0806,
-    NET_PROTOCOL_IP = 0x0800,
-    NET_PROTOCOL_ICMP = 1,
-    NET_PROTOCOL_UDP = 17,
-    NET_PROTOCOL_TCP = 6,
-} net_protocol_t;
-
-static uint8_t net_if_mac[] = DRIVER_IF_MAC;
-static uint8_t net_if_ip[] = DRIVER_IF_IP;
-
-#define NET_MAC_LEN (6)                                     //mac地址长度
-#define NET_IP_LEN (4)                                      //ip地址长度
-#define swap16(x) ((((x)&0xFF) << 8) | (((x) >> 8) & 0xFF)) //为16位数据交换大小端
-
-/**
- * @brief 初始化协议栈
- * 
- */
-void net_init();
-
-/**
- * @brief 一次协议栈轮询
- * 
- */
-void net_poll();
-
+#ifndef NET_H
+#define NET_H
+#include "config.h"
+#include <stdint.h>
+typedef enum net_protocol
+{
+    NET_PROTOCOL_ARP = 0x0806,
+    NET_PROTOCOL_IP = 0x0800,
+    NET_PROTOCOL_ICMP = 1,
+    NET_PROTOCOL_UDP = 17,
+    NET_PROTOCOL_TCP = 6,
+} net_protocol_t;
+
+#define NET_MAC_LEN (6)                                     //mac地址长度
+#define NET_IP_LEN (4)                                      //ip地址长度
+#define NET_IF_NAME_LEN (16)                                //网卡名称最大长度
+#define swap16(x) ((((x)&0xFF) << 8) | (((x) >> 8) & 0xFF)) //为16位数据交换大小端
+
+/**
+ * @brief 协议栈实例
+ *        一个实例对应一块网卡，各层协议的状态都挂在实例上，由该层的init函数分配。
+ *        每个线程通过net_stack访问自己绑定的实例，各实例之间不共享任何可写数据，
+ *        可以在一个进程中为每个核或每块网卡运行一个独立的协议栈
+ * 
+ */
+typedef struct net_stack
+{
+    char if_name[NET_IF_NAME_LEN];   //网卡名称
+    uint8_t if_mac[NET_MAC_LEN];     //网卡mac地址
+    uint8_t if_ip[NET_IP_LEN];       //网卡ip地址
+    uint16_t if_mtu;                 //网卡MTU
+    struct driver_layer *driver;     //驱动状态
+    struct ethernet_layer *ethernet; //以太网层状态
+    struct arp_layer *arp;           //arp表
+    struct ip_layer *ip;             //ip层状态(分片重组等)
+    struct icmp_layer *icmp;         //icmp层状态(差错报文限速)
+    struct route_layer *route;       //路由表
+    struct udp_layer *udp;           //udp端口表与发送投递链表
+    struct timer_layer *timer;       //时间轮
+    struct rss_queue *rxq;           //不为NULL时从RSS分发队列接收数据帧，而不直接读网卡
+    int queue;                       //RSS工作线程的队列号，共用一块网卡的实例中只有0号回应arp请求
+    int epfd;                        //net_loop()等待用的epoll描述符，驱动不提供描述符时为-1
+} net_stack_t;
+
+extern __thread net_stack_t *net_stack; //当前线程绑定的协议栈实例，默认为按config.h配置的实例
+
+#define net_if_mac (net_stack->if_mac) //当前协议栈的mac地址
+#define net_if_ip (net_stack->if_ip)   //当前协议栈的ip地址
+
+/**
+ * @brief 创建一个协议栈实例
+ *        只设置网卡参数，各层状态在绑定到线程后调用net_init()时分配
+ * 
+ * @param if_name 网卡名称
+ * @param mac 网卡mac地址
+ * @param ip 网卡ip地址
+ * @return net_stack_t* 协议栈实例，失败为NULL
+ */
+net_stack_t *net_stack_create(const char *if_name, const uint8_t *mac, const uint8_t *ip);
+
+/**
+ * @brief 把协议栈实例绑定到当前线程
+ *        之后当前线程的所有协议栈调用都作用于该实例
+ * 
+ * @param stack 协议栈实例
+ */
+void net_stack_bind(net_stack_t *stack);
+
+/**
+ * @brief 初始化当前线程绑定的协议栈
+ *        同时创建net_loop()等待用的epoll描述符
+ * 
+ * @return int 成功为0，任何一层初始化失败为-1
+ */
+int net_init();
+
+/**
+ * @brief 一次协议栈轮询
+ * 
+ * @return int 处理的数据包数
+ */
+int net_poll();
+
+/**
+ * @brief 协议栈事件循环，不返回
+ * 
+ */
+void net_loop();
+
 #endif
\ No newline at end of file
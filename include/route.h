@@ -0,0 +1,83 @@
+#ifndef ROUTE_H
+#define ROUTE_H
+#include <stdint.h>
+#include "config.h"
+#include "net.h"
+
+/**
+ * @brief 路由表项
+ *
+ */
+typedef struct route
+{
+    uint8_t dest[NET_IP_LEN];    //目的网络，主机位为0
+    uint8_t prefix_len;          //前缀长度，0为默认路由
+    uint8_t gateway[NET_IP_LEN]; //下一跳网关，全0表示目的网络直连，直接arp目的地址
+    uint16_t mtu;                //路由MTU，0表示使用网卡MTU
+} route_t;
+
+/**
+ * @brief 初始化当前协议栈的路由表，已初始化时不做任何事
+ *        添加网卡所在子网的直连路由和默认路由，未配置网关时默认路由也按直连处理
+ *
+ * @return int 成功为0，失败为-1
+ */
+int route_init();
+
+/**
+ * @brief 添加路由，相同前缀的路由已存在时替换
+ *
+ * @param dest 目的网络
+ * @param prefix_len 前缀长度
+ * @param gateway 网关，为NULL或全0表示直连
+ * @param mtu 路由MTU，0表示使用网卡MTU
+ * @return int 成功为0，失败为-1
+ */
+int route_add(const uint8_t *dest, int prefix_len, const uint8_t *gateway, uint16_t mtu);
+
+/**
+ * @brief 删除路由
+ *
+ * @param dest 目的网络
+ * @param prefix_len 前缀长度
+ * @return int 成功为0，路由不存在为-1
+ */
+int route_del(const uint8_t *dest, int prefix_len);
+
+/**
+ * @brief 最长前缀匹配查找路由
+ *        先查按目的地址直接映射的路由缓存，未命中时查多比特trie，最多访问4个节点
+ *
+ * @param ip 目的ip地址
+ * @return const route_t* 匹配的路由，没有路由为NULL；路由表改变后失效
+ */
+const route_t *route_lookup(const uint8_t *ip);
+
+/**
+ * @brief 按路由计算下一跳地址
+ *
+ * @param route 路由
+ * @param ip 目的ip地址
+ * @return const uint8_t* 直连路由为目的地址本身，否则为网关
+ */
+const uint8_t *route_next_hop(const route_t *route, const uint8_t *ip);
+
+/**
+ * @brief 计算发往目的地址的数据报可用的MTU
+ *        取网卡MTU、路由MTU和未过期的路径MTU中最小的一个
+ *
+ * @param route 路由
+ * @param ip 目的ip地址
+ * @return int MTU
+ */
+int route_mtu(const route_t *route, const uint8_t *ip);
+
+/**
+ * @brief 记录到一个目的地址的路径MTU，由收到的icmp"需要分片"报文调用
+ *        只会调小，过期后恢复为路由MTU重新探测；冲突时新地址直接占用缓存项
+ *
+ * @param ip 目的ip地址
+ * @param mtu 路径MTU，小于PMTU_MIN时按PMTU_MIN记录
+ */
+void route_pmtu_update(const uint8_t *ip, int mtu);
+#endif
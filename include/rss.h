@@ -0,0 +1,65 @@
+#ifndef RSS_H
+#define RSS_H
+#include <stdint.h>
+#include "net.h"
+#include "utils.h"
+
+/**
+ * @brief 工作线程初始化回调
+ *        在工作线程绑定自己的协议栈实例并完成net_init()后调用，用于打开udp端口等
+ *
+ * @param queue 工作线程的队列号
+ */
+typedef void (*rss_setup_t)(int queue);
+
+/**
+ * @brief 启用软件RSS，成功时不返回
+ *        当前线程成为接收线程，打开网卡后按IPv4/UDP五元组的Toeplitz哈希把数据帧分发给workers个工作线程，
+ *        IP分片按(源地址, 目的地址, 标识符)哈希，同一数据报的分片总在同一个工作线程重组。
+ *        每个工作线程运行一个独立的协议栈实例，arp表、udp端口表、缓冲池和发送用的网卡句柄都不共享。
+ *        全部工作线程创建成功后才开始运行，中途失败时已创建的工作线程退出，分配的资源全部释放
+ *
+ * @param workers 工作线程数
+ * @param cpus 为NULL时不绑定CPU，否则cpus[0]为接收线程、cpus[i]为第i-1个工作线程要绑定的CPU，-1表示不绑定
+ * @param setup 工作线程初始化回调，可以为NULL
+ * @return int 失败为-1
+ */
+int rss_start(int workers, const int *cpus, rss_setup_t setup);
+
+/**
+ * @brief 工作线程的分发队列
+ *        接收线程是唯一的生产者，工作线程是唯一的消费者，不需要加锁。
+ *        接收线程每批数据帧只发布一次写入位置，队列由空变为非空时才用eventfd唤醒工作线程
+ *
+ */
+typedef struct rss_queue
+{
+    uint32_t head __attribute__((aligned(64))); // 接收线程写入的位置
+    uint32_t tail __attribute__((aligned(64))); // 工作线程读取的位置
+    uint32_t mask __attribute__((aligned(64))); // 队列长度 - 1
+    uint32_t pending;                           // 接收线程已写入、尚未发布的位置
+    int efd;                                    // 队列由空变为非空时通知工作线程
+    buf_t *bufs[];                              // 数据帧
+} rss_queue_t;
+
+/**
+ * @brief 从分发队列批量取出数据帧，在工作线程中调用
+ *        在ethernet_poll()中内联，取出的buffer用完后需要buf_free
+ *
+ * @param queue 分发队列
+ * @param bufs 取出的数据帧
+ * @param max 最多取出的数据帧数
+ * @return int 取出的数据帧数
+ */
+static inline int rss_queue_recv(rss_queue_t *queue, buf_t **bufs, int max)
+{
+    uint32_t tail = queue->tail, head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    int n = 0;
+    while (n < max && tail != head)
+        bufs[n++] = queue->bufs[tail++ & queue->mask];
+    __atomic_store_n(&queue->tail, tail, __ATOMIC_RELEASE);
+    // 与接收线程发布写入位置后的屏障配对，之后再发现队列为空时接收线程一定会通知
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return n;
+}
+#endif
@@ -0,0 +1,67 @@
+#ifndef TIMER_H
+#define TIMER_H
+#include <stdint.h>
+#include "config.h"
+
+typedef void (*timer_handler_t)(void *arg);
+
+/**
+ * @brief 定时器
+ *        嵌入在使用它的对象中，由调用者分配，清零即为未启动的定时器
+ *
+ */
+typedef struct timer_entry
+{
+    struct timer_entry *next;   //时间轮槽中的下一个定时器
+    struct timer_entry **pprev; //指向前一个定时器的next，为NULL表示未启动
+    uint64_t expires;           //到期的tick
+    timer_handler_t handler;    //到期处理函数
+    void *arg;                  //处理函数的参数
+} timer_entry_t;
+
+/**
+ * @brief 初始化当前协议栈的时间轮，已初始化时不做任何事
+ *
+ * @return int 成功为0，失败为-1
+ */
+int timer_init();
+
+/**
+ * @brief 启动定时器，已启动的定时器重新计时
+ *
+ * @param timer 定时器
+ * @param delay_ms 到期时间(毫秒)
+ * @param handler 到期处理函数，在协议栈线程中调用，调用时定时器已停止
+ * @param arg 处理函数的参数
+ */
+void timer_add(timer_entry_t *timer, uint32_t delay_ms, timer_handler_t handler, void *arg);
+
+/**
+ * @brief 停止定时器，未启动的定时器不做任何事
+ *
+ * @param timer 定时器
+ */
+void timer_del(timer_entry_t *timer);
+
+/**
+ * @brief 获取缓存的单调时钟
+ *        每次协议栈轮询只读一次时钟
+ *
+ * @return uint64_t 当前时间(毫秒)
+ */
+uint64_t timer_now();
+
+/**
+ * @brief 更新缓存的时钟并处理到期的定时器，由协议栈轮询调用
+ *
+ * @return int 到期的定时器数
+ */
+int timer_poll();
+
+/**
+ * @brief 估计距下一个定时器到期的时间，协议栈空闲时用作阻塞等待的超时
+ *
+ * @return int 等待时间(毫秒)
+ */
+int timer_next_ms();
+#endif
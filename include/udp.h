@@ -1,83 +1,230 @@
-#ifndef UDP_H
-#define UDP_H
-#include <stdint.h>
-#include "utils.h"
-#pragma pack(1)
-typedef struct udp_hdr
-{
-    uint16_t src_port;  // 源端口
-    uint16_t dest_port; // 目标端口
-    uint16_t total_len; // 整个数据包的长度
-    uint16_t checksum;  // 校验和
-} udp_hdr_t;
-
-typedef struct udp_peso_hdr
-{
-    uint8_t src_ip[4];   // 源IP地址
-    uint8_t dest_ip[4];  // 目的IP地址
-    uint8_t placeholder; // 必须置0,用于填充对齐
-    uint8_t protocol;    // 协议号
-    uint16_t total_len;  // 整个数据包的长度
-} udp_peso_hdr_t;
-#pragma pack()
-
-typedef struct udp_entry udp_entry_t;
-typedef void (*udp_handler_t)(udp_entry_t *entry, uint8_t *src_ip, uint16_t src_port, buf_t *buf);
-struct udp_entry
-{
-    int valid;             //有效位
-    int port;              //端口号
-    udp_handler_t handler; //处理程序
-};
-
-/**
- * @brief 初始化udp协议
- * 
- */
-void udp_init();
-
-/**
- * @brief 处理一个收到的udp数据包
- * 
- * @param buf 要处理的包
- * @param src_ip 源ip地址
- */
-void udp_in(buf_t *buf, uint8_t *src_ip);
-
-/**
- * @brief 处理一个要发送的数据包
- * 
- * @param buf 要处理的包
- * @param src_port 源端口号
- * @param dest_ip 目的ip地址
- * @param dest_port 目的端口号
- */
-void udp_out(buf_t *buf, uint16_t src_port, uint8_t *dest_ip, uint16_t dest_port);
-
-/**
- * @brief 发送一个udp包
- * 
- * @param data 要发送的数据
- * @param len 数据长度
- * @param src_port 源端口号
- * @param dest_ip 目的ip地址
- * @param dest_port 目的端口号
- */
-void udp_send(uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dest_ip, uint16_t dest_port);
-
-/**
- * @brief 打开一个udp端口并注册处理程序
- * 
- * @param port 端口号
- * @param handler 处理程序
- * @return int 成功为0，失败为-1
- */
-int udp_open(uint16_t port, udp_handler_t handler);
-
-/**
- * @brief 关闭一个udp端口
- * 
- * @param port 端口号
- */
-void udp_close(uint16_t port);
+#ifndef UDP_H
+#define UDP_H
+#include <stdint.h>
+#include "net.h"
+#include "utils.h"
+#pragma pack(1)
+typedef struct udp_hdr
+{
+    uint16_t src_port;  // 源端口
+    uint16_t dest_port; // 目标端口
+    uint16_t total_len; // 整个数据包的长度
+    uint16_t checksum;  // 校验和
+} udp_hdr_t;
+
+typedef struct udp_peso_hdr
+{
+    uint8_t src_ip[4];   // 源IP地址
+    uint8_t dest_ip[4];  // 目的IP地址
+    uint8_t placeholder; // 必须置0,用于填充对齐
+    uint8_t protocol;    // 协议号
+    uint16_t total_len;  // 整个数据包的长度
+} udp_peso_hdr_t;
+#pragma pack()
+
+typedef struct udp_entry udp_entry_t;
+typedef void (*udp_handler_t)(udp_entry_t *entry, uint8_t *src_ip, uint16_t src_port, buf_t *buf);
+struct udp_entry
+{
+    int valid;             //有效位
+    int port;              //端口号
+    udp_handler_t handler; //处理程序
+    struct udp_ring *ring; //接收队列，以接收队列方式打开时不为NULL，不调用处理程序
+};
+
+/**
+ * @brief 已连接的udp流，发往固定的对端
+ *        缓存下一跳的mac地址和填好的以太网、ip、udp报头模板，以及不含长度的部分校验和
+ * 
+ */
+typedef struct udp_conn
+{
+    uint8_t dest_ip[NET_IP_LEN]; //目的ip地址
+    uint16_t src_port;           //源端口号
+    uint16_t dest_port;          //目的端口号
+    int valid;                   //模板中的mac地址是否有效
+    uint32_t mtu;                //发往对端可用的MTU，更长的数据报按普通方式分片发送
+    uint64_t expires;            //到这个时间(毫秒)重新查找路由和arp表
+    uint32_t ip_sum;             //ip首部模板的累加和，不含总长度和标识
+    uint32_t udp_sum;            //udp伪头部和报头模板的累加和，不含长度
+    uint32_t pseudo_sum;         //只含udp伪头部的累加和，不含长度，用于卸载校验和
+    uint8_t hdr[14 + 20 + 8];    //以太网、ip、udp报头模板
+} udp_conn_t;
+
+typedef struct udp_msg
+{
+    buf_t *buf;         //数据，用完后调用udp_release()归还
+    uint8_t src_ip[4];  //源IP地址
+    uint16_t src_port;  //源端口号
+} udp_msg_t;
+
+/**
+ * @brief 初始化udp协议
+ *        同时创建投递发送的通知描述符
+ * 
+ * @return int 成功为0，失败为-1
+ */
+int udp_init();
+
+/**
+ * @brief 处理一个收到的udp数据包
+ * 
+ * @param buf 要处理的包
+ * @param src_ip 源ip地址
+ */
+void udp_in(buf_t *buf, uint8_t *src_ip);
+
+/**
+ * @brief 成批处理收到的udp数据包
+ * 
+ * @param bufs 要处理的包
+ * @param src_ips 各包的源ip地址
+ * @param n 包数
+ */
+void udp_in_burst(buf_t **bufs, uint8_t **src_ips, int n);
+
+/**
+ * @brief 早期分流：按流缓存跳过ip层的逐项检查，直接得到udp数据报
+ *        命中的数据报由调用者按到达顺序与其他udp数据报一起交给udp_in_burst()
+ * 
+ * @param buf 去掉以太网包头的数据包，命中时去掉ip报头
+ * @param src_ip 命中时输出源ip地址
+ * @return int 命中为1，未命中为0，需按正常路径处理
+ */
+int udp_early_demux(buf_t *buf, uint8_t **src_ip);
+
+/**
+ * @brief 处理一个要发送的数据包
+ * 
+ * @param buf 要处理的包
+ * @param src_port 源端口号
+ * @param dest_ip 目的ip地址
+ * @param dest_port 目的端口号
+ */
+void udp_out(buf_t *buf, uint16_t src_port, uint8_t *dest_ip, uint16_t dest_port);
+
+/**
+ * @brief 发送一个udp包
+ * 
+ * @param data 要发送的数据
+ * @param len 数据长度
+ * @param src_port 源端口号
+ * @param dest_ip 目的ip地址
+ * @param dest_port 目的端口号
+ */
+void udp_send(uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dest_ip, uint16_t dest_port);
+
+/**
+ * @brief 连接到一个固定的对端，之后用udp_conn_send()发送
+ * 
+ * @param src_port 源端口号
+ * @param dest_ip 目的ip地址
+ * @param dest_port 目的端口号
+ * @return udp_conn_t* 连接，失败为NULL
+ */
+udp_conn_t *udp_connect(uint16_t src_port, uint8_t *dest_ip, uint16_t dest_port);
+
+/**
+ * @brief 在已连接的udp流上发送一个udp包
+ * 
+ * @param conn 连接
+ * @param data 要发送的数据
+ * @param len 数据长度
+ * @return int 成功为0，失败为-1
+ */
+int udp_conn_send(udp_conn_t *conn, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief 释放连接
+ * 
+ * @param conn 连接，为NULL时什么也不做
+ */
+void udp_disconnect(udp_conn_t *conn);
+
+/**
+ * @brief 打开一个udp端口并注册处理程序
+ * 
+ * @param port 端口号
+ * @param handler 处理程序
+ * @return int 成功为0，失败为-1
+ */
+int udp_open(uint16_t port, udp_handler_t handler);
+
+/**
+ * @brief 关闭一个udp端口
+ *        以接收队列方式打开的端口，关闭前应用线程应停止接收并归还全部数据
+ * 
+ * @param port 端口号
+ */
+void udp_close(uint16_t port);
+
+/**
+ * @brief 以接收队列方式打开一个udp端口
+ *        协议栈线程把收到的数据放入该端口的单生产者单消费者队列，不再内联调用处理程序，
+ *        由一个应用线程用udp_recv()/udp_recv_batch()取出。应在协议栈线程中调用
+ * 
+ * @param port 端口号
+ * @param size 队列长度，会向上取整为2的幂，不大于0时为UDP_RING_SIZE
+ * @return int 队列有数据时可读的eventfd，可用于epoll，失败为-1
+ */
+int udp_open_ring(uint16_t port, int size);
+
+/**
+ * @brief 从以接收队列方式打开的端口批量取出数据，队列为空时阻塞等待
+ *        每个端口只能有一个应用线程接收，有多个协议栈实例时接收的线程需先绑定端口所在的实例
+ * 
+ * @param port 端口号
+ * @param msgs 取出的数据
+ * @param max 最多取出的个数
+ * @return int 取出的个数，失败为-1
+ */
+int udp_recv_batch(uint16_t port, udp_msg_t *msgs, int max);
+
+/**
+ * @brief 从以接收队列方式打开的端口取出一个数据，队列为空时阻塞等待
+ * 
+ * @param port 端口号
+ * @param msg 取出的数据
+ * @return int 成功为0，失败为-1
+ */
+int udp_recv(uint16_t port, udp_msg_t *msg);
+
+/**
+ * @brief 归还udp_recv()取出的数据，由接收的应用线程调用
+ *        buffer交回协议栈线程释放，应用线程不直接操作缓冲池；端口未以接收队列方式打开时什么也不做
+ * 
+ * @param port 端口号
+ * @param buf 要归还的数据
+ */
+void udp_release(uint16_t port, buf_t *buf);
+
+/**
+ * @brief 在协议栈线程以外的线程中发送一个udp包
+ *        udp_send()只能在协议栈线程中调用，其他线程用本函数把数据投递给协议栈线程发送，不加锁。
+ *        有多个协议栈实例时，应用线程先用net_stack_bind()选择要投递的实例
+ * 
+ * @param data 要发送的数据
+ * @param len 数据长度
+ * @param src_port 源端口号
+ * @param dest_ip 目的ip地址
+ * @param dest_port 目的端口号
+ * @return int 成功投递为0，线程缓存的buffer全部在途或失败为-1
+ */
+int udp_post(uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dest_ip, uint16_t dest_port);
+
+/**
+ * @brief 发出其他线程投递的udp包，在协议栈线程中调用
+ *        上一次没发完的先发，发完后才取走新投递的，保持投递顺序
+ * 
+ * @param budget 最多发出的数据包数
+ * @return int 发出的数据包数
+ */
+int udp_tx_poll(int budget);
+
+/**
+ * @brief 获取投递发送的通知描述符，有其他线程投递时可读
+ * 
+ * @return int 描述符，未初始化时为-1
+ */
+int udp_get_tx_fd();
 #endif
\ No newline at end of file
@@ -1,64 +1,241 @@
-#ifndef UTILS_H
-#define UTILS_H
-#include <stdint.h>
-#include "config.h"
-#define BUF_MAX_LEN (UINT16_MAX + 14) //最大udp包 + 以太网帧报头长度
-
-typedef struct buf
-{
-    uint16_t len;                       // 包中有效数据大小
-    uint8_t *data;                      // 包的数据起始地址
-    uint8_t payload[BUF_MAX_LEN];       // 最大负载数据量
-} buf_t;
-static buf_t rxbuf, txbuf;          //一个buf足够单线程使用
-
-/**
- * @brief 初始化buffer为给定的长度，用于装载数据包
- * 
- * @param buf 要初始化的buffer
- * @param len 长度
- */
-void buf_init(buf_t *buf, int len); //buf可以在头部装卸数据，以供协议头的添加和去除
-
-/**
- * @brief 为buffer在头部增加一段长度，用于添加协议头
- * 
- * @param buf 要修改的buffer
- * @param len 增加的长度
- */
-void buf_add_header(buf_t *buf, int len);
-
-/**
- * @brief 为buffer在头部减少一段长度，去除协议头
- * 
- * @param buf 要修改的buffer
- * @param len 减少的长度
- */
-void buf_remove_header(buf_t *buf, int len);
-
-/**
- * @brief 复制一个buffer到新buffer
- * 
- * @param dst 目的buffer
- * @param src 源buffer
- */
-void buf_copy(buf_t *dst, buf_t *src);
-
-/**
- * @brief 计算16位校验和
- * 
- * @param buf 要计算的数据包
- * @param len 要计算的长度
- * @return uint16_t 校验和
- */
-uint16_t checksum16(uint16_t *buf, int len);
-
-/**
- * @brief ip转字符串
- * 
- * @param ip ip地址
- * @return char* 生成的字符串
- */
-char *iptos(uint8_t *ip);
-
+#ifndef UTILS_H
+#define UTILS_H
+#include <stdint.h>
+#include <sys/uio.h>
+#include "config.h"
+#define BUF_MAX_LEN (UINT16_MAX + 14) //最大udp包 + 以太网帧报头长度
+
+#define BUF_FLAG_CSUM_VALID (1 << 0)   //收到的包的传输层校验和已由驱动验证，不包括ip首部校验和
+#define BUF_FLAG_CSUM_PARTIAL (1 << 1) //要发送的包只填了UDP伪头部校验和，由驱动补全，超长时由驱动分片
+#define BUF_FLAG_RX_FRAME (1 << 2)     //收到的数据帧，去掉的以太网包头仍在头部空间中，可以原地改写后发回
+#define BUF_FLAG_LOOPBACK (1 << 3)     //经环回队列交给本机的包，不计算也不验证校验和
+#define BUF_FLAG_QUEUED (1 << 4)       //已通过next链入某个等待队列，不能再链入其他队列
+
+#define HIST_SUB_BITS 5                                           //直方图每个2的幂区间再细分为2^5个桶，相对误差约3%
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) << HIST_SUB_BITS) //覆盖全部64位取值所需的桶数
+
+typedef enum buf_class
+{
+    BUF_CLASS_STATIC, //不属于缓冲池的静态缓冲区，第一次buf_init时分配最大长度的存储
+    BUF_CLASS_MTU,    //以太网帧大小
+    BUF_CLASS_JUMBO,  //巨型帧大小
+    BUF_CLASS_MAX,    //最大udp包大小
+    BUF_CLASS_NR,
+} buf_class_t;
+
+typedef struct buf_cache buf_cache_t;
+
+typedef struct buf
+{
+    uint16_t len;                       // 包中有效数据大小
+    uint8_t flags;                      // BUF_FLAG_*卸载标志
+    uint8_t class;                      // 所属的缓冲池大小类
+    uint32_t ref;                       // 引用计数，静态缓冲区不使用
+    uint32_t size;                      // 存储区大小，包括头部预留空间
+    uint8_t *data;                      // 包的数据起始地址
+    uint8_t *payload;                   // 存储区起始地址
+    struct buf *next;                   // 空闲链表指针，使用中可供持有者把buffer链成队列
+    uint16_t seg_len;                   // 挂接的外部数据段长度，为0表示没有
+    uint16_t protocol;                  // 链入等待队列时由持有者记录的上层协议
+    uint8_t *seg_data;                  // 外部数据段起始地址，逻辑上紧接在data之后
+    struct buf *seg_owner;              // 外部数据段所属的buffer，持有引用
+    buf_cache_t *cache;                 // 所属的线程缓存，为NULL时属于协议栈线程的缓冲池
+} buf_t;
+
+#define buf_capacity(buf) ((int)(buf)->size - BUF_HEADROOM - 1) //缓冲区最多能装载的数据长度，末尾留一个字节用于补零
+#define buf_total_len(buf) ((buf)->len + (buf)->seg_len)        //包括外部数据段在内的数据包总长度
+
+/**
+ * @brief 初始化buffer为给定的长度，用于装载数据包
+ *        数据前预留BUF_HEADROOM字节，供协议头的添加
+ * 
+ * @param buf 要初始化的buffer
+ * @param len 长度
+ * @return int 成功为0，长度超过buffer容量为-1
+ */
+int buf_init(buf_t *buf, int len); //buf可以在头部装卸数据，以供协议头的添加和去除
+
+/**
+ * @brief 从缓冲池分配一个能装下len字节的buffer，引用计数为1
+ * 
+ * @param len 长度
+ * @return buf_t* 分配的buffer，失败为NULL
+ */
+buf_t *buf_alloc(int len);
+
+/**
+ * @brief 在协议栈线程以外的线程中分配buffer，引用计数为1
+ *        从当前线程的缓存分配，释放后回到该缓存，不与协议栈线程的缓冲池竞争。
+ *        缓存最多占用BUF_THREAD_CACHE_SIZE字节，全部在途时失败，调用者应稍后重试。
+ *        线程退出后，等在途的buffer全部释放再把缓存归还系统
+ * 
+ * @param len 长度
+ * @return buf_t* 分配的buffer，失败为NULL
+ */
+buf_t *buf_thread_alloc(int len);
+
+/**
+ * @brief 增加一个buffer的引用，用于保留buffer而不复制
+ *        静态buffer或数据不在自身存储区中（如指向驱动的接收环）时无法保留，复制一份
+ * 
+ * @param buf 要保留的buffer
+ * @return buf_t* 保留的buffer，之后需要buf_free，失败为NULL
+ */
+buf_t *buf_ref(buf_t *buf);
+
+/**
+ * @brief 释放一个buffer的引用，引用计数为0时归还缓冲池
+ * 
+ * @param buf 要释放的buffer，为NULL或静态buffer时什么也不做
+ */
+void buf_free(buf_t *buf);
+
+/**
+ * @brief 从缓冲池分配一个新buffer并复制数据，外部数据段一并复制
+ * 
+ * @param src 源buffer
+ * @return buf_t* 新buffer，失败为NULL
+ */
+buf_t *buf_clone(buf_t *src);
+
+/**
+ * @brief 为buffer在头部增加一段长度，用于添加协议头
+ * 
+ * @param buf 要修改的buffer
+ * @param len 增加的长度
+ */
+void buf_add_header(buf_t *buf, int len);
+
+/**
+ * @brief 为buffer在头部减少一段长度，去除协议头
+ * 
+ * @param buf 要修改的buffer
+ * @param len 减少的长度
+ */
+void buf_remove_header(buf_t *buf, int len);
+
+/**
+ * @brief 复制一个buffer到新buffer，外部数据段一并复制到新buffer自身的存储区中
+ * 
+ * @param dst 目的buffer
+ * @param src 源buffer
+ * @return int 成功为0，目的buffer容量不足为-1
+ */
+int buf_copy(buf_t *dst, buf_t *src);
+
+/**
+ * @brief 为buffer挂接一段外部数据，发送时紧接在buffer自身的数据之后，不复制数据
+ *        外部数据所属的buffer增加一个引用，在buffer归还缓冲池时释放
+ * 
+ * @param buf 要挂接的buffer，必须来自缓冲池
+ * @param owner 外部数据所属的buffer，必须来自缓冲池
+ * @param data 外部数据起始地址
+ * @param len 外部数据长度
+ */
+void buf_attach(buf_t *buf, buf_t *owner, uint8_t *data, int len);
+
+/**
+ * @brief 把buffer的数据段依次填入iovec数组，供驱动用writev/sendmsg发送
+ * 
+ * @param buf 要发送的buffer
+ * @param iov iovec数组，至少有2项
+ * @return int 填入的项数
+ */
+int buf_iovec(buf_t *buf, struct iovec *iov);
+
+/**
+ * @brief 计算16位校验和
+ * 
+ * @param buf 要计算的数据包
+ * @param len 要计算的长度
+ * @return uint16_t 校验和
+ */
+uint16_t checksum16(uint16_t *buf, int len);
+
+/**
+ * @brief 累加一段数据的16位反码和，不取反
+ *        直接在字节流上计算，不要求对齐，长度可以为奇数；
+ *        分多段累加时，除最后一段外每段长度都应为偶数
+ * 
+ * @param data 数据
+ * @param len 数据长度(字节)
+ * @param sum 之前的累加结果，第一段为0
+ * @return uint32_t 累加结果，不超过0xffff
+ */
+uint32_t checksum_add(const void *data, int len, uint32_t sum);
+
+/**
+ * @brief 把累加结果取反得到校验和
+ * 
+ * @param sum checksum_add()的累加结果
+ * @return uint16_t 校验和
+ */
+uint16_t checksum_fold(uint32_t sum);
+
+/**
+ * @brief 计算一段数据的校验和
+ * 
+ * @param data 数据
+ * @param len 数据长度(字节)
+ * @return uint16_t 校验和
+ */
+uint16_t checksum_data(const void *data, int len);
+
+/**
+ * @brief 一个16位字段改变后增量更新校验和(RFC 1624)
+ * 
+ * @param checksum 原校验和
+ * @param old_val 字段原来的值
+ * @param new_val 字段新的值
+ * @return uint16_t 新校验和
+ */
+uint16_t checksum_update(uint16_t checksum, uint16_t old_val, uint16_t new_val);
+
+/**
+ * @brief 对数-线性分桶的直方图(HDR风格)
+ *        小于2^(HIST_SUB_BITS+1)的值每个值一个桶，更大的值按最高位所在的2的幂区间等分，
+ *        记录为O(1)，内存固定，任意取值范围内相对误差相同
+ * 
+ */
+typedef struct hist
+{
+    uint64_t count;                 //记录的值个数
+    uint64_t min;                   //最小值
+    uint64_t max;                   //最大值
+    uint64_t sum;                   //总和
+    uint64_t buckets[HIST_BUCKETS]; //各桶的计数
+} hist_t;
+
+/**
+ * @brief 清空直方图
+ * 
+ * @param hist 直方图
+ */
+void hist_init(hist_t *hist);
+
+/**
+ * @brief 向直方图记录一个值
+ * 
+ * @param hist 直方图
+ * @param value 值
+ */
+void hist_record(hist_t *hist, uint64_t value);
+
+/**
+ * @brief 计算百分位数
+ * 
+ * @param hist 直方图
+ * @param percent 百分比，0到100
+ * @return uint64_t 不小于percent%记录值的最小桶上界，没有记录时为0
+ */
+uint64_t hist_percentile(const hist_t *hist, double percent);
+
+/**
+ * @brief ip转字符串
+ * 
+ * @param ip ip地址
+ * @return char* 生成的字符串
+ */
+char *iptos(uint8_t *ip);
+
 #endif
\ No newline at end of file
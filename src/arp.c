@@ -1,243 +1,477 @@
-#include "arp.h"
-#include "utils.h"
-#include "ethernet.h"
-#include "config.h"
-#include <string.h>
-#include <stdio.h>
-#define ARP_LENGTH 28
-
-/**
- * @brief 初始的arp包
- * 
- */
-static const arp_pkt_t arp_init_pkt = {
-    .hw_type = swap16(ARP_HW_ETHER),
-    .pro_type = swap16(NET_PROTOCOL_IP),
-    .hw_len = NET_MAC_LEN,
-    .pro_len = NET_IP_LEN,
-    .sender_ip = DRIVER_IF_IP,
-    .sender_mac = DRIVER_IF_MAC,
-    .target_mac = {0}};
-
-/**
- * @brief arp地址转换表
- * 
- */
-arp_entry_t arp_table[ARP_MAX_ENTRY];
-
-/**
- * @brief 长度为1的arp分组队列，当等待arp回复时暂存未发送的数据包
- * 
- */
-arp_buf_t arp_buf[2]; // 为了让UDP调试工具第一次发送时也能接收到完整的数据包
-
-/**
- * @brief 更新arp表
- *        你首先需要依次轮询检测ARP表中所有的ARP表项是否有超时，如果有超时，则将该表项的状态改为无效。
- *        接着，查看ARP表是否有无效的表项，如果有，则将arp_update()函数传递进来的新的IP、MAC信息插入到表中，
- *        并记录超时时间，更改表项的状态为有效。
- *        如果ARP表中没有无效的表项，则找到超时时间最长的一条表项，
- *        将arp_update()函数传递进来的新的IP、MAC信息替换该表项，并记录超时时间，设置表项的状态为有效。
- * 
- * @param ip ip地址
- * @param mac mac地址
- * @param state 表项的状态
- */
-void arp_update(uint8_t *ip, uint8_t *mac, arp_state_t state)
-{
-    // TODO
-    time_t now_time,max; 
-    int vaild_flag=0,temp;
-    time(&now_time);// 获取当前时间
-    // 轮询检查arp_table中所有ARP表项是否有超时
-    for (int i = 0; i < ARP_MAX_ENTRY; i++){
-        if(now_time - arp_table[i].timeout > ARP_TIMEOUT_SEC){
-            arp_table[i].state = ARP_INVALID;
-        }
-    }
-    // 查找ARP表项是否有ARP_INVALID
-    for (int i = 0; i < ARP_MAX_ENTRY; i++){
-        if(arp_table[i].state == ARP_INVALID){
-            //将传递进来的新ip、mac信息插入到表中
-            memcpy(arp_table[i].ip, ip, NET_IP_LEN);
-            memcpy(arp_table[i].mac, mac, NET_MAC_LEN);
-            arp_table[i].state = state;
-            arp_table[i].timeout = now_time; // 超时时间戳中保存加入表的时间
-            vaild_flag = 1;
-            break;
-        }
-    }
-    if(vaild_flag == 0){ // 所有表项都不是ARP_INVALID
-        max = arp_table[0].timeout;
-        for(int i = 1; i < ARP_MAX_ENTRY; i++){
-            if(arp_table[i].timeout<max){
-                max = arp_table[i].timeout;
-                temp = i;
-            }
-        }
-        // temp中保存的是最大的timeout表项
-        memcpy(arp_table[temp].ip, ip, NET_IP_LEN);
-        memcpy(arp_table[temp].mac, mac, NET_MAC_LEN);
-        arp_table[temp].state = state;
-        arp_table[temp].timeout = now_time; // 超时时间戳中保存加入表的时间
-    }
-}
-
-/**
- * @brief 从arp表中根据ip地址查找mac地址
- * 
- * @param ip 欲转换的ip地址
- * @return uint8_t* mac地址，未找到时为NULL
- */
-static uint8_t *arp_lookup(uint8_t *ip)
-{
-    for (int i = 0; i < ARP_MAX_ENTRY; i++)
-        if (arp_table[i].state == ARP_VALID && memcmp(arp_table[i].ip, ip, NET_IP_LEN) == 0)
-            return arp_table[i].mac;
-    return NULL;
-}
-
-/**
- * @brief 发送一个arp请求
- *        你需要调用buf_init对txbuf进行初始化
- *        填写ARP报头，将ARP的opcode设置为ARP_REQUEST，注意大小端转换
- *        将ARP数据报发送到ethernet层
- * 
- * @param target_ip 想要知道的目标的ip地址
- */
-static void arp_req(uint8_t *target_ip)
-{
-    // TODO
-    arp_pkt_t arp_pkt_t;
-    // ARP报文长度为28
-    buf_init(&txbuf, ARP_LENGTH); 
-    // 填写ARP报头
-    arp_pkt_t = arp_init_pkt;
-    memcpy(arp_pkt_t.target_ip, target_ip, NET_IP_LEN);
-    arp_pkt_t.opcode = swap16(ARP_REQUEST);
-    memcpy(txbuf.data, &arp_pkt_t, sizeof(arp_pkt_t));
-    // 调用ethernet_out函数将ARP报文发送出去
-    ethernet_out(&txbuf, ether_broadcast_mac, NET_PROTOCOL_ARP);
-}
-
-/**
- * @brief 处理一个收到的数据包
- *        你首先需要做报头检查，查看报文是否完整，
- *        检查项包括：硬件类型，协议类型，硬件地址长度，协议地址长度，操作类型
- *        
- *        接着，调用arp_update更新ARP表项
- *        查看arp_buf是否有效，如果有效，则说明ARP分组队列里面有待发送的数据包。
- *        即上一次调用arp_out()发送来自IP层的数据包时，由于没有找到对应的MAC地址进而先发送的ARP request报文
- *        此时，收到了该request的应答报文。然后，根据IP地址来查找ARM表项，如果能找到该IP地址对应的MAC地址，
- *        则将缓存的数据包arp_buf再发送到ethernet层。
- * 
- *        如果arp_buf无效，还需要判断接收到的报文是否为request请求报文，并且，该请求报文的目的IP正好是本机的IP地址，
- *        则认为是请求本机MAC地址的ARP请求报文，则回应一个响应报文（应答报文）。
- *        响应报文：需要调用buf_init初始化一个buf，填写ARP报头，目的IP和目的MAC需要填写为收到的ARP报的源IP和源MAC。
- * 
- * @param buf 要处理的数据包
- */
-void arp_in(buf_t *buf)
-{
-    // TODO
-    arp_pkt_t *arp = (arp_pkt_t*)buf->data;
-    arp_pkt_t arp_pkt_t;
-    uint8_t *get_mac;
-    int count_same=0;
-    int opcode = swap16(arp->opcode);
-    if (arp->hw_type != swap16(ARP_HW_ETHER)
-        || arp->pro_type != swap16(NET_PROTOCOL_IP)
-        || arp->hw_len != NET_MAC_LEN
-        || arp->pro_len != NET_IP_LEN
-        || (opcode != ARP_REQUEST && opcode != ARP_REPLY))
-    {
-        return ;// 报头有误
-    }
-    arp_update(arp->sender_ip, arp->sender_mac, ARP_VALID);
-    if(arp_buf[0].valid || arp_buf[1].valid){// arp_buf有效
-        if(arp_buf[0].valid){
-            arp_buf[0].valid = 0;
-            get_mac = arp_lookup(arp_buf[0].ip);
-            if(get_mac != NULL){
-                ethernet_out(&arp_buf[0].buf, get_mac, arp_buf[0].protocol);
-            }
-        }
-        if (arp_buf[1].valid)
-        {
-            arp_buf[1].valid = 0;
-            get_mac = arp_lookup(arp_buf[1].ip);
-            if(get_mac != NULL){
-                ethernet_out(&arp_buf[1].buf, get_mac, arp_buf[1].protocol);
-            }
-        }
-        
-    }else // arp_buf无效
-    {
-        // 接收到的报文为ARP_REQUEST请求报文且请求报文的target_ip是本机的IP
-        if(arp->opcode == swap16(ARP_REQUEST) && memcmp(arp->target_ip, net_if_ip, NET_IP_LEN) == 0){
-            // 认为是请求本机的MAC地址的ARP请求报文，回应一个响应报文
-            buf_init(&txbuf, ARP_LENGTH); 
-            // 填写ARP报头
-            arp_pkt_t = arp_init_pkt;
-            memcpy(arp_pkt_t.target_ip, arp->sender_ip, NET_IP_LEN);
-            memcpy(arp_pkt_t.target_mac, arp->sender_mac, NET_MAC_LEN);
-            memcpy(arp_pkt_t.sender_ip, arp->target_ip, NET_IP_LEN);
-            memcpy(arp_pkt_t.sender_mac, net_if_mac, NET_MAC_LEN);
-            arp_pkt_t.opcode = swap16(ARP_REPLY);// ARP响应包
-            memcpy(txbuf.data, &arp_pkt_t, sizeof(arp_pkt_t));
-            ethernet_out(&txbuf, arp_pkt_t.target_mac, NET_PROTOCOL_ARP);// 响应请求MAC地址的报文
-        }
-    }
-    
-}
-
-/**
- * @brief 处理一个要发送的数据包
- *        你需要根据IP地址来查找ARP表
- *        如果能找到该IP地址对应的MAC地址，则将数据报直接发送给ethernet层
- *        如果没有找到对应的MAC地址，则需要先发一个ARP request报文。
- *        注意，需要将来自IP层的数据包缓存到arp_buf中，等待arp_in()能收到ARP request报文的应答报文
- * 
- * @param buf 要处理的数据包
- * @param ip 目标ip地址
- * @param protocol 上层协议
- */
-void arp_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol)
-{
-    // TODO
-    int count_same=0,i,j,temp,flag=0;
-    uint8_t *get_mac;
-    get_mac = arp_lookup(ip);
-    if(get_mac != NULL){// 标志在表中找到MAC地址
-        ethernet_out(buf, get_mac, protocol);
-    }
-    else{// 没有找到对应的MAC地址
-        //将来自IP层的数据包缓存到arp_buf的buf中
-        for (int i = 0; i < 2; i++){
-            if(arp_buf[i].valid == 0){
-                memcpy(&arp_buf[i].buf, buf, sizeof(buf_t));
-                memcpy(&arp_buf[i].ip, ip, NET_IP_LEN);
-                arp_buf[i].protocol = protocol;
-                arp_buf[i].valid = 1;
-                arp_req(ip);
-                break;
-            }
-        }
-        
-    }
-
-}
-
-/**
- * @brief 初始化arp协议
- * 
- */
-void arp_init()
-{
-    for (int i = 0; i < ARP_MAX_ENTRY; i++)
-        arp_table[i].state = ARP_INVALID;
-    for (int i = 0; i < 2; i++){
-        arp_buf[i].valid = 0;
-    }
-    arp_req(net_if_ip); // 发送一个无回报ARP包
+#include "arp.h"
+#include "utils.h"
+#include "ethernet.h"
+#include "config.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#define ARP_LENGTH 28
+
+/**
+ * @brief 初始的arp包
+ * 
+ */
+static const arp_pkt_t arp_init_pkt = {
+    .hw_type = swap16(ARP_HW_ETHER),
+    .pro_type = swap16(NET_PROTOCOL_IP),
+    .hw_len = NET_MAC_LEN,
+    .pro_len = NET_IP_LEN,
+    .target_mac = {0}};
+
+typedef struct arp_index
+{
+    uint32_t ip;  // ip地址，按本机字节序读出的4字节
+    int32_t slot; // 表项在arp表中的位置，-1表示空
+} arp_index_t;
+
+/**
+ * @brief 计算ip地址在哈希索引中的起始位置
+ * 
+ * @param ip ip地址
+ * @return uint32_t 索引位置
+ */
+static uint32_t arp_hash(uint32_t ip)
+{
+    net_stack_t *s = net_stack;
+    return (ip * 0x9E3779B1u) >> s->arp->index_shift;
+}
+
+/**
+ * @brief 在哈希索引中查找ip地址
+ * 
+ * @param ip ip地址
+ * @return uint32_t 找到时为所在的索引位置，未找到时为应插入的空位置
+ */
+static uint32_t arp_index_find(uint32_t ip)
+{
+    net_stack_t *s = net_stack;
+    uint32_t pos = arp_hash(ip);
+    while (s->arp->index[pos].slot != -1 && s->arp->index[pos].ip != ip)
+        pos = (pos + 1) & s->arp->index_mask;
+    return pos;
+}
+
+/**
+ * @brief 从哈希索引中删除一项
+ *        把后面探测链上的项前移填补空位，不需要墓碑标记
+ * 
+ * @param pos 要删除的索引位置
+ */
+static void arp_index_remove(uint32_t pos)
+{
+    net_stack_t *s = net_stack;
+    uint32_t next = (pos + 1) & s->arp->index_mask;
+    while (s->arp->index[next].slot != -1)
+    {
+        uint32_t home = arp_hash(s->arp->index[next].ip);
+        if (((next - home) & s->arp->index_mask) >= ((next - pos) & s->arp->index_mask))
+        {
+            s->arp->index[pos] = s->arp->index[next];
+            pos = next;
+        }
+        next = (next + 1) & s->arp->index_mask;
+    }
+    s->arp->index[pos].slot = -1;
+}
+
+/**
+ * @brief 丢弃表项等待队列中的全部数据包
+ * 
+ * @param entry 表项
+ */
+static void arp_pending_drop(arp_entry_t *entry)
+{
+    buf_t *pkt, *next;
+    for (pkt = entry->pending; pkt != NULL; pkt = next)
+    {
+        next = pkt->next;
+        pkt->next = NULL;
+        pkt->flags &= ~BUF_FLAG_QUEUED;
+        buf_free(pkt);
+    }
+    entry->pending = entry->pending_tail = NULL;
+    entry->pending_nr = 0;
+}
+
+/**
+ * @brief 地址已解析，把表项等待队列中的数据包一次批量发出
+ * 
+ * @param entry 表项
+ */
+static void arp_pending_flush(arp_entry_t *entry)
+{
+    buf_t *pkt, *next;
+    ethernet_batch_begin();
+    for (pkt = entry->pending; pkt != NULL; pkt = next)
+    {
+        next = pkt->next;
+        pkt->next = NULL;
+        pkt->flags &= ~BUF_FLAG_QUEUED;
+        ethernet_out(pkt, entry->mac, pkt->protocol);
+        buf_free(pkt);
+    }
+    ethernet_batch_end();
+    entry->pending = entry->pending_tail = NULL;
+    entry->pending_nr = 0;
+}
+
+/**
+ * @brief 删除一个表项，归还空闲表项栈
+ *        等待响应的表项中缓存的数据包一并丢弃
+ * 
+ * @param slot 表项位置
+ */
+static void arp_entry_remove(int slot)
+{
+    net_stack_t *s = net_stack;
+    uint32_t ip;
+    arp_pending_drop(&s->arp->table[slot]);
+    timer_del(&s->arp->table[slot].timer);
+    memcpy(&ip, s->arp->table[slot].ip, NET_IP_LEN);
+    arp_index_remove(arp_index_find(ip));
+    s->arp->table[slot].state = ARP_INVALID;
+    s->arp->free_slots[s->arp->free_nr++] = slot;
+}
+
+/**
+ * @brief 获取一个空闲表项
+ *        没有空闲表项时用CLOCK算法淘汰一个最近未被访问的表项
+ * 
+ * @return int 表项位置
+ */
+static int arp_entry_alloc()
+{
+    net_stack_t *s = net_stack;
+    if (s->arp->free_nr == 0)
+    {
+        while (s->arp->table[s->arp->clock_hand].referenced)
+        {
+            s->arp->table[s->arp->clock_hand].referenced = 0;
+            s->arp->clock_hand = (s->arp->clock_hand + 1) % s->arp->table_size;
+        }
+        arp_entry_remove(s->arp->clock_hand);
+        s->arp->clock_hand = (s->arp->clock_hand + 1) % s->arp->table_size;
+    }
+    return s->arp->free_slots[--s->arp->free_nr];
+}
+
+/**
+ * @brief 通过哈希索引查找ip地址对应的表项，未找到时插入一个新表项
+ *        表满时用CLOCK算法淘汰最近未被访问的表项，新表项的状态为ARP_INVALID
+ * 
+ * @param ip ip地址
+ * @return int 表项位置
+ */
+static int arp_entry_get(uint8_t *ip)
+{
+    net_stack_t *s = net_stack;
+    uint32_t key, pos;
+    int slot;
+    memcpy(&key, ip, NET_IP_LEN);
+    pos = arp_index_find(key);
+    if (s->arp->index[pos].slot != -1)
+        return s->arp->index[pos].slot;
+    slot = arp_entry_alloc();
+    pos = arp_index_find(key); // 淘汰表项可能移动了索引
+    s->arp->index[pos].ip = key;
+    s->arp->index[pos].slot = slot;
+    memcpy(s->arp->table[slot].ip, ip, NET_IP_LEN);
+    return slot;
+}
+
+static void arp_entry_expire(void *arg);
+
+/**
+ * @brief 按表项的状态启动它的定时器
+ *        有效表项在ARP_TIMEOUT_SEC后老化，等待响应的表项在重传间隔后重传arp请求
+ * 
+ * @param entry 表项
+ */
+static void arp_entry_arm(arp_entry_t *entry)
+{
+    if (entry->state == ARP_PENDING)
+        timer_add(&entry->timer, ARP_MIN_INTERVAL * 1000 << entry->retries, arp_entry_expire, entry);
+    else if (entry->state == ARP_VALID)
+        timer_add(&entry->timer, ARP_TIMEOUT_SEC * 1000, arp_entry_expire, entry);
+    else
+        timer_del(&entry->timer);
+}
+
+/**
+ * @brief 更新arp表
+ *        找到则更新，否则插入一个新表项，并重新开始老化计时。
+ *        表项由等待响应变为有效时，把等待队列中的数据包全部发出
+ * 
+ * @param ip ip地址
+ * @param mac mac地址
+ * @param state 表项的状态
+ */
+void arp_update(uint8_t *ip, uint8_t *mac, arp_state_t state)
+{
+    net_stack_t *s = net_stack;
+    arp_entry_t *entry = &s->arp->table[arp_entry_get(ip)];
+    memcpy(entry->mac, mac, NET_MAC_LEN);
+    entry->state = state;
+    entry->referenced = 1;
+    entry->timeout = timer_now(); // 保存加入表的时间
+    arp_entry_arm(entry);
+    if (state == ARP_VALID && entry->pending != NULL)
+        arp_pending_flush(entry);
+}
+
+/**
+ * @brief 从arp表中根据ip地址查找mac地址
+ * 
+ * @param ip 欲转换的ip地址
+ * @return uint8_t* mac地址，未找到时为NULL
+ */
+uint8_t *arp_lookup(uint8_t *ip)
+{
+    net_stack_t *s = net_stack;
+    uint32_t key;
+    int slot;
+    memcpy(&key, ip, NET_IP_LEN);
+    slot = s->arp->index[arp_index_find(key)].slot;
+    if (slot == -1 || s->arp->table[slot].state != ARP_VALID)
+        return NULL;
+    s->arp->table[slot].referenced = 1;
+    return s->arp->table[slot].mac;
+}
+
+/**
+ * @brief 发送一个arp请求
+ *        你需要调用buf_alloc分配txbuf，发送后调用buf_free释放
+ *        填写ARP报头，将ARP的opcode设置为ARP_REQUEST，注意大小端转换
+ *        将ARP数据报发送到ethernet层
+ * 
+ * @param target_ip 想要知道的目标的ip地址
+ */
+static void arp_req(uint8_t *target_ip)
+{
+    // TODO
+    arp_pkt_t arp_pkt_t;
+    // ARP报文长度为28
+    buf_t *txbuf = buf_alloc(ARP_LENGTH);
+    if(txbuf == NULL){
+        return;
+    }
+    // 填写ARP报头
+    arp_pkt_t = arp_init_pkt;
+    memcpy(arp_pkt_t.sender_ip, net_if_ip, NET_IP_LEN);
+    memcpy(arp_pkt_t.sender_mac, net_if_mac, NET_MAC_LEN);
+    memcpy(arp_pkt_t.target_ip, target_ip, NET_IP_LEN);
+    arp_pkt_t.opcode = swap16(ARP_REQUEST);
+    memcpy(txbuf->data, &arp_pkt_t, sizeof(arp_pkt_t));
+    // 调用ethernet_out函数将ARP报文发送出去
+    ethernet_out(txbuf, ether_broadcast_mac, NET_PROTOCOL_ARP);
+    buf_free(txbuf);
+}
+
+/**
+ * @brief 表项的定时器到期
+ *        有效表项超过ARP_TIMEOUT_SEC后删除；
+ *        等待响应的表项从ARP_MIN_INTERVAL开始按加倍的间隔重传arp请求，
+ *        重传ARP_MAX_RETRY次仍无响应则丢弃等待的数据包并删除表项
+ * 
+ * @param arg 表项
+ */
+static void arp_entry_expire(void *arg)
+{
+    net_stack_t *s = net_stack;
+    arp_entry_t *entry = arg;
+    if(entry->state == ARP_PENDING && entry->retries < ARP_MAX_RETRY){
+        entry->retries++;
+        entry->timeout = timer_now();
+        arp_req(entry->ip);
+        arp_entry_arm(entry);
+        return;
+    }
+    arp_entry_remove(entry - s->arp->table);
+}
+
+/**
+ * @brief 处理一个收到的数据包
+ *        你首先需要做报头检查，查看报文是否完整，
+ *        检查项包括：硬件类型，协议类型，硬件地址长度，协议地址长度，操作类型
+ *        
+ *        接着，调用arp_update更新ARP表项，若该地址的表项正在等待响应，
+ *        arp_update会把等待队列中缓存的数据包一次全部发送到ethernet层。
+ * 
+ *        然后判断接收到的报文是否为request请求报文，并且，该请求报文的目的IP正好是本机的IP地址，
+ *        则认为是请求本机MAC地址的ARP请求报文，则回应一个响应报文（应答报文）。
+ *        响应报文：需要调用buf_init初始化一个buf，填写ARP报头，目的IP和目的MAC需要填写为收到的ARP报的源IP和源MAC。
+ * 
+ * @param buf 要处理的数据包
+ */
+void arp_in(buf_t *buf)
+{
+    // TODO
+    arp_pkt_t *arp = (arp_pkt_t*)buf->data;
+    arp_pkt_t arp_pkt_t;
+    int opcode = swap16(arp->opcode);
+    if (arp->hw_type != swap16(ARP_HW_ETHER)
+        || arp->pro_type != swap16(NET_PROTOCOL_IP)
+        || arp->hw_len != NET_MAC_LEN
+        || arp->pro_len != NET_IP_LEN
+        || (opcode != ARP_REQUEST && opcode != ARP_REPLY))
+    {
+        return ;// 报头有误
+    }
+    arp_update(arp->sender_ip, arp->sender_mac, ARP_VALID); // 有等待该地址的数据包时一并发出
+    // 接收到的报文为ARP_REQUEST请求报文且请求报文的target_ip是本机的IP
+    // 多个RSS工作线程都会收到arp包，只由0号回应
+    if(opcode == ARP_REQUEST && memcmp(arp->target_ip, net_if_ip, NET_IP_LEN) == 0 && net_stack->queue == 0){
+        // 认为是请求本机的MAC地址的ARP请求报文，回应一个响应报文
+        buf_t *txbuf = buf_alloc(ARP_LENGTH);
+        if(txbuf == NULL){
+            return;
+        }
+        // 填写ARP报头
+        arp_pkt_t = arp_init_pkt;
+        memcpy(arp_pkt_t.target_ip, arp->sender_ip, NET_IP_LEN);
+        memcpy(arp_pkt_t.target_mac, arp->sender_mac, NET_MAC_LEN);
+        memcpy(arp_pkt_t.sender_ip, arp->target_ip, NET_IP_LEN);
+        memcpy(arp_pkt_t.sender_mac, net_if_mac, NET_MAC_LEN);
+        arp_pkt_t.opcode = swap16(ARP_REPLY);// ARP响应包
+        memcpy(txbuf->data, &arp_pkt_t, sizeof(arp_pkt_t));
+        ethernet_out(txbuf, arp_pkt_t.target_mac, NET_PROTOCOL_ARP);// 响应请求MAC地址的报文
+        buf_free(txbuf);
+    }
+}
+
+/**
+ * @brief 处理一个要发送的数据包
+ *        你需要根据IP地址来查找ARP表
+ *        如果能找到该IP地址对应的MAC地址，则将数据报直接发送给ethernet层
+ *        如果没有找到对应的MAC地址，则需要先发一个ARP request报文。
+ *        注意，需要将来自IP层的数据包缓存到该地址表项的等待队列中，等待arp_in()能收到ARP request报文的应答报文。
+ *        每个地址的等待队列最多缓存ARP_PENDING_MAX个数据包，arp请求只在第一次发送，重传由表项的定时器按间隔进行
+ * 
+ * @param buf 要处理的数据包
+ * @param ip 目标ip地址
+ * @param protocol 上层协议
+ */
+void arp_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol)
+{
+    net_stack_t *s = net_stack;
+    // TODO
+    uint8_t *get_mac;
+    arp_entry_t *entry;
+    buf_t *pkt;
+    get_mac = arp_lookup(ip);
+    if(get_mac != NULL){// 标志在表中找到MAC地址
+        ethernet_out(buf, get_mac, protocol);
+        return;
+    }
+    // 没有找到对应的MAC地址
+    entry = &s->arp->table[arp_entry_get(ip)];
+    if(entry->state != ARP_PENDING){// 第一次解析该地址，立即发送请求，之后的重传由表项的定时器负责
+        entry->state = ARP_PENDING;
+        memset(entry->mac, 0, NET_MAC_LEN);
+        entry->retries = 0;
+        entry->referenced = 1;
+        entry->timeout = timer_now();
+        arp_req(ip);
+        arp_entry_arm(entry);
+    }
+    if(entry->pending_nr >= ARP_PENDING_MAX){// 等待队列已满，丢弃
+        return;
+    }
+    // 保留数据包的引用，不必复制整个buffer
+    if((pkt = buf_ref(buf)) == NULL){
+        return;
+    }
+    if(pkt->flags & BUF_FLAG_QUEUED){// 同一个buffer已在某个表项的队列中，链表指针被占用，复制一份
+        buf_free(pkt);
+        if((pkt = buf_clone(buf)) == NULL){
+            return;
+        }
+    }
+    if(entry->pending_tail != NULL){
+        entry->pending_tail->next = pkt;
+    }else{
+        entry->pending = pkt;
+    }
+    pkt->next = NULL;
+    pkt->protocol = protocol;
+    pkt->flags |= BUF_FLAG_QUEUED;
+    entry->pending_tail = pkt;
+    entry->pending_nr++;
+}
+
+/**
+ * @brief 按给定容量重新分配arp表，原有表项全部清空
+ *        可以在运行时根据网段内的主机数调整
+ * 
+ * @param max_entry arp表容量
+ * @return int 成功为0，失败为-1
+ */
+int arp_table_init(int max_entry)
+{
+    net_stack_t *s = net_stack;
+    uint32_t index_size = 16;
+    int index_bits = 4;
+    if (max_entry <= 0 || max_entry > (1 << 30))
+        return -1;
+    while (index_size < (uint32_t)max_entry * 2)
+    {
+        index_size <<= 1;
+        index_bits++;
+    }
+    arp_entry_t *table = calloc(max_entry, sizeof(arp_entry_t));
+    arp_index_t *index = malloc(index_size * sizeof(arp_index_t));
+    int *free_slots = malloc(max_entry * sizeof(int));
+    if (table == NULL || index == NULL || free_slots == NULL)
+    {
+        fprintf(stderr, "Error in arp_table_init: out of memory\n");
+        free(table);
+        free(index);
+        free(free_slots);
+        return -1;
+    }
+    for (int i = 0; i < s->arp->table_size; i++)
+    {
+        arp_pending_drop(&s->arp->table[i]);
+        timer_del(&s->arp->table[i].timer);
+    }
+    free(s->arp->table);
+    free(s->arp->index);
+    free(s->arp->free_slots);
+    s->arp->table = table;
+    s->arp->index = index;
+    s->arp->free_slots = free_slots;
+    s->arp->table_size = max_entry;
+    s->arp->index_mask = index_size - 1;
+    s->arp->index_shift = 32 - index_bits;
+    for (uint32_t i = 0; i < index_size; i++)
+        s->arp->index[i].slot = -1;
+    for (int i = 0; i < max_entry; i++)
+    {
+        s->arp->table[i].state = ARP_INVALID;
+        s->arp->free_slots[i] = max_entry - 1 - i; // 先分配靠前的表项
+    }
+    s->arp->free_nr = max_entry;
+    s->arp->clock_hand = 0;
+    return 0;
+}
+
+/**
+ * @brief 初始化arp协议
+ * 
+ * @return int 成功为0，失败为-1
+ */
+int arp_init()
+{
+    if (net_stack->arp == NULL && (net_stack->arp = calloc(1, sizeof(arp_layer_t))) == NULL)
+    {
+        fprintf(stderr, "Error in arp_init: out of memory\n");
+        return -1;
+    }
+    if (timer_init() != 0)
+        return -1;
+    if (arp_table_init(ARP_MAX_ENTRY) != 0)
+        return -1;
+    if (net_stack->queue == 0) // 共用一块网卡的RSS工作线程中只由0号发送
+        arp_req(net_if_ip); // 发送一个无回报ARP包
+    return 0;
 }
\ No newline at end of file
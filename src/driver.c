@@ -1,112 +1,262 @@
-#include <pcap.h>
-#include <string.h>
-#include "utils.h"
-#include "config.h"
-#include "driver.h"
-
-static pcap_t *pcap;
-static char pcap_errbuf[PCAP_ERRBUF_SIZE];
-
-/**
- * @brief 打开网卡
- * 
- * @return int 成功为0，失败为-1
- */
-int driver_open()
-{
-    uint32_t net, mask;
-
-    // 根据DRIVER_IF_NAME网卡名，获取网卡的网络号net和子网掩码mask
-    if (pcap_lookupnet(DRIVER_IF_NAME, &net, &mask, pcap_errbuf) == -1) //查找网卡
-    {
-        fprintf(stderr, "Error in pcap_lookupnet: %s\n", pcap_geterr(pcap));
-        return -1;
-    }
-
-    // 获取一个数据包捕获的描述符，以便用来查看网络上的数据包。
-    // 第二个参数表示捕获的最大字节数，通常来说数据包的大小不会超过65535
-    // 第三个参数表示开启混杂模式，0表示非混杂模式，任何其他值表示混合模式
-    // 第四个参数指定需要等待的毫秒数，0表示一直等待直到有数据包到来
-    if ((pcap = pcap_open_live(DRIVER_IF_NAME, 65536, 1, 10, pcap_errbuf)) == NULL) //混杂模式打开网卡
-    {
-        fprintf(stderr, "Error in pcap_open_live: %s.\n", pcap_geterr(pcap));
-        return -1;
-    }
-    if (pcap_setnonblock(pcap, 1, pcap_errbuf) != 0) //设置非阻塞模式
-    {
-        fprintf(stderr, "Error in pcap_setnonblock: %s\n", pcap_geterr(pcap));
-        return -1;
-    }
-    char filter_exp[PCAP_BUF_SIZE];
-    struct bpf_program fp;
-    uint8_t mac_addr[6] = DRIVER_IF_MAC;
-    sprintf(filter_exp, //过滤数据包
-            "(ether dst %02x:%02x:%02x:%02x:%02x:%02x or ether broadcast) and (not ether src %02x:%02x:%02x:%02x:%02x:%02x)",
-            mac_addr[0], mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5],
-            mac_addr[0], mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5]);
-    
-    // 只捕获发往本网卡接口与广播的数据帧，也就是只处理发往这张网卡的数据包
-    if (pcap_compile(pcap, &fp, filter_exp, 0, net) == -1)
-    {
-        fprintf(stderr, "Error in pcap_compile: %s\n", pcap_geterr(pcap));
-        return -1;
-    }
-    if (pcap_setfilter(pcap, &fp) == -1)
-    {
-        fprintf(stderr, "Error in pcap_setfilter: %s\n", pcap_geterr(pcap));
-        return -1;
-    }
-    return 0;
-}
-
-/**
- * @brief 试图从网卡接收数据包
- * 
- * @param buf 收到的数据包
- * @return int 数据包的长度，未收到为0，错误为-1
- */
-int driver_recv(buf_t *buf)
-{
-    struct pcap_pkthdr *pkt_hdr;
-    const uint8_t *pkt_data;
-
-    // 从本网卡接口获取一个数据报文
-    int ret = pcap_next_ex(pcap, &pkt_hdr, &pkt_data);
-    if (ret == 0)
-        return 0;
-    else if (ret == 1)
-    {
-        memcpy(buf->data, pkt_data, pkt_hdr->len);
-        buf->len = pkt_hdr->len;
-        return pkt_hdr->len;
-    }
-    fprintf(stderr, "Error in driver_recv: %s\n", pcap_geterr(pcap));
-    return -1;
-}
-
-/**
- * @brief 使用网卡发送一个数据包
- * 
- * @param buf 要发送的数据包
- * @return int 成功为0，失败为-1
- */
-int driver_send(buf_t *buf)
-{
-    // 将数据包发往指定的网卡接口
-    if (pcap_sendpacket(pcap, buf->data, buf->len) == -1)
-    {
-        fprintf(stderr, "Error in driver_send: %s\n", pcap_geterr(pcap));
-        return -1;
-    }
-
-    return 0;
-}
-
-/**
- * @brief 关闭网卡
- * 
- */
-void driver_close()
-{
-    pcap_close(pcap);
-}
+#define _GNU_SOURCE
+#include "config.h"
+#if DRIVER_TYPE == DRIVER_PCAP
+#include <pcap.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include "utils.h"
+#include "driver.h"
+#include "net.h"
+
+/**
+ * @brief 驱动状态，每个协议栈实例一份
+ * 
+ */
+typedef struct driver_layer
+{
+    pcap_t *pcap;
+    char errbuf[PCAP_ERRBUF_SIZE];
+} driver_layer_t;
+
+/**
+ * @brief 打开网卡
+ * 
+ * @return int 成功为0，失败为-1
+ */
+int driver_open()
+{
+    net_stack_t *s = net_stack;
+    uint32_t net, mask;
+
+    if (s->driver == NULL && (s->driver = calloc(1, sizeof(driver_layer_t))) == NULL)
+    {
+        fprintf(stderr, "Error in driver_open: out of memory\n");
+        return -1;
+    }
+    // 根据协议栈实例的网卡名，获取网卡的网络号net和子网掩码mask
+    if (pcap_lookupnet(s->if_name, &net, &mask, s->driver->errbuf) == -1) //查找网卡
+    {
+        fprintf(stderr, "Error in pcap_lookupnet: %s\n", pcap_geterr(s->driver->pcap));
+        return -1;
+    }
+
+    // 获取一个数据包捕获的描述符，以便用来查看网络上的数据包。
+    // 第二个参数表示捕获的最大字节数，通常来说数据包的大小不会超过65535
+    // 第三个参数表示开启混杂模式，0表示非混杂模式，任何其他值表示混合模式
+    // 第四个参数指定需要等待的毫秒数，0表示一直等待直到有数据包到来
+    if ((s->driver->pcap = pcap_open_live(s->if_name, 65536, 1, 10, s->driver->errbuf)) == NULL) //混杂模式打开网卡
+    {
+        fprintf(stderr, "Error in pcap_open_live: %s.\n", pcap_geterr(s->driver->pcap));
+        return -1;
+    }
+    if (pcap_setnonblock(s->driver->pcap, 1, s->driver->errbuf) != 0) //设置非阻塞模式
+    {
+        fprintf(stderr, "Error in pcap_setnonblock: %s\n", pcap_geterr(s->driver->pcap));
+        return -1;
+    }
+    char filter_exp[PCAP_BUF_SIZE];
+    struct bpf_program fp;
+    uint8_t *mac_addr = net_if_mac;
+    sprintf(filter_exp, //过滤数据包
+            "(ether dst %02x:%02x:%02x:%02x:%02x:%02x or ether broadcast) and (not ether src %02x:%02x:%02x:%02x:%02x:%02x)",
+            mac_addr[0], mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5],
+            mac_addr[0], mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5]);
+    
+    // 只捕获发往本网卡接口与广播的数据帧，也就是只处理发往这张网卡的数据包
+    if (pcap_compile(s->driver->pcap, &fp, filter_exp, 0, net) == -1)
+    {
+        fprintf(stderr, "Error in pcap_compile: %s\n", pcap_geterr(s->driver->pcap));
+        return -1;
+    }
+    if (pcap_setfilter(s->driver->pcap, &fp) == -1)
+    {
+        fprintf(stderr, "Error in pcap_setfilter: %s\n", pcap_geterr(s->driver->pcap));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 打开一个只用于发送的网卡句柄
+ *        libpcap的句柄不能在线程间共用，每个发送线程单独打开一个，并挂载丢弃全部数据帧的过滤器
+ * 
+ * @param rx 接收线程打开网卡时的驱动状态，不使用
+ * @return int 成功为0，失败为-1
+ */
+int driver_open_tx(struct driver_layer *rx)
+{
+    net_stack_t *s = net_stack;
+    struct bpf_insn drop = BPF_STMT(BPF_RET | BPF_K, 0);
+    struct bpf_program fp = {.bf_len = 1, .bf_insns = &drop};
+
+    (void)rx;
+    if (s->driver == NULL && (s->driver = calloc(1, sizeof(driver_layer_t))) == NULL)
+    {
+        fprintf(stderr, "Error in driver_open_tx: out of memory\n");
+        return -1;
+    }
+    if ((s->driver->pcap = pcap_open_live(s->if_name, 65536, 0, 10, s->driver->errbuf)) == NULL)
+    {
+        fprintf(stderr, "Error in pcap_open_live: %s.\n", s->driver->errbuf);
+        return -1;
+    }
+    if (pcap_setfilter(s->driver->pcap, &fp) == -1) // 不接收，内核直接丢弃
+    {
+        fprintf(stderr, "Error in pcap_setfilter: %s\n", pcap_geterr(s->driver->pcap));
+        driver_close();
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 试图从网卡接收数据包
+ * 
+ * @param buf 收到的数据包
+ * @return int 数据包的长度，未收到为0，错误为-1
+ */
+int driver_recv(buf_t *buf)
+{
+    net_stack_t *s = net_stack;
+    struct pcap_pkthdr *pkt_hdr;
+    const uint8_t *pkt_data;
+
+    // 从本网卡接口获取一个数据报文
+    int ret = pcap_next_ex(s->driver->pcap, &pkt_hdr, &pkt_data);
+    if (ret == 0)
+        return 0;
+    else if (ret == 1)
+    {
+        if (buf_init(buf, pkt_hdr->len) != 0) //超过缓冲区容量的帧直接丢弃
+            return 0;
+        memcpy(buf->data, pkt_data, pkt_hdr->len);
+        return pkt_hdr->len;
+    }
+    fprintf(stderr, "Error in driver_recv: %s\n", pcap_geterr(s->driver->pcap));
+    return -1;
+}
+
+/**
+ * @brief 使用网卡发送一个数据包
+ * 
+ * @param buf 要发送的数据包
+ * @return int 成功为0，失败为-1
+ */
+int driver_send(buf_t *buf)
+{
+    net_stack_t *s = net_stack;
+    static __thread uint8_t frame[BUF_MAX_LEN]; // 每个线程一块拼接缓冲区，不占用栈
+    uint8_t *data = buf->data;
+    if (buf->seg_len) // pcap_sendpacket只能发送连续的数据，挂接了外部数据段时先拼接
+    {
+        memcpy(frame, buf->data, buf->len);
+        memcpy(frame + buf->len, buf->seg_data, buf->seg_len);
+        data = frame;
+    }
+    // 将数据包发往指定的网卡接口
+    if (pcap_sendpacket(s->driver->pcap, data, buf_total_len(buf)) == -1)
+    {
+        fprintf(stderr, "Error in driver_send: %s\n", pcap_geterr(s->driver->pcap));
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 试图从网卡批量接收数据包
+ * 
+ * @param bufs 接收缓冲区数组
+ * @param max 最多接收的数据包数
+ * @return int 收到的数据包数，未收到为0，错误为-1
+ */
+int driver_recv_batch(buf_t **bufs, int max)
+{
+    int n = 0, ret = 0;
+    while (n < max && (ret = driver_recv(bufs[n])) > 0)
+        n++;
+    return n == 0 && ret < 0 ? -1 : n;
+}
+
+/**
+ * @brief 使用网卡批量发送数据包
+ *        libpcap在Linux下的描述符就是绑定到网卡的AF_PACKET套接字，
+ *        直接在上面用sendmmsg一次发出多个数据包；拿不到描述符时逐个发送
+ * 
+ * @param bufs 要发送的数据包数组
+ * @param n 数据包数
+ * @return int 成功发送的数据包数，失败为-1
+ */
+int driver_send_batch(buf_t **bufs, int n)
+{
+    net_stack_t *s = net_stack;
+    struct mmsghdr msgs[ETHERNET_TX_BATCH];
+    struct iovec iovs[ETHERNET_TX_BATCH][2];
+    int fd = pcap_get_selectable_fd(s->driver->pcap);
+    int sent = 0;
+
+    if (fd == -1)
+    {
+        for (; sent < n; sent++)
+            if (driver_send(bufs[sent]) != 0)
+                return sent ? sent : -1;
+        return sent;
+    }
+    while (sent < n)
+    {
+        int cnt = n - sent < ETHERNET_TX_BATCH ? n - sent : ETHERNET_TX_BATCH;
+        memset(msgs, 0, sizeof(msgs[0]) * cnt);
+        for (int i = 0; i < cnt; i++)
+        {
+            msgs[i].msg_hdr.msg_iov = iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = buf_iovec(bufs[sent + i], iovs[i]);
+        }
+        int ret = sendmmsg(fd, msgs, cnt, 0);
+        if (ret == -1)
+        {
+            fprintf(stderr, "Error in driver_send_batch: %s\n", strerror(errno));
+            return sent ? sent : -1;
+        }
+        sent += ret;
+    }
+    return sent;
+}
+
+/**
+ * @brief 获取网卡可用于epoll等待的描述符
+ * 
+ * @return int 描述符，不支持时为-1
+ */
+int driver_get_fd()
+{
+    net_stack_t *s = net_stack;
+    return pcap_get_selectable_fd(s->driver->pcap);
+}
+
+/**
+ * @brief 网卡MTU改变时通知驱动
+ *        物理网卡的MTU由系统配置，以65536字节捕获，不需要调整
+ * 
+ * @param mtu 新的MTU
+ * @return int 成功为0，失败为-1
+ */
+int driver_set_mtu(int mtu)
+{
+    (void)mtu;
+    return 0;
+}
+
+/**
+ * @brief 关闭网卡
+ * 
+ */
+void driver_close()
+{
+    net_stack_t *s = net_stack;
+    if (s->driver->pcap)
+        pcap_close(s->driver->pcap);
+    s->driver->pcap = NULL;
+}
+#endif
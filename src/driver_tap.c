@@ -0,0 +1,295 @@
+#include "config.h"
+#if DRIVER_TYPE == DRIVER_TAP
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+#include <linux/virtio_net.h>
+#include "utils.h"
+#include "driver.h"
+#include "net.h"
+
+#define TAP_ETH_HDR_LEN 14    // 以太网头部长度
+#define TAP_UDP_CSUM_OFFSET 6 // UDP校验和字段在UDP头部中的偏移
+
+/**
+ * @brief 驱动状态，每个协议栈实例一份
+ *
+ */
+typedef struct driver_layer
+{
+    int fd; // /dev/net/tun描述符
+} driver_layer_t;
+
+/**
+ * @brief 启用TAP网卡
+ *
+ * @return int 成功为0，失败为-1
+ */
+static int tap_up()
+{
+    struct ifreq ifr;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd == -1)
+    {
+        fprintf(stderr, "Error in socket: %s\n", strerror(errno));
+        return -1;
+    }
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, net_stack->if_name, IFNAMSIZ - 1);
+    if (ioctl(fd, SIOCGIFFLAGS, &ifr) == -1 ||
+        (ifr.ifr_flags |= IFF_UP, ioctl(fd, SIOCSIFFLAGS, &ifr) == -1))
+    {
+        fprintf(stderr, "Error in SIOCSIFFLAGS: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+/**
+ * @brief 根据buf的卸载标志填写要发送的virtio-net头部
+ *        只填了伪头部校验和的UDP包交给内核补全校验和，超过MTU时再由内核分片(UFO)
+ *
+ * @param buf 要发送的数据帧
+ * @param vnet_hdr 要填写的virtio-net头部
+ */
+static void tap_vnet_hdr(buf_t *buf, struct virtio_net_hdr *vnet_hdr)
+{
+    memset(vnet_hdr, 0, sizeof(*vnet_hdr));
+    if (!(buf->flags & BUF_FLAG_CSUM_PARTIAL))
+        return;
+    int ip_hdr_len = (buf->data[TAP_ETH_HDR_LEN] & 0x0f) * 4;
+    vnet_hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+    vnet_hdr->csum_start = TAP_ETH_HDR_LEN + ip_hdr_len;
+    vnet_hdr->csum_offset = TAP_UDP_CSUM_OFFSET;
+    if (buf_total_len(buf) > TAP_ETH_HDR_LEN + net_stack->if_mtu)
+    {
+        vnet_hdr->gso_type = VIRTIO_NET_HDR_GSO_UDP;
+        vnet_hdr->gso_size = (net_stack->if_mtu - ip_hdr_len) & ~7; // 分片偏移必须是8字节的整数倍
+        vnet_hdr->hdr_len = TAP_ETH_HDR_LEN + ip_hdr_len + 8;
+    }
+}
+
+/**
+ * @brief 打开网卡
+ *        打开或创建协议栈实例对应的虚拟网卡(默认为TAP_IF_NAME)，每个数据帧前带一个virtio-net头部。
+ *        主机一侧需要给该网卡配置与DRIVER_IF_IP同网段的地址，例如：
+ *        ip addr add 192.168.133.1/24 dev tap0
+ *
+ * @return int 成功为0，失败为-1
+ */
+int driver_open()
+{
+    net_stack_t *s = net_stack;
+    struct ifreq ifr;
+    int vnet_hdr_len = sizeof(struct virtio_net_hdr);
+
+    if (s->driver == NULL && (s->driver = calloc(1, sizeof(driver_layer_t))) == NULL)
+    {
+        fprintf(stderr, "Error in driver_open: out of memory\n");
+        return -1;
+    }
+    if ((s->driver->fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK)) == -1)
+    {
+        fprintf(stderr, "Error in open /dev/net/tun: %s\n", strerror(errno));
+        return -1;
+    }
+    memset(&ifr, 0, sizeof(ifr));
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI | IFF_VNET_HDR;
+    strncpy(ifr.ifr_name, s->if_name, IFNAMSIZ - 1);
+    if (ioctl(s->driver->fd, TUNSETIFF, &ifr) == -1)
+    {
+        fprintf(stderr, "Error in TUNSETIFF: %s\n", strerror(errno));
+        goto error;
+    }
+    if (ioctl(s->driver->fd, TUNSETVNETHDRSZ, &vnet_hdr_len) == -1)
+    {
+        fprintf(stderr, "Error in TUNSETVNETHDRSZ: %s\n", strerror(errno));
+        goto error;
+    }
+    // 告诉内核协议栈可以接收未计算校验和的帧，本机发来的包就不必再算校验和
+    if (ioctl(s->driver->fd, TUNSETOFFLOAD, TAP_OFFLOAD ? TUN_F_CSUM : 0) == -1)
+    {
+        fprintf(stderr, "Error in TUNSETOFFLOAD: %s\n", strerror(errno));
+        goto error;
+    }
+    if (tap_up() != 0 || driver_set_mtu(s->if_mtu) != 0)
+        goto error;
+    return 0;
+
+error:
+    driver_close();
+    return -1;
+}
+
+/**
+ * @brief 打开一个只用于发送的网卡句柄
+ *        没有IFF_MULTI_QUEUE的TAP网卡只能打开一次，复制接收线程的描述符，每次写入一个完整的数据帧
+ *
+ * @param rx 接收线程打开网卡时的驱动状态
+ * @return int 成功为0，失败为-1
+ */
+int driver_open_tx(struct driver_layer *rx)
+{
+    net_stack_t *s = net_stack;
+    if (s->driver == NULL && (s->driver = calloc(1, sizeof(driver_layer_t))) == NULL)
+    {
+        fprintf(stderr, "Error in driver_open_tx: out of memory\n");
+        return -1;
+    }
+    if ((s->driver->fd = dup(rx->fd)) == -1)
+    {
+        fprintf(stderr, "Error in dup: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 试图从网卡接收数据包
+ *        内核已验证过校验和(DATA_VALID)或本机发出尚未计算校验和(NEEDS_CSUM)的帧，
+ *        标记为BUF_FLAG_CSUM_VALID，上层不再验证传输层校验和，ip首部校验和仍要验证
+ *
+ * @param buf 收到的数据包
+ * @return int 数据包的长度，未收到为0，错误为-1
+ */
+int driver_recv(buf_t *buf)
+{
+    net_stack_t *s = net_stack;
+    struct virtio_net_hdr vnet_hdr;
+    struct iovec iov[2];
+    ssize_t len;
+
+    buf_init(buf, 0);
+    iov[0].iov_base = &vnet_hdr;
+    iov[0].iov_len = sizeof(vnet_hdr);
+    iov[1].iov_base = buf->data;
+    iov[1].iov_len = buf_capacity(buf);
+    if ((len = readv(s->driver->fd, iov, 2)) == -1)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return 0;
+        fprintf(stderr, "Error in driver_recv: %s\n", strerror(errno));
+        return -1;
+    }
+    if (len <= (ssize_t)sizeof(vnet_hdr))
+        return 0;
+    buf->len = len - sizeof(vnet_hdr);
+    if (vnet_hdr.flags & (VIRTIO_NET_HDR_F_DATA_VALID | VIRTIO_NET_HDR_F_NEEDS_CSUM))
+        buf->flags |= BUF_FLAG_CSUM_VALID;
+    return buf->len;
+}
+
+/**
+ * @brief 使用网卡发送一个数据包
+ *
+ * @param buf 要发送的数据包
+ * @return int 成功为0，失败为-1
+ */
+int driver_send(buf_t *buf)
+{
+    net_stack_t *s = net_stack;
+    struct virtio_net_hdr vnet_hdr;
+    struct iovec iov[3];
+
+    tap_vnet_hdr(buf, &vnet_hdr);
+    iov[0].iov_base = &vnet_hdr;
+    iov[0].iov_len = sizeof(vnet_hdr);
+    if (writev(s->driver->fd, iov, 1 + buf_iovec(buf, &iov[1])) == -1)
+    {
+        fprintf(stderr, "Error in driver_send: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 试图从网卡批量接收数据包
+ *        TAP设备没有批量读写的系统调用，逐个读取
+ *
+ * @param bufs 接收缓冲区数组
+ * @param max 最多接收的数据包数
+ * @return int 收到的数据包数，未收到为0，错误为-1
+ */
+int driver_recv_batch(buf_t **bufs, int max)
+{
+    int n = 0, ret = 0;
+    while (n < max && (ret = driver_recv(bufs[n])) > 0)
+        n++;
+    return n == 0 && ret < 0 ? -1 : n;
+}
+
+/**
+ * @brief 使用网卡批量发送数据包
+ *        TAP设备没有批量读写的系统调用，逐个发送；超长UDP包由内核分片，本身就只需一次调用
+ *
+ * @param bufs 要发送的数据包数组
+ * @param n 数据包数
+ * @return int 成功发送的数据包数，失败为-1
+ */
+int driver_send_batch(buf_t **bufs, int n)
+{
+    int sent;
+    for (sent = 0; sent < n; sent++)
+        if (driver_send(bufs[sent]) != 0)
+            return sent ? sent : -1;
+    return sent;
+}
+
+/**
+ * @brief 获取网卡可用于epoll等待的描述符
+ *
+ * @return int 描述符，不支持时为-1
+ */
+int driver_get_fd()
+{
+    net_stack_t *s = net_stack;
+    return s->driver->fd;
+}
+
+/**
+ * @brief 网卡MTU改变时通知驱动
+ *        同步修改TAP网卡的设备MTU，主机一侧才会发出和接收对应大小的帧
+ *
+ * @param mtu 新的MTU
+ * @return int 成功为0，失败为-1
+ */
+int driver_set_mtu(int mtu)
+{
+    struct ifreq ifr;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0), ret;
+    if (fd == -1)
+    {
+        fprintf(stderr, "Error in socket: %s\n", strerror(errno));
+        return -1;
+    }
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, net_stack->if_name, IFNAMSIZ - 1);
+    ifr.ifr_mtu = mtu;
+    if ((ret = ioctl(fd, SIOCSIFMTU, &ifr)) == -1)
+        fprintf(stderr, "Error in SIOCSIFMTU: %s\n", strerror(errno));
+    close(fd);
+    return ret == -1 ? -1 : 0;
+}
+
+/**
+ * @brief 关闭网卡
+ *
+ */
+void driver_close()
+{
+    net_stack_t *s = net_stack;
+    if (s->driver->fd != -1)
+        close(s->driver->fd);
+    s->driver->fd = -1;
+}
+#endif
@@ -0,0 +1,399 @@
+#define _GNU_SOURCE
+#include "config.h"
+#if DRIVER_TYPE == DRIVER_TPACKET
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+#include "utils.h"
+#include "driver.h"
+#include "net.h"
+
+/**
+ * @brief 驱动状态，每个协议栈实例一份
+ *
+ */
+typedef struct driver_layer
+{
+    int sock;                   // AF_PACKET套接字
+    uint8_t *ring;              // mmap映射的接收环
+    struct tpacket_req3 req;    // 接收环参数
+    unsigned int block_idx;     // 当前读取的块号
+    struct tpacket3_hdr *frame; // 当前块中下一个要读取的帧，为NULL表示还未开始读当前块
+    uint32_t frames_left;       // 当前块中尚未读取的帧数
+    unsigned int blocks_done;   // 当前块之前已读完、等待归还内核的块数
+} driver_layer_t;
+
+/**
+ * @brief 获取接收环中的一个块
+ *
+ * @param idx 块号
+ * @return struct tpacket_block_desc* 块描述符
+ */
+static struct tpacket_block_desc *block_at(unsigned int idx)
+{
+    net_stack_t *s = net_stack;
+    return (struct tpacket_block_desc *)(s->driver->ring + (size_t)idx * s->driver->req.tp_block_size);
+}
+
+/**
+ * @brief 当前块已读完，移动到下一个块，读完的块暂不归还内核
+ *
+ */
+static void block_next()
+{
+    net_stack_t *s = net_stack;
+    s->driver->block_idx = (s->driver->block_idx + 1) % s->driver->req.tp_block_nr;
+    s->driver->blocks_done++;
+    s->driver->frame = NULL;
+}
+
+/**
+ * @brief 将之前读完的块全部归还内核
+ *
+ */
+static void blocks_release()
+{
+    net_stack_t *s = net_stack;
+    for (; s->driver->blocks_done > 0; s->driver->blocks_done--)
+    {
+        unsigned int idx = (s->driver->block_idx + s->driver->req.tp_block_nr - s->driver->blocks_done) % s->driver->req.tp_block_nr;
+        __atomic_store_n(&block_at(idx)->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @brief 在套接字上挂载BPF过滤器
+ *        与libpcap驱动的过滤规则相同：只接收发往本网卡mac或广播的数据帧，且丢弃本网卡发出的数据帧，
+ *        不需要的帧在内核中就被丢弃，不会占用接收环
+ *
+ * @return int 成功为0，失败为-1
+ */
+static int attach_filter()
+{
+    net_stack_t *s = net_stack;
+    uint8_t *mac = net_if_mac;
+    uint32_t mac_hi = (uint32_t)mac[0] << 24 | mac[1] << 16 | mac[2] << 8 | mac[3];
+    uint32_t mac_lo = mac[4] << 8 | mac[5];
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 0),               // 目的mac前4字节
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, mac_hi, 0, 2),
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 4),               // 目的mac后2字节
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, mac_lo, 3, 8),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0xffffffff, 0, 7), // 广播
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 4),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0xffff, 0, 5),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 6),               // 源mac前4字节
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, mac_hi, 0, 2),
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 10),              // 源mac后2字节
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, mac_lo, 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, 0x40000),                  // 接收
+        BPF_STMT(BPF_RET | BPF_K, 0),                        // 丢弃
+    };
+    struct sock_fprog prog = {
+        .len = sizeof(code) / sizeof(code[0]),
+        .filter = code};
+    if (setsockopt(s->driver->sock, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) == -1)
+    {
+        fprintf(stderr, "Error in SO_ATTACH_FILTER: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 打开网卡
+ *        创建AF_PACKET套接字，设置TPACKET_V3版本的接收环并映射到用户态，
+ *        之后收包只需读取共享内存，不需要每个包一次系统调用
+ *
+ * @return int 成功为0，失败为-1
+ */
+int driver_open()
+{
+    net_stack_t *s = net_stack;
+    int version = TPACKET_V3;
+    struct sockaddr_ll sll;
+    struct packet_mreq mreq;
+    int ifindex;
+
+    if (s->driver == NULL && (s->driver = calloc(1, sizeof(driver_layer_t))) == NULL)
+    {
+        fprintf(stderr, "Error in driver_open: out of memory\n");
+        return -1;
+    }
+    s->driver->sock = -1;
+    if ((ifindex = if_nametoindex(s->if_name)) == 0) //查找网卡
+    {
+        fprintf(stderr, "Error in if_nametoindex: %s\n", strerror(errno));
+        return -1;
+    }
+    if ((s->driver->sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL))) == -1)
+    {
+        fprintf(stderr, "Error in socket: %s\n", strerror(errno));
+        return -1;
+    }
+    if (attach_filter() != 0)
+        goto error;
+    if (setsockopt(s->driver->sock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) == -1)
+    {
+        fprintf(stderr, "Error in PACKET_VERSION: %s\n", strerror(errno));
+        goto error;
+    }
+
+    memset(&s->driver->req, 0, sizeof(s->driver->req));
+    s->driver->req.tp_block_size = TPACKET_BLOCK_SIZE;
+    s->driver->req.tp_block_nr = TPACKET_BLOCK_NR;
+    s->driver->req.tp_frame_size = TPACKET_FRAME_SIZE;
+    s->driver->req.tp_frame_nr = TPACKET_BLOCK_SIZE / TPACKET_FRAME_SIZE * TPACKET_BLOCK_NR;
+    s->driver->req.tp_retire_blk_tov = TPACKET_BLOCK_TIMEOUT;
+    if (setsockopt(s->driver->sock, SOL_PACKET, PACKET_RX_RING, &s->driver->req, sizeof(s->driver->req)) == -1)
+    {
+        fprintf(stderr, "Error in PACKET_RX_RING: %s\n", strerror(errno));
+        goto error;
+    }
+    s->driver->ring = mmap(NULL, (size_t)s->driver->req.tp_block_size * s->driver->req.tp_block_nr, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, s->driver->sock, 0);
+    if (s->driver->ring == MAP_FAILED)
+    {
+        s->driver->ring = NULL;
+        fprintf(stderr, "Error in mmap: %s\n", strerror(errno));
+        goto error;
+    }
+    s->driver->block_idx = 0;
+    s->driver->blocks_done = 0;
+    s->driver->frame = NULL;
+
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = ifindex;
+    if (bind(s->driver->sock, (struct sockaddr *)&sll, sizeof(sll)) == -1)
+    {
+        fprintf(stderr, "Error in bind: %s\n", strerror(errno));
+        goto error;
+    }
+
+    memset(&mreq, 0, sizeof(mreq)); //混杂模式，自定义的mac地址与物理网卡不同
+    mreq.mr_ifindex = ifindex;
+    mreq.mr_type = PACKET_MR_PROMISC;
+    if (setsockopt(s->driver->sock, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) == -1)
+    {
+        fprintf(stderr, "Error in PACKET_ADD_MEMBERSHIP: %s\n", strerror(errno));
+        goto error;
+    }
+    return 0;
+
+error:
+    driver_close();
+    return -1;
+}
+
+/**
+ * @brief 打开一个只用于发送的网卡句柄
+ *        协议号为0的AF_PACKET套接字不接收任何数据帧，也不需要接收环
+ *
+ * @param rx 接收线程打开网卡时的驱动状态，不使用
+ * @return int 成功为0，失败为-1
+ */
+int driver_open_tx(struct driver_layer *rx)
+{
+    net_stack_t *s = net_stack;
+    struct sockaddr_ll sll;
+    int ifindex;
+
+    (void)rx;
+    if (s->driver == NULL && (s->driver = calloc(1, sizeof(driver_layer_t))) == NULL)
+    {
+        fprintf(stderr, "Error in driver_open_tx: out of memory\n");
+        return -1;
+    }
+    s->driver->sock = -1;
+    s->driver->ring = NULL;
+    if ((ifindex = if_nametoindex(s->if_name)) == 0)
+    {
+        fprintf(stderr, "Error in if_nametoindex: %s\n", strerror(errno));
+        return -1;
+    }
+    if ((s->driver->sock = socket(AF_PACKET, SOCK_RAW, 0)) == -1)
+    {
+        fprintf(stderr, "Error in socket: %s\n", strerror(errno));
+        return -1;
+    }
+    memset(&sll, 0, sizeof(sll)); // 绑定网卡后发送时不必指定地址
+    sll.sll_family = AF_PACKET;
+    sll.sll_ifindex = ifindex;
+    if (bind(s->driver->sock, (struct sockaddr *)&sll, sizeof(sll)) == -1)
+    {
+        fprintf(stderr, "Error in bind: %s\n", strerror(errno));
+        driver_close();
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 试图从网卡批量接收数据包
+ *        依次读取接收环中已交给用户态的块，buf->data直接指向共享内存中的帧，不做拷贝。
+ *        读完的块要等到下一次调用时才归还内核，保证这一批帧在协议栈处理期间不被覆盖
+ *
+ * @param bufs 接收缓冲区数组
+ * @param max 最多接收的数据包数
+ * @return int 收到的数据包数，未收到为0，错误为-1
+ */
+int driver_recv_batch(buf_t **bufs, int max)
+{
+    net_stack_t *s = net_stack;
+    struct tpacket_block_desc *block;
+    uint8_t *pkt;
+    int n = 0;
+
+    blocks_release();
+    while (n < max && s->driver->blocks_done < s->driver->req.tp_block_nr)
+    {
+        block = block_at(s->driver->block_idx);
+        if (s->driver->frame == NULL)
+        {
+            if ((__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0)
+                break;
+            s->driver->frames_left = block->hdr.bh1.num_pkts;
+            if (s->driver->frames_left == 0)
+            {
+                block_next();
+                continue;
+            }
+            s->driver->frame = (struct tpacket3_hdr *)((uint8_t *)block + block->hdr.bh1.offset_to_first_pkt);
+        }
+
+        buf_t *buf = bufs[n++];
+        pkt = (uint8_t *)s->driver->frame + s->driver->frame->tp_mac;
+        buf->len = s->driver->frame->tp_snaplen;
+        if (pkt + buf->len < (uint8_t *)block + s->driver->req.tp_block_size)
+            buf->data = pkt;
+        else if (buf_init(buf, s->driver->frame->tp_snaplen) == 0) // 帧紧贴块末尾时，上层在数据末尾补零会越界，复制一份
+            memcpy(buf->data, pkt, buf->len);
+        else // 超过缓冲区容量，丢弃
+            n--;
+        // 内核已验证过传输层校验和，或是本机发出尚未计算校验和的包，上层不必再验证传输层校验和
+        buf->flags = s->driver->frame->tp_status & (TP_STATUS_CSUM_VALID | TP_STATUS_CSUMNOTREADY) ? BUF_FLAG_CSUM_VALID : 0;
+
+        if (--s->driver->frames_left == 0)
+            block_next();
+        else
+            s->driver->frame = (struct tpacket3_hdr *)((uint8_t *)s->driver->frame + s->driver->frame->tp_next_offset);
+    }
+    return n;
+}
+
+/**
+ * @brief 试图从网卡接收数据包
+ *
+ * @param buf 收到的数据包
+ * @return int 数据包的长度，未收到为0，错误为-1
+ */
+int driver_recv(buf_t *buf)
+{
+    return driver_recv_batch(&buf, 1) > 0 ? buf->len : 0;
+}
+
+/**
+ * @brief 使用网卡发送一个数据包
+ *
+ * @param buf 要发送的数据包
+ * @return int 成功为0，失败为-1
+ */
+int driver_send(buf_t *buf)
+{
+    net_stack_t *s = net_stack;
+    struct iovec iov[2];
+    struct msghdr msg = {.msg_iov = iov, .msg_iovlen = buf_iovec(buf, iov)};
+    if (sendmsg(s->driver->sock, &msg, 0) == -1)
+    {
+        fprintf(stderr, "Error in driver_send: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 使用网卡批量发送数据包
+ *        用sendmmsg一次系统调用发出一批数据包
+ *
+ * @param bufs 要发送的数据包数组
+ * @param n 数据包数
+ * @return int 成功发送的数据包数，失败为-1
+ */
+int driver_send_batch(buf_t **bufs, int n)
+{
+    net_stack_t *s = net_stack;
+    struct mmsghdr msgs[ETHERNET_TX_BATCH];
+    struct iovec iovs[ETHERNET_TX_BATCH][2];
+    int sent = 0;
+
+    while (sent < n)
+    {
+        int cnt = n - sent < ETHERNET_TX_BATCH ? n - sent : ETHERNET_TX_BATCH;
+        memset(msgs, 0, sizeof(msgs[0]) * cnt);
+        for (int i = 0; i < cnt; i++)
+        {
+            msgs[i].msg_hdr.msg_iov = iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = buf_iovec(bufs[sent + i], iovs[i]);
+        }
+        int ret = sendmmsg(s->driver->sock, msgs, cnt, 0);
+        if (ret == -1)
+        {
+            fprintf(stderr, "Error in driver_send_batch: %s\n", strerror(errno));
+            return sent ? sent : -1;
+        }
+        sent += ret;
+    }
+    return sent;
+}
+
+/**
+ * @brief 获取网卡可用于epoll等待的描述符
+ *        接收环中有块交给用户态时套接字可读
+ *
+ * @return int 描述符，不支持时为-1
+ */
+int driver_get_fd()
+{
+    net_stack_t *s = net_stack;
+    return s->driver->sock;
+}
+
+/**
+ * @brief 网卡MTU改变时通知驱动
+ *        物理网卡的MTU由系统配置；TPACKET_V3的帧长度可变，接收环不需要调整
+ *
+ * @param mtu 新的MTU
+ * @return int 成功为0，失败为-1
+ */
+int driver_set_mtu(int mtu)
+{
+    (void)mtu;
+    return 0;
+}
+
+/**
+ * @brief 关闭网卡
+ *
+ */
+void driver_close()
+{
+    net_stack_t *s = net_stack;
+    if (s->driver->ring)
+        munmap(s->driver->ring, (size_t)s->driver->req.tp_block_size * s->driver->req.tp_block_nr);
+    s->driver->ring = NULL;
+    if (s->driver->sock != -1)
+        close(s->driver->sock);
+    s->driver->sock = -1;
+}
+#endif
@@ -1,85 +1,272 @@
-#include "ethernet.h"
-#include "utils.h"
-#include "driver.h"
-#include "arp.h"
-#include "ip.h"
-#include <string.h>
-#include <stdio.h>
-
-/**
- * @brief 处理一个收到的数据包
- *        你需要判断以太网数据帧的协议类型，注意大小端转换
- *        如果是ARP协议数据包，则去掉以太网包头，发送到arp层处理arp_in()
- *        如果是IP协议数据包，则去掉以太网包头，发送到IP层处理ip_in()
- * 
- * @param buf 要处理的数据包
- */
-void ethernet_in(buf_t *buf)
-{   
-    // TODO
-    int proto = buf->data[12];
-    proto <<= 8;
-    proto |= buf->data[13];
-    switch(proto){
-        case 0x0806:
-            //去掉以太包头
-            buf->len -= 14;
-            buf->data += 14;
-            arp_in(buf);
-            break;
-        case 0x0800:
-            //去掉以太包头
-            buf->len -= 14;
-            buf->data += 14;
-            ip_in(buf);
-            break;
-        default:break;
-    }
-}
-
-/**
- * @brief 处理一个要发送的数据包
- *        你需添加以太网包头，填写目的MAC地址、源MAC地址、协议类型
- *        添加完成后将以太网数据帧发送到驱动层
- * 
- * @param buf 要处理的数据包
- * @param mac 目标mac地址
- * @param protocol 上层协议
- */
-void ethernet_out(buf_t *buf, const uint8_t *mac, net_protocol_t protocol)
-{
-    // TODO
-    //为buffer在头部增加一段长度，用于添加协议头
-    //前14个字节分别是目的地址,源地址和类型
-    buf_add_header(buf,14);
-    for(int i=0;i<6;i++){
-        buf->data[i] = mac[i];
-    }
-    for(int i=6;i<12;i++){
-        buf->data[i] = net_if_mac[i-6];
-    }
-    buf->data[12]=(protocol>>8)&0xff;
-    buf->data[13]=protocol&0xff;
-    driver_send(buf);
-}
-
-/**
- * @brief 初始化以太网协议
- * 
- * @return int 成功为0，失败为-1
- */
-int ethernet_init()
-{
-    buf_init(&rxbuf, ETHERNET_MTU + sizeof(ether_hdr_t));
-    return driver_open();
-}
-
-/**
- * @brief 一次以太网轮询
- * 
- */
-void ethernet_poll()
-{
-    if (driver_recv(&rxbuf) > 0)
-        ethernet_in(&rxbuf);
-}
+#include "ethernet.h"
+#include "utils.h"
+#include "driver.h"
+#include "arp.h"
+#include "ip.h"
+#include "rss.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * @brief 以太网层状态，每个协议栈实例一份
+ * 
+ */
+typedef struct ethernet_layer
+{
+    buf_t *rx_bufs[ETHERNET_RX_BATCH];  //批量接收缓冲区
+    buf_t *tx_queue[ETHERNET_TX_BATCH]; //发送队列，持有数据帧的引用
+    int tx_count;                       //发送队列中的数据帧数
+    int tx_batching;                    //批量发送的嵌套深度
+} ethernet_layer_t;
+
+/**
+ * @brief 成批处理收到的数据帧
+ *        你需要判断以太网数据帧的协议类型，注意大小端转换
+ *        如果是ARP协议数据包，则去掉以太网包头，发送到arp层处理arp_in()
+ *        如果是IP协议数据包，则去掉以太网包头，放入一批，全部分类后一起交给IP层处理ip_in_burst()，
+ *        每层的代码和数据在处理一批时保持在缓存中；处理当前帧时预取下一帧的报头
+ * 
+ * @param bufs 要处理的数据帧
+ * @param n 数据帧数
+ */
+void ethernet_in_burst(buf_t **bufs, int n)
+{
+    buf_t *ip_bufs[NET_BURST_MAX];
+    int nip = 0;
+    for(int i = 0; i < n; i++){
+        buf_t *buf = bufs[i];
+        if(i + 1 < n){
+            __builtin_prefetch(bufs[i + 1]->data);
+        }
+        // 不足一个以太网包头的残帧直接丢弃，否则去掉包头后长度会回绕
+        if(buf->len < sizeof(ether_hdr_t)){
+            continue;
+        }
+        int proto = buf->data[12];
+        proto <<= 8;
+        proto |= buf->data[13];
+        buf->flags |= BUF_FLAG_RX_FRAME;
+        switch(proto){
+            case 0x0806:
+                //去掉以太包头
+                buf->len -= 14;
+                buf->data += 14;
+                arp_in(buf);
+                break;
+            case 0x0800:
+                //去掉以太包头
+                buf->len -= 14;
+                buf->data += 14;
+                ip_bufs[nip++] = buf;
+                if(nip == NET_BURST_MAX){
+                    ip_in_burst(ip_bufs, nip);
+                    nip = 0;
+                }
+                break;
+            default:break;
+        }
+    }
+    if(nip > 0){
+        ip_in_burst(ip_bufs, nip);
+    }
+}
+
+/**
+ * @brief 处理一个收到的数据包
+ * 
+ * @param buf 要处理的数据包
+ */
+void ethernet_in(buf_t *buf)
+{   
+    ethernet_in_burst(&buf, 1);
+}
+
+/**
+ * @brief 把发送队列中的数据帧一次交给驱动
+ * 
+ */
+static void ethernet_flush()
+{
+    net_stack_t *s = net_stack;
+    if (s->ethernet->tx_count > 0)
+        driver_send_batch(s->ethernet->tx_queue, s->ethernet->tx_count);
+    for (int i = 0; i < s->ethernet->tx_count; i++)
+        buf_free(s->ethernet->tx_queue[i]);
+    s->ethernet->tx_count = 0;
+}
+
+/**
+ * @brief 把封装好的数据帧交给驱动，批量发送期间先放入发送队列
+ * 
+ * @param buf 已填好以太网包头的数据帧
+ */
+void ethernet_xmit(buf_t *buf)
+{
+    net_stack_t *s = net_stack;
+    if (!s->ethernet->tx_batching)
+    {
+        driver_send(buf);
+        return;
+    }
+    //批量发送期间，发送队列持有数据帧的引用，上层可以直接释放自己的buffer
+    if (s->ethernet->tx_count == ETHERNET_TX_BATCH)
+        ethernet_flush();
+    if ((s->ethernet->tx_queue[s->ethernet->tx_count] = buf_ref(buf)) == NULL)
+        driver_send(buf);
+    else
+        s->ethernet->tx_count++;
+}
+
+/**
+ * @brief 处理一个要发送的数据包
+ *        你需添加以太网包头，填写目的MAC地址、源MAC地址、协议类型
+ *        添加完成后将以太网数据帧发送到驱动层
+ * 
+ * @param buf 要处理的数据包
+ * @param mac 目标mac地址
+ * @param protocol 上层协议
+ */
+void ethernet_out(buf_t *buf, const uint8_t *mac, net_protocol_t protocol)
+{
+    // TODO
+    //为buffer在头部增加一段长度，用于添加协议头
+    //前14个字节分别是目的地址,源地址和类型
+    buf_add_header(buf,14);
+    for(int i=0;i<6;i++){
+        buf->data[i] = mac[i];
+    }
+    for(int i=6;i<12;i++){
+        buf->data[i] = net_if_mac[i-6];
+    }
+    buf->data[12]=(protocol>>8)&0xff;
+    buf->data[13]=protocol&0xff;
+    ethernet_xmit(buf);
+}
+
+/**
+ * @brief 把收到的数据帧原地改写后发回给发送方
+ *        buf必须带有BUF_FLAG_RX_FRAME标志，以太网包头仍在头部空间中；
+ *        目的mac直接取原来的源mac，不查arp表，协议类型不变
+ * 
+ * @param buf 去掉以太网包头后的数据包
+ */
+void ethernet_reply(buf_t *buf)
+{
+    buf_add_header(buf, sizeof(ether_hdr_t));
+    memcpy(buf->data, buf->data + NET_MAC_LEN, NET_MAC_LEN);
+    memcpy(buf->data + NET_MAC_LEN, net_if_mac, NET_MAC_LEN);
+    buf->flags &= ~BUF_FLAG_RX_FRAME;
+    ethernet_xmit(buf);
+}
+
+/**
+ * @brief 初始化以太网协议
+ * 
+ * @return int 成功为0，失败为-1
+ */
+int ethernet_init()
+{
+    net_stack_t *s = net_stack;
+    if (s->ethernet == NULL && (s->ethernet = calloc(1, sizeof(ethernet_layer_t))) == NULL)
+    {
+        fprintf(stderr, "Error in ethernet_init: out of memory\n");
+        return -1;
+    }
+    s->ethernet->tx_count = 0;
+    s->ethernet->tx_batching = 0;
+    if (s->rxq != NULL) // 数据帧由RSS接收线程分发，发送句柄已由rss_start()打开
+        return 0;
+    for (int i = 0; i < ETHERNET_RX_BATCH; i++)
+        if (s->ethernet->rx_bufs[i] == NULL && (s->ethernet->rx_bufs[i] = buf_alloc(s->if_mtu + sizeof(ether_hdr_t))) == NULL)
+            return -1;
+    return driver_open();
+}
+
+/**
+ * @brief 修改当前协议栈的网卡MTU
+ *        同时通知驱动，接收缓冲区在之后的轮询中按新的MTU更换
+ * 
+ * @param mtu 新的MTU，在ETHERNET_MIN_MTU与ETHERNET_MAX_MTU之间
+ * @return int 成功为0，失败为-1
+ */
+int ethernet_set_mtu(int mtu)
+{
+    if (mtu < ETHERNET_MIN_MTU || mtu > ETHERNET_MAX_MTU)
+    {
+        fprintf(stderr, "Error in ethernet_set_mtu: invalid mtu %d\n", mtu);
+        return -1;
+    }
+    if (net_stack->driver != NULL && driver_set_mtu(mtu) != 0)
+        return -1;
+    net_stack->if_mtu = mtu;
+    return 0;
+}
+
+/**
+ * @brief 一次以太网轮询
+ *        批量接收数据帧并依次交给上层处理，RSS工作线程从自己的分发队列接收
+ * 
+ * @param budget 最多处理的数据包数
+ * @return int 处理的数据包数
+ */
+int ethernet_poll(int budget)
+{
+    net_stack_t *s = net_stack;
+    buf_t *bufs[ETHERNET_RX_BATCH];
+    int n;
+
+    if (budget > ETHERNET_RX_BATCH)
+        budget = ETHERNET_RX_BATCH;
+    if (s->rxq != NULL) // RSS工作线程，数据帧已复制到独立的buffer中
+    {
+        n = rss_queue_recv(s->rxq, bufs, budget);
+        ethernet_in_burst(bufs, n);
+        for (int i = 0; i < n; i++)
+            buf_free(bufs[i]);
+        return n;
+    }
+    for (int i = 0; i < budget; i++)
+    {
+        //上层保留了这个buffer，或者MTU调大后装不下最大的帧，换一个新的
+        if (s->ethernet->rx_bufs[i]->ref > 1 || buf_capacity(s->ethernet->rx_bufs[i]) < s->if_mtu + (int)sizeof(ether_hdr_t))
+        {
+            buf_t *buf = buf_alloc(s->if_mtu + sizeof(ether_hdr_t));
+            if (buf == NULL)
+            {
+                budget = i;
+                break;
+            }
+            buf_free(s->ethernet->rx_bufs[i]);
+            s->ethernet->rx_bufs[i] = buf;
+        }
+        bufs[i] = s->ethernet->rx_bufs[i];
+    }
+    if ((n = driver_recv_batch(bufs, budget)) <= 0)
+        return 0;
+    ethernet_in_burst(bufs, n);
+    return n;
+}
+
+/**
+ * @brief 开始批量发送
+ *        之后ethernet_out()发送的数据帧先放入发送队列，可以嵌套调用
+ * 
+ */
+void ethernet_batch_begin()
+{
+    net_stack_t *s = net_stack;
+    s->ethernet->tx_batching++;
+}
+
+/**
+ * @brief 结束批量发送
+ *        最外层结束时把发送队列中的数据帧一次交给驱动
+ * 
+ */
+void ethernet_batch_end()
+{
+    net_stack_t *s = net_stack;
+    if (--s->ethernet->tx_batching == 0)
+        ethernet_flush();
+}
@@ -1,99 +1,379 @@
-#include "icmp.h"
-#include "ip.h"
-#include <string.h>
-#include <stdio.h>
-#include <stdlib.h>
-/**
- * @brief 处理一个收到的数据包
- *        你首先要检查buf长度是否小于icmp头部长度
- *        接着，查看该报文的ICMP类型是否为回显请求，
- *        如果是，则回送一个回显应答（ping应答），需要自行封装应答包。
- * 
- *        应答包封装如下：
- *        首先调用buf_init()函数初始化txbuf，然后封装报头和数据，
- *        数据部分可以拷贝来自接收到的回显请求报文中的数据。
- *        最后将封装好的ICMP报文发送到IP层。  
- * 
- * @param buf 要处理的数据包
- * @param src_ip 源ip地址
- */
-void icmp_in(buf_t *buf, uint8_t *src_ip)
-{
-    // TODO
-    icmp_hdr_t *icmp_hdr;
-    icmp_hdr_t new_icmp_hdr;
-    uint16_t data16[BUF_MAX_LEN],temp2;
-    // 检查buf长度是否小于icmp头部长度
-    // 首先做报头检测，检测报头长度等
-    if(buf->len < sizeof(icmp_hdr_t)){
-        return;
-    }
-    // 查看该报文的ICMP类型是否为回显请求
-    icmp_hdr = (icmp_hdr_t*) buf->data;
-    if(icmp_hdr->type != ICMP_TYPE_ECHO_REQUEST){
-        return;
-    }
-    // 是回显请求,回送一个回显应答
-    buf_init(&txbuf, buf->len); // 数据来自请求报文，报头与请求报文报头一样
-    // 数据部分拷贝回显请求报文中的数据
-    new_icmp_hdr.type = ICMP_TYPE_ECHO_REPLY;
-    new_icmp_hdr.code = 0;
-    new_icmp_hdr.id = icmp_hdr->id; // 标识，用于标识本ICMP进程
-    new_icmp_hdr.seq = icmp_hdr->seq; // 序列号，每发送一个回显请求报文便增加1
-    // 计算校验和
-    new_icmp_hdr.checksum = 0;
-    memcpy(txbuf.data, &new_icmp_hdr, sizeof(new_icmp_hdr));
-    memcpy(txbuf.data+sizeof(icmp_hdr_t), buf->data+sizeof(icmp_hdr_t), buf->len-sizeof(icmp_hdr_t));
-    // 手动将uint8数组转换为uint16型
-    for(int i = 0; i < buf->len/2; i++){
-        temp2 = (txbuf.data[2*i] << 8)&0xff00;
-        data16[i] = temp2 + txbuf.data[2*i+1];
-        data16[i] = swap16(data16[i]);
-    }
-    new_icmp_hdr.checksum = checksum16(data16, buf->len/2);
-    // 计算得到校验和后，再次给txbuf.data赋值
-    memcpy(txbuf.data, &new_icmp_hdr, sizeof(new_icmp_hdr));
-    // 将数据报发出
-    ip_out(&txbuf, src_ip, NET_PROTOCOL_ICMP);
-}
-
-/**
- * @brief 发送icmp不可达
- *        你需要首先调用buf_init初始化buf，长度为ICMP头部 + IP头部 + 原始IP数据报中的前8字节 
- *        填写ICMP报头首部，类型值为目的不可达
- *        填写校验和
- *        将封装好的ICMP数据报发送到IP层。
- * 
- * @param recv_buf 收到的ip数据包
- * @param src_ip 源ip地址
- * @param code icmp code，协议不可达或端口不可达
- */
-void icmp_unreachable(buf_t *recv_buf, uint8_t *src_ip, icmp_code_t code)
-{
-    // TODO
-    // 调用 buf_init 来初始化 txbuf
-    icmp_hdr_t icmp_hdr;
-    uint16_t data16[BUF_MAX_LEN],temp;
-    buf_init(&txbuf, ICMP_WRONG_LEN);
-    icmp_hdr.type = ICMP_TYPE_UNREACH; // 类型为目的不可达
-    icmp_hdr.code = code;
-    icmp_hdr.id = 0;
-    icmp_hdr.seq = 0; // 标识符和序列号未用，都为0
-    icmp_hdr.checksum = 0; // 校验和初始化为0
-    memcpy(txbuf.data, &icmp_hdr, sizeof(icmp_hdr_t));
-    // 复制IP数据报头部
-    memcpy(txbuf.data+sizeof(icmp_hdr_t), recv_buf->data, IP_HDR_LEN);
-    // 复制原始IP数据报中的前8字节
-    memcpy(txbuf.data+sizeof(icmp_hdr_t)+IP_HDR_LEN, recv_buf->data+IP_HDR_LEN, 8);
-    // 计算校验和
-    // 手动将uint8数组转换为uint16型
-    for(int i = 0; i < txbuf.len/2; i++){
-        temp = (txbuf.data[2*i] << 8)&0xff00;
-        data16[i] = temp + txbuf.data[2*i+1];
-        data16[i] = swap16(data16[i]);
-    }
-    icmp_hdr.checksum = checksum16(data16, txbuf.len/2);
-    // 更新后再次赋值
-    memcpy(txbuf.data, &icmp_hdr, sizeof(icmp_hdr_t));
-    ip_out(&txbuf, src_ip, NET_PROTOCOL_ICMP);
+#include "icmp.h"
+#include "ip.h"
+#include "ethernet.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "timer.h"
+#include "route.h"
+
+/**
+ * @brief 令牌桶
+ * 
+ */
+typedef struct icmp_bucket
+{
+    uint64_t stamp;          //上次补充令牌的时间(毫秒)
+    uint32_t tokens;         //剩余令牌数
+    uint8_t ip[NET_IP_LEN];  //按源地址限速时桶所属的地址
+} icmp_bucket_t;
+
+/**
+ * @brief 等待应答的回显请求
+ * 
+ */
+typedef struct icmp_echo
+{
+    timer_entry_t timer;           //超时定时器
+    uint64_t sent_ns;              //发送时间(纳秒)
+    icmp_echo_handler_t handler;   //结果回调，为NULL表示空闲
+    uint16_t seq;                  //序列号
+    int len;                       //数据长度
+    uint8_t ip[NET_IP_LEN];        //目的地址
+} icmp_echo_t;
+
+/**
+ * @brief icmp层状态，每个协议栈实例一份
+ * 
+ */
+typedef struct icmp_layer
+{
+    icmp_bucket_t global;                         //全局令牌桶
+    icmp_bucket_t src[ICMP_ERR_SRC_BUCKETS];      //按源地址哈希的令牌桶，冲突时新地址直接占用
+    icmp_stats_t stats;                           //计数
+    uint16_t echo_id;                             //本协议栈发出的回显请求的标识符
+    icmp_echo_t echo[ICMP_ECHO_MAX];              //等待应答的回显请求，按序列号索引
+} icmp_layer_t;
+
+/**
+ * @brief 读取精确的单调时钟，用于测量往返时间
+ * 
+ * @return uint64_t 当前时间(纳秒)
+ */
+static uint64_t icmp_clock_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief 按经过的时间补充令牌，再取出一个令牌
+ * 
+ * @param bucket 令牌桶
+ * @param rate 每秒补充的令牌数，为0时不限速
+ * @param burst 桶容量
+ * @param now 当前时间(毫秒)
+ * @return int 取到令牌为1，桶已空为0
+ */
+static int icmp_bucket_take(icmp_bucket_t *bucket, uint32_t rate, uint32_t burst, uint64_t now)
+{
+    uint64_t add;
+    if (rate == 0)
+        return 1;
+    if ((add = (now - bucket->stamp) * rate / 1000) > 0)
+    {
+        // 只推进补充的令牌对应的时间，不足一个令牌的余数留到下次
+        bucket->tokens = bucket->tokens + add >= burst ? burst : bucket->tokens + add;
+        bucket->stamp = bucket->tokens == burst ? now : bucket->stamp + add * 1000 / rate;
+    }
+    if (bucket->tokens == 0)
+        return 0;
+    bucket->tokens--;
+    return 1;
+}
+
+/**
+ * @brief 判断是否允许向一个地址发送差错报文
+ *        先查该源地址的令牌桶，再查全局令牌桶；源地址很多时按源地址限速会因冲突失效，由全局限速兜底
+ * 
+ * @param ip 差错报文的目的地址
+ * @return int 允许为1，否则为0
+ */
+static int icmp_err_allow(const uint8_t *ip)
+{
+    icmp_layer_t *icmp = net_stack->icmp;
+    uint64_t now = timer_now();
+    uint32_t key;
+    icmp_bucket_t *bucket;
+
+    memcpy(&key, ip, NET_IP_LEN);
+    bucket = &icmp->src[(key * 0x9E3779B1u) >> 16 & (ICMP_ERR_SRC_BUCKETS - 1)];
+    if (memcmp(bucket->ip, ip, NET_IP_LEN) != 0) // 新地址占用这个桶，从满桶开始
+    {
+        memcpy(bucket->ip, ip, NET_IP_LEN);
+        bucket->tokens = ICMP_ERR_SRC_BURST;
+        bucket->stamp = now;
+    }
+    if (!icmp_bucket_take(bucket, ICMP_ERR_SRC_RATE, ICMP_ERR_SRC_BURST, now))
+    {
+        icmp->stats.err_suppressed_src++;
+        return 0;
+    }
+    if (!icmp_bucket_take(&icmp->global, ICMP_ERR_RATE, ICMP_ERR_BURST, now))
+    {
+        icmp->stats.err_suppressed++;
+        return 0;
+    }
+    icmp->stats.err_sent++;
+    return 1;
+}
+
+/**
+ * @brief 初始化icmp协议
+ * 
+ * @return int 成功为0，失败为-1
+ */
+int icmp_init()
+{
+    if (timer_init() != 0)
+        return -1;
+    if (net_stack->icmp == NULL)
+    {
+        if ((net_stack->icmp = calloc(1, sizeof(icmp_layer_t))) == NULL)
+        {
+            fprintf(stderr, "Error in icmp_init: out of memory\n");
+            return -1;
+        }
+    }
+    else // 重新初始化，先停止等待中的回显请求
+    {
+        for (int i = 0; i < ICMP_ECHO_MAX; i++)
+            timer_del(&net_stack->icmp->echo[i].timer);
+        memset(net_stack->icmp, 0, sizeof(icmp_layer_t));
+    }
+    net_stack->icmp->global.tokens = ICMP_ERR_BURST;
+    net_stack->icmp->global.stamp = timer_now();
+    net_stack->icmp->echo_id = (getpid() + net_stack->queue) & 0xffff;
+    return 0;
+}
+
+/**
+ * @brief 回显请求超时
+ * 
+ * @param arg 等待的回显请求
+ */
+static void icmp_echo_expire(void *arg)
+{
+    icmp_echo_t *echo = arg;
+    icmp_echo_handler_t handler = echo->handler;
+    echo->handler = NULL;
+    handler(echo->ip, echo->seq, echo->len, -1);
+}
+
+/**
+ * @brief 发送一个回显请求(ping)
+ *        请求按序列号记录在等待表中，收到应答或超过ICMP_ECHO_TIMEOUT_MS后调用handler，
+ *        超时由时间轮在协议栈轮询中处理，不阻塞
+ * 
+ * @param ip 目的ip地址
+ * @param seq 序列号
+ * @param len 数据长度
+ * @param handler 结果回调
+ * @return int 成功为0，同一槽位的请求仍在等待或分配失败为-1
+ */
+int icmp_echo_request(uint8_t *ip, uint16_t seq, int len, icmp_echo_handler_t handler)
+{
+    icmp_layer_t *icmp = net_stack->icmp;
+    icmp_echo_t *echo = &icmp->echo[seq & (ICMP_ECHO_MAX - 1)];
+    icmp_hdr_t *icmp_hdr;
+    buf_t *txbuf;
+
+    if (echo->handler != NULL || (txbuf = buf_alloc(sizeof(icmp_hdr_t) + len)) == NULL)
+        return -1;
+    icmp_hdr = (icmp_hdr_t *)txbuf->data;
+    icmp_hdr->type = ICMP_TYPE_ECHO_REQUEST;
+    icmp_hdr->code = 0;
+    icmp_hdr->checksum = 0;
+    icmp_hdr->id = swap16(icmp->echo_id);
+    icmp_hdr->seq = swap16(seq);
+    for (int i = 0; i < len; i++)
+        txbuf->data[sizeof(icmp_hdr_t) + i] = i;
+    icmp_hdr->checksum = checksum_data(txbuf->data, txbuf->len);
+
+    echo->handler = handler;
+    echo->seq = seq;
+    echo->len = len;
+    memcpy(echo->ip, ip, NET_IP_LEN);
+    timer_add(&echo->timer, ICMP_ECHO_TIMEOUT_MS, icmp_echo_expire, echo);
+    echo->sent_ns = icmp_clock_ns();
+    ip_out(txbuf, ip, NET_PROTOCOL_ICMP);
+    buf_free(txbuf);
+    return 0;
+}
+
+/**
+ * @brief 处理回显应答，匹配等待表中的请求并回调
+ * 
+ * @param icmp_hdr 应答的icmp报头
+ * @param src_ip 应答的源地址
+ */
+static void icmp_echo_reply(icmp_hdr_t *icmp_hdr, uint8_t *src_ip)
+{
+    icmp_layer_t *icmp = net_stack->icmp;
+    uint16_t seq = swap16(icmp_hdr->seq);
+    icmp_echo_t *echo = &icmp->echo[seq & (ICMP_ECHO_MAX - 1)];
+    icmp_echo_handler_t handler = echo->handler;
+
+    if (swap16(icmp_hdr->id) != icmp->echo_id || handler == NULL ||
+        echo->seq != seq || memcmp(echo->ip, src_ip, NET_IP_LEN) != 0)
+        return;
+    timer_del(&echo->timer);
+    echo->handler = NULL;
+    handler(echo->ip, seq, echo->len, icmp_clock_ns() - echo->sent_ns);
+}
+
+/**
+ * @brief 处理"需要分片"差错报文，更新到原数据报目的地址的路径MTU
+ *        只接受对本机发出的数据报的差错；路由器未给出下一跳MTU时(RFC 1191之前的实现)，
+ *        按原数据报总长度取下一个更小的常见MTU
+ * 
+ * @param buf 差错报文，data指向icmp报头
+ */
+static void icmp_frag_needed(buf_t *buf)
+{
+    static const uint16_t plateaus[] = {32000, 17914, 8166, 4352, 2002, 1492, 1006, 508, 296, 68};
+    icmp_hdr_t *icmp_hdr = (icmp_hdr_t *)buf->data;
+    ip_hdr_t *orig = (ip_hdr_t *)(icmp_hdr + 1);
+    int mtu = swap16(icmp_hdr->seq);
+    size_t i;
+
+    // 差错报文携带原数据报的IP报头和至少8字节数据
+    if(buf->len < sizeof(icmp_hdr_t) + sizeof(ip_hdr_t) + 8 || memcmp(orig->src_ip, net_if_ip, NET_IP_LEN) != 0){
+        return;
+    }
+    if(mtu == 0){
+        for(i = 0; i < sizeof(plateaus) / sizeof(plateaus[0]) - 1 && plateaus[i] >= swap16(orig->total_len); i++)
+            ;
+        mtu = plateaus[i];
+    }
+    route_pmtu_update(orig->dest_ip, mtu);
+}
+
+/**
+ * @brief 获取当前协议栈的icmp计数
+ * 
+ * @return const icmp_stats_t* 计数
+ */
+const icmp_stats_t *icmp_get_stats()
+{
+    return &net_stack->icmp->stats;
+}
+/**
+ * @brief 处理一个收到的数据包
+ *        你首先要检查buf长度是否小于icmp头部长度
+ *        接着，查看该报文的ICMP类型是否为回显请求，
+ *        如果是，则回送一个回显应答（ping应答）；如果是回显应答，则交给等待表匹配本机发出的请求；
+ *        如果是"需要分片"差错，则更新路径MTU。
+ * 
+ *        应答包直接在收到的请求上原地改写：
+ *        类型改为回显应答，按RFC 1624增量更新校验和，不复制、不重新累加数据；
+ *        请求是直接收到的数据帧时，再交换IP地址、重置TTL并增量更新首部校验和，
+ *        交换mac地址后直接发送，不经过ip_out()和arp表；
+ *        重组出的数据报、带选项的请求或超过路径MTU的应答仍交给ip_out()封装发送。
+ * 
+ * @param buf 要处理的数据包
+ * @param src_ip 源ip地址
+ */
+void icmp_in(buf_t *buf, uint8_t *src_ip)
+{
+    icmp_hdr_t *icmp_hdr = (icmp_hdr_t *)buf->data;
+    ip_hdr_t *ip_hdr = (ip_hdr_t *)(buf->data - IP_HDR_LEN);
+    uint8_t dest_ip[NET_IP_LEN];
+    uint16_t old_word, new_word;
+    const route_t *route;
+    int len;
+    // 检查buf长度是否小于icmp头部长度
+    if(buf->len < sizeof(icmp_hdr_t)){
+        return;
+    }
+    // 回显应答交给等待表，"需要分片"更新路径MTU，其他类型不处理
+    if(icmp_hdr->type == ICMP_TYPE_ECHO_REPLY){
+        icmp_echo_reply(icmp_hdr, src_ip);
+        return;
+    }
+    if(icmp_hdr->type == ICMP_TYPE_UNREACH && icmp_hdr->code == ICMP_CODE_FRAG_NEEDED){
+        icmp_frag_needed(buf);
+        return;
+    }
+    // 查看该报文的ICMP类型是否为回显请求
+    if(icmp_hdr->type != ICMP_TYPE_ECHO_REQUEST){
+        return;
+    }
+    // 类型和代码在同一个16位字中，改写后增量更新校验和，标识、序列号和数据都不变
+    memcpy(&old_word, icmp_hdr, sizeof(old_word));
+    icmp_hdr->type = ICMP_TYPE_ECHO_REPLY;
+    icmp_hdr->code = 0;
+    memcpy(&new_word, icmp_hdr, sizeof(new_word));
+    icmp_hdr->checksum = checksum_update(icmp_hdr->checksum, old_word, new_word);
+
+    // src_ip指向收到的IP报头，据此确认请求紧跟在不带选项的IP报头之后；
+    // 到请求方的路径MTU比请求小时也交给ip_out()分片
+    if(!(buf->flags & BUF_FLAG_RX_FRAME) || src_ip != ip_hdr->src_ip || ip_hdr->hdr_len * IP_HDR_LEN_PER_BYTE != IP_HDR_LEN ||
+       (buf->len > PMTU_MIN - IP_HDR_LEN && ((route = route_lookup(src_ip)) == NULL || route_mtu(route, src_ip) < buf->len + IP_HDR_LEN))){
+        memcpy(dest_ip, src_ip, NET_IP_LEN); // ip_out()会覆盖原来的IP报头
+        ip_out(buf, dest_ip, NET_PROTOCOL_ICMP);
+        return;
+    }
+    // 交换源和目的IP地址，首部的16位反码和不变
+    memcpy(dest_ip, ip_hdr->src_ip, NET_IP_LEN);
+    memcpy(ip_hdr->src_ip, ip_hdr->dest_ip, NET_IP_LEN);
+    memcpy(ip_hdr->dest_ip, dest_ip, NET_IP_LEN);
+    // TTL与协议在同一个16位字中
+    memcpy(&old_word, &ip_hdr->ttl, sizeof(old_word));
+    ip_hdr->ttl = IP_DEFALUT_TTL;
+    memcpy(&new_word, &ip_hdr->ttl, sizeof(new_word));
+    ip_hdr->hdr_checksum = checksum_update(ip_hdr->hdr_checksum, old_word, new_word);
+    // 去掉以太网最小帧长的填充
+    if((len = swap16(ip_hdr->total_len) - IP_HDR_LEN) < buf->len){
+        buf->len = len;
+    }
+    buf_add_header(buf, IP_HDR_LEN);
+    ethernet_reply(buf);
+}
+
+/**
+ * @brief 发送icmp不可达
+ *        经过全局和按源地址的令牌桶限速，超出速率时丢弃并计数，不再分配和封装报文
+ * 
+ *        你需要首先调用buf_alloc分配buf，长度为ICMP头部 + IP头部 + 原始IP数据报中的前8字节 
+ *        填写ICMP报头首部，类型值为目的不可达
+ *        填写校验和
+ *        将封装好的ICMP数据报发送到IP层。
+ * 
+ * @param recv_buf 收到的ip数据包
+ * @param src_ip 源ip地址
+ * @param code icmp code，协议不可达或端口不可达
+ */
+void icmp_unreachable(buf_t *recv_buf, uint8_t *src_ip, icmp_code_t code)
+{
+    // TODO
+    // 调用 buf_alloc 来分配 txbuf
+    icmp_hdr_t icmp_hdr;
+    buf_t *txbuf;
+    if(!icmp_err_allow(src_ip)){
+        return;
+    }
+    txbuf = buf_alloc(ICMP_WRONG_LEN);
+    if(txbuf == NULL){
+        return;
+    }
+    icmp_hdr.type = ICMP_TYPE_UNREACH; // 类型为目的不可达
+    icmp_hdr.code = code;
+    icmp_hdr.id = 0;
+    icmp_hdr.seq = 0; // 标识符和序列号未用，都为0
+    icmp_hdr.checksum = 0; // 校验和初始化为0
+    memcpy(txbuf->data, &icmp_hdr, sizeof(icmp_hdr_t));
+    // 复制IP数据报头部
+    memcpy(txbuf->data+sizeof(icmp_hdr_t), recv_buf->data, IP_HDR_LEN);
+    // 复制原始IP数据报中的前8字节
+    memcpy(txbuf->data+sizeof(icmp_hdr_t)+IP_HDR_LEN, recv_buf->data+IP_HDR_LEN, 8);
+    // 计算校验和
+    icmp_hdr.checksum = checksum_data(txbuf->data, txbuf->len);
+    // 更新后再次赋值
+    memcpy(txbuf->data, &icmp_hdr, sizeof(icmp_hdr_t));
+    ip_out(txbuf, src_ip, NET_PROTOCOL_ICMP);
+    buf_free(txbuf);
 }
\ No newline at end of file
@@ -1,175 +1,625 @@
-#include "ip.h"
-#include "arp.h"
-#include "icmp.h"
-#include "udp.h"
-#include <string.h>
-#include <stdio.h>
-int ip_id=-1;
-uint16_t total_len;
-
-/**
- * @brief 处理一个收到的数据包
- *        你首先需要做报头检查，检查项包括：版本号、总长度、首部长度等。
- * 
- *        接着，计算头部校验和，注意：需要先把头部校验和字段缓存起来，再将校验和字段清零，
- *        调用checksum16()函数计算头部检验和，比较计算的结果与之前缓存的校验和是否一致，
- *        如果不一致，则不处理该数据报。
- * 
- *        检查收到的数据包的目的IP地址是否为本机的IP地址，只处理目的IP为本机的数据报。
- * 
- *        检查IP报头的协议字段：
- *        如果是ICMP协议，则去掉IP头部，发送给ICMP协议层处理
- *        如果是UDP协议，则去掉IP头部，发送给UDP协议层处理
- *        如果是本实验中不支持的其他协议，则需要调用icmp_unreachable()函数回送一个ICMP协议不可达的报文。
- *          
- * @param buf 要处理的包
- */
-void ip_in(buf_t *buf)
-{
-    // TODO 
-    ip_hdr_t *ip_hdr = (ip_hdr_t*)buf->data;
-    uint16_t temp,checksum; // 缓存头部校验和字段
-    uint16_t buf16[CHECK_LEN];
-    uint16_t temp2;
-    // 报头检查
-    if(ip_hdr->version != IP_VERSION_4
-        || ip_hdr->total_len > UINT16_MAX
-        || ip_hdr->hdr_len > 15
-    ){
-        return;
-    }
-    temp = ip_hdr->hdr_checksum;
-    ip_hdr->hdr_checksum = 0;
-    // 手动将uint8数组转换为uint16型
-    for(int i = 0; i < CHECK_LEN; i++){
-        temp2 = (buf->data[2*i] << 8)&0xff00;
-        buf16[i] = temp2 + buf->data[2*i+1];
-        buf16[i] = swap16(buf16[i]);
-    }
-    checksum = checksum16(buf16, ip_hdr->hdr_len*IP_HDR_LEN_PER_BYTE/2);
-    if(temp != checksum){ // 如果不一致，则不处理该数据报
-        return;
-    }
-    ip_hdr->hdr_checksum = temp;
-    // 检查收到的数据包的目的IP地址是否为本机的IP地址，只处理目的IP为本机的数据报
-    if(memcmp(ip_hdr->dest_ip, net_if_ip, NET_IP_LEN) != 0){
-        return;
-    }
-    
-    // 检查IP报头的协议字段
-    if(ip_hdr->protocol == NET_PROTOCOL_ICMP){
-        // 调用 buf_remove_header 去掉 IP 报头
-        buf_remove_header(buf, ip_hdr->hdr_len*IP_HDR_LEN_PER_BYTE);
-        icmp_in(buf, ip_hdr->src_ip);
-    }else if (ip_hdr->protocol == NET_PROTOCOL_UDP)
-    {
-        // 调用 buf_remove_header 去掉 IP 报头
-        buf_remove_header(buf, ip_hdr->hdr_len*IP_HDR_LEN_PER_BYTE);
-        udp_in(buf, ip_hdr->src_ip);
-    }else{
-        icmp_unreachable(buf, ip_hdr->src_ip, ICMP_CODE_PROTOCOL_UNREACH);// 协议不可达
-    }
-    
-}
-
-/**
- * @brief 处理一个要发送的分片
- *        你需要调用buf_add_header增加IP数据报头部缓存空间。
- *        填写IP数据报头部字段。
- *        将checksum字段填0，再调用checksum16()函数计算校验和，并将计算后的结果填写到checksum字段中。
- *        将封装后的IP数据报发送到arp层。
- * 
- * @param buf 要发送的分片
- * @param ip 目标ip地址
- * @param protocol 上层协议
- * @param id 数据包id
- * @param offset 分片offset，必须被8整除
- * @param mf 分片mf标志，是否有下一个分片
- */
-void ip_fragment_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol, int id, uint16_t offset, int mf)
-{
-    // TODO
-    ip_hdr_t *ip_hdr;
-    // 调用 buf_add_header 增加 IP 数据报头部缓存空间
-    buf_add_header(buf, sizeof(ip_hdr_t));
-    uint16_t temp,checksum,temp2;
-    uint16_t buf16[CHECK_LEN];
-    //  填写 IP 数据报头部字段
-    ip_hdr = (ip_hdr_t*) buf->data;
-    memcpy(ip_hdr->dest_ip, ip, NET_IP_LEN);
-    ip_hdr->version = IP_VERSION_4;
-    ip_hdr->hdr_len = 5;
-    ip_hdr->tos = 0;
-    ip_hdr->total_len = swap16(buf->len);
-    ip_hdr->protocol = protocol;
-    ip_hdr->id = swap16(id);
-    ip_hdr->ttl = 64;
-    ip_hdr->flags_fragment = offset/IP_HDR_OFFSET_PER_BYTE&0x1fff;
-    if(mf == 1){
-        temp = ip_hdr->flags_fragment >> 8;
-        temp = temp | IP_MORE_FRAGMENT;
-        temp = temp << 8;
-        ip_hdr->flags_fragment |= temp; 
-    }
-    ip_hdr->flags_fragment = swap16(ip_hdr->flags_fragment);
-    memcpy(ip_hdr->dest_ip, ip, NET_IP_LEN);
-    memcpy(ip_hdr->src_ip, net_if_ip, NET_IP_LEN);
-    ip_hdr->hdr_checksum = 0;
-    // 手动将uint8数组转换为uint16型
-    for(int i = 0; i < CHECK_LEN; i++){
-        temp2 = (buf->data[2*i] << 8)&0xff00;
-        buf16[i] = temp2 + buf->data[2*i+1];
-        buf16[i] = swap16(buf16[i]);
-    }
-    checksum = checksum16(buf16, ip_hdr->hdr_len*IP_HDR_LEN_PER_BYTE/2);
-    ip_hdr->hdr_checksum = checksum;
-    arp_out(buf, ip, NET_PROTOCOL_IP);
-}
-
-/**
- * @brief 处理一个要发送的数据包
- *        你首先需要检查需要发送的IP数据报是否大于以太网帧的最大包长（1500字节 - ip包头长度）。
- *        
- *        如果超过，则需要分片发送。 
- *        分片步骤：
- *        （1）调用buf_init()函数初始化buf，长度为以太网帧的最大包长（1500字节 - ip包头头长度）
- *        （2）将数据报截断，每个截断后的包长度 = 以太网帧的最大包长，调用ip_fragment_out()函数发送出去
- *        （3）如果截断后最后的一个分片小于或等于以太网帧的最大包长，
- *             调用buf_init()函数初始化buf，长度为该分片大小，再调用ip_fragment_out()函数发送出去
- *             注意：最后一个分片的MF = 0
- *    
- *        如果没有超过以太网帧的最大包长，则直接调用调用ip_fragment_out()函数发送出去。
- * 
- * @param buf 要处理的包
- * @param ip 目标ip地址
- * @param protocol 上层协议
- */
-void ip_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol)
-{
-    // TODO 
-    buf_t ip_buf;
-    uint16_t offset=0;
-    uint16_t Ethernet_max_len = ETHERNET_MTU-sizeof(ip_hdr_t); // 以太网帧最大包长
-    ip_id++;
-    //  检查从上层传递下来的数据报包长是否大于以太网帧的最大包长
-    if (buf->len > Ethernet_max_len)// 超过以太网帧的最大包长，则需要分片发送
-    {
-        while(offset+Ethernet_max_len < buf->len){
-            
-            buf_init(&ip_buf, Ethernet_max_len);
-            memcpy(ip_buf.data, buf->data+offset, Ethernet_max_len);
-            total_len = Ethernet_max_len;
-            ip_fragment_out(&ip_buf, ip, protocol, ip_id, offset, 1);
-            offset += Ethernet_max_len;
-        }
-        total_len = buf->len - offset;
-        buf_init(&ip_buf, total_len);
-        memcpy(ip_buf.data, buf->data+offset, total_len);
-        ip_fragment_out(&ip_buf, ip, protocol, ip_id, offset, 0);
-    }
-    else
-    {
-        total_len = buf->len;
-        ip_fragment_out(buf, ip, protocol, ip_id, 0, 0);
-    }
-}
+#include "ip.h"
+#include "arp.h"
+#include "icmp.h"
+#include "udp.h"
+#include "timer.h"
+#include "route.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define IP_FRAG_BLOCKS ((UINT16_MAX + 1) / IP_HDR_OFFSET_PER_BYTE) // 一个数据报最多的8字节块数
+
+/**
+ * @brief 正在重组的数据报
+ *        用位图记录已收到的8字节块，分片乱序、重叠或大小不一时都只需置位，
+ *        收到的分片按原样保留引用，全部到齐后一次拷贝成完整的数据报
+ * 
+ */
+typedef struct ip_frag
+{
+    uint8_t src_ip[NET_IP_LEN];  // 源IP
+    uint8_t dest_ip[NET_IP_LEN]; // 目标IP
+    uint16_t id;                 // 标识符，网络字节序
+    uint8_t protocol;            // 上层协议
+    int total;                   // 数据报总长度(不含首部)，收到最后一个分片前为0
+    int end;                     // 已收到的分片中最大的结束位置
+    int blocks;                  // 已收到的块数
+    int mem;                     // 占用的内存
+    timer_entry_t timer;         // 超时定时器，从收到第一个分片开始计时
+    buf_t *frags;                // 收到的分片，包含ip首部，通过buf->next链接，持有引用
+    struct ip_frag *hash_next;   // 哈希桶链表
+    struct ip_frag *prev, *next; // 按创建时间排列的链表，表头最早
+    uint64_t bitmap[IP_FRAG_BLOCKS / 64]; // 已收到的块
+} ip_frag_t;
+
+/**
+ * @brief ip层状态，每个协议栈实例一份
+ * 
+ */
+typedef struct ip_layer
+{
+    uint16_t id;                                 // 下一个发出的数据报的标识符
+    ip_frag_t *frag_table[IP_FRAG_HASH_SIZE];    // 以(src, dst, id, protocol)为键的哈希表
+    ip_frag_t *frag_oldest, *frag_newest;
+    int frag_mem;                                // 所有正在重组的数据报占用的内存
+    buf_t *lo_queue[IP_LOOPBACK_QUEUE];          // 环回队列，持有数据报的引用
+    int lo_head, lo_count;
+} ip_layer_t;
+
+/**
+ * @brief 计算数据报在重组哈希表中的桶号
+ * 
+ * @param src_ip 源IP
+ * @param dest_ip 目标IP
+ * @param id 标识符
+ * @param protocol 上层协议
+ * @return uint32_t 桶号
+ */
+static uint32_t ip_frag_hash(const uint8_t *src_ip, const uint8_t *dest_ip, uint16_t id, uint8_t protocol)
+{
+    uint32_t src, dst;
+    memcpy(&src, src_ip, NET_IP_LEN);
+    memcpy(&dst, dest_ip, NET_IP_LEN);
+    return ((src ^ dst * 31 ^ ((uint32_t)id << 8 | protocol)) * 0x9E3779B1u) >> 16 & (IP_FRAG_HASH_SIZE - 1);
+}
+
+/**
+ * @brief 删除一个正在重组的数据报，释放已收到的分片
+ * 
+ * @param frag 要删除的数据报
+ */
+static void ip_frag_free(ip_frag_t *frag)
+{
+    net_stack_t *s = net_stack;
+    buf_t *pkt, *next;
+    ip_frag_t **pp = &s->ip->frag_table[ip_frag_hash(frag->src_ip, frag->dest_ip, frag->id, frag->protocol)];
+    while (*pp != frag)
+        pp = &(*pp)->hash_next;
+    *pp = frag->hash_next;
+    if (frag->prev)
+        frag->prev->next = frag->next;
+    else
+        s->ip->frag_oldest = frag->next;
+    if (frag->next)
+        frag->next->prev = frag->prev;
+    else
+        s->ip->frag_newest = frag->prev;
+    for (pkt = frag->frags; pkt != NULL; pkt = next)
+    {
+        next = pkt->next;
+        pkt->next = NULL;
+        buf_free(pkt);
+    }
+    s->ip->frag_mem -= frag->mem;
+    timer_del(&frag->timer);
+    free(frag);
+}
+
+/**
+ * @brief 数据报超过IP_FRAG_TIMEOUT_SEC仍未到齐，删除
+ * 
+ * @param arg 数据报
+ */
+static void ip_frag_expire(void *arg)
+{
+    ip_frag_free(arg);
+}
+
+/**
+ * @brief 在位图中标记[first, last)的块为已收到
+ * 
+ * @param frag 数据报
+ * @param first 起始块
+ * @param last 结束块
+ * @return int 新标记的块数
+ */
+static int ip_frag_mark(ip_frag_t *frag, int first, int last)
+{
+    int added = 0;
+    while (first < last)
+    {
+        int bits = 64 - first % 64 < last - first ? 64 - first % 64 : last - first;
+        uint64_t mask = (bits == 64 ? ~0ull : (1ull << bits) - 1) << first % 64;
+        added += __builtin_popcountll(mask & ~frag->bitmap[first / 64]);
+        frag->bitmap[first / 64] |= mask;
+        first += bits;
+    }
+    return added;
+}
+
+/**
+ * @brief 把到齐的分片拷贝成一个完整的数据报
+ *        分片有重叠时以先收到的为准
+ * 
+ * @param frag 数据报
+ * @return buf_t* 重组后的数据报，包含第一个分片的ip首部，失败为NULL
+ */
+static buf_t *ip_frag_assemble(ip_frag_t *frag)
+{
+    buf_t *buf, *pkt;
+    ip_hdr_t *ip_hdr;
+    int hdr_len = 0;
+    for (pkt = frag->frags; pkt != NULL; pkt = pkt->next)
+    {
+        ip_hdr = (ip_hdr_t *)pkt->data;
+        if ((swap16(ip_hdr->flags_fragment) & 0x1fff) == 0)
+            hdr_len = ip_hdr->hdr_len * IP_HDR_LEN_PER_BYTE;
+    }
+    if ((buf = buf_alloc(hdr_len + frag->total)) == NULL)
+        return NULL;
+    for (pkt = frag->frags; pkt != NULL; pkt = pkt->next) // 链表头是最后收到的分片，先收到的最后拷贝
+    {
+        ip_hdr = (ip_hdr_t *)pkt->data;
+        int pkt_hdr_len = ip_hdr->hdr_len * IP_HDR_LEN_PER_BYTE;
+        int offset = (swap16(ip_hdr->flags_fragment) & 0x1fff) * IP_HDR_OFFSET_PER_BYTE;
+        if (offset == 0)
+            memcpy(buf->data, pkt->data, hdr_len);
+        memcpy(buf->data + hdr_len + offset, pkt->data + pkt_hdr_len, swap16(ip_hdr->total_len) - pkt_hdr_len);
+    }
+    ip_hdr = (ip_hdr_t *)buf->data;
+    ip_hdr->total_len = swap16(buf->len);
+    ip_hdr->flags_fragment = 0;
+    ip_hdr->hdr_checksum = 0;
+    ip_hdr->hdr_checksum = checksum_data(buf->data, hdr_len);
+    return buf;
+}
+
+/**
+ * @brief 处理一个收到的分片
+ *        按(src, dst, id, protocol)找到所属的数据报，没有则新建，在位图中标记分片覆盖的块，
+ *        不带来新数据的重复分片直接丢弃。占用内存超过IP_FRAG_MEM_MAX时先淘汰最早的数据报
+ * 
+ * @param buf 收到的分片，包含ip首部
+ * @return buf_t* 分片全部到齐时为重组后的数据报，之后需要buf_free，否则为NULL
+ */
+static buf_t *ip_reass(buf_t *buf)
+{
+    net_stack_t *s = net_stack;
+    ip_hdr_t *ip_hdr = (ip_hdr_t *)buf->data;
+    int hdr_len = ip_hdr->hdr_len * IP_HDR_LEN_PER_BYTE;
+    int offset = (swap16(ip_hdr->flags_fragment) & 0x1fff) * IP_HDR_OFFSET_PER_BYTE;
+    int len = swap16(ip_hdr->total_len) - hdr_len;
+    int mf = swap16(ip_hdr->flags_fragment) >> 8 & IP_MORE_FRAGMENT;
+    uint32_t hash = ip_frag_hash(ip_hdr->src_ip, ip_hdr->dest_ip, ip_hdr->id, ip_hdr->protocol);
+    ip_frag_t *frag;
+    buf_t *pkt, *dgram;
+    int added;
+
+    // 除最后一个分片外长度必须是8的倍数，重组后的数据报不能超过最大长度
+    if (len <= 0 || hdr_len + len > buf->len || hdr_len + offset + len > UINT16_MAX || (mf && len % IP_HDR_OFFSET_PER_BYTE))
+        return NULL;
+    for (frag = s->ip->frag_table[hash]; frag != NULL; frag = frag->hash_next)
+        if (frag->id == ip_hdr->id && frag->protocol == ip_hdr->protocol &&
+            memcmp(frag->src_ip, ip_hdr->src_ip, NET_IP_LEN) == 0 && memcmp(frag->dest_ip, ip_hdr->dest_ip, NET_IP_LEN) == 0)
+            break;
+    if (frag != NULL)
+    {
+        // 与已知的数据报末尾矛盾的分片丢弃
+        if ((frag->total && offset + len > frag->total) || (!mf && (frag->total ? frag->total : frag->end) > offset + len))
+            return NULL;
+    }
+    else
+    {
+        if ((frag = calloc(1, sizeof(ip_frag_t))) == NULL)
+            return NULL;
+        memcpy(frag->src_ip, ip_hdr->src_ip, NET_IP_LEN);
+        memcpy(frag->dest_ip, ip_hdr->dest_ip, NET_IP_LEN);
+        frag->id = ip_hdr->id;
+        frag->protocol = ip_hdr->protocol;
+        frag->mem = sizeof(ip_frag_t);
+        timer_add(&frag->timer, IP_FRAG_TIMEOUT_SEC * 1000, ip_frag_expire, frag);
+        frag->hash_next = s->ip->frag_table[hash];
+        s->ip->frag_table[hash] = frag;
+        frag->prev = s->ip->frag_newest;
+        if (s->ip->frag_newest)
+            s->ip->frag_newest->next = frag;
+        else
+            s->ip->frag_oldest = frag;
+        s->ip->frag_newest = frag;
+        s->ip->frag_mem += frag->mem;
+    }
+
+    // 保留分片的引用，不必拷贝
+    if ((pkt = buf_ref(buf)) == NULL)
+    {
+        if (frag->frags == NULL)
+            ip_frag_free(frag);
+        return NULL;
+    }
+    added = ip_frag_mark(frag, offset / IP_HDR_OFFSET_PER_BYTE, (offset + len + IP_HDR_OFFSET_PER_BYTE - 1) / IP_HDR_OFFSET_PER_BYTE);
+    if (added == 0) // 重复的分片
+    {
+        buf_free(pkt);
+        return NULL;
+    }
+    pkt->next = frag->frags;
+    frag->frags = pkt;
+    frag->blocks += added;
+    frag->mem += pkt->size;
+    s->ip->frag_mem += pkt->size;
+    if (offset + len > frag->end)
+        frag->end = offset + len;
+    if (!mf)
+        frag->total = offset + len;
+
+    if (frag->total && frag->blocks == (frag->total + IP_HDR_OFFSET_PER_BYTE - 1) / IP_HDR_OFFSET_PER_BYTE)
+    {
+        dgram = ip_frag_assemble(frag);
+        ip_frag_free(frag);
+        return dgram;
+    }
+    while (s->ip->frag_mem > IP_FRAG_MEM_MAX && s->ip->frag_oldest != NULL)
+        ip_frag_free(s->ip->frag_oldest);
+    return NULL;
+}
+
+/**
+ * @brief 初始化ip协议
+ *        分配当前协议栈的ip层状态
+ * 
+ * @return int 成功为0，失败为-1
+ */
+int ip_init()
+{
+    if (net_stack->ip == NULL && (net_stack->ip = calloc(1, sizeof(ip_layer_t))) == NULL)
+    {
+        fprintf(stderr, "Error in ip_init: out of memory\n");
+        return -1;
+    }
+    if (route_init() != 0)
+        return -1;
+    return timer_init();
+}
+
+/**
+ * @brief 分配一个发出的数据报的标识符
+ * 
+ * @return uint16_t 标识符
+ */
+uint16_t ip_next_id()
+{
+    return net_stack->ip->id++;
+}
+
+/**
+ * @brief 判断目的地址是否走环回路径
+ * 
+ * @param ip 目的ip地址
+ * @return int 是本机地址且启用了环回为1，否则为0
+ */
+int ip_is_local(const uint8_t *ip)
+{
+    return IP_LOOPBACK && memcmp(ip, net_if_ip, NET_IP_LEN) == 0;
+}
+
+/**
+ * @brief 把发给本机的数据报放入环回队列
+ *        不分片、不填首部校验和，接收时也不验证；由下一次协议栈轮询交给ip_in()，
+ *        不在发送路径中直接处理，上层在接收回调中再发送也不会递归
+ * 
+ * @param buf 要发送的数据报
+ * @param protocol 上层协议
+ * @param id 数据包id
+ */
+static void ip_loopback_out(buf_t *buf, net_protocol_t protocol, int id)
+{
+    ip_layer_t *ip = net_stack->ip;
+    ip_hdr_t *ip_hdr;
+    buf_t *lo;
+
+    if (ip->lo_count == IP_LOOPBACK_QUEUE || (lo = buf_ref(buf)) == NULL)
+        return;
+    buf_add_header(lo, sizeof(ip_hdr_t));
+    ip_hdr = (ip_hdr_t *)lo->data;
+    ip_hdr->version = IP_VERSION_4;
+    ip_hdr->hdr_len = sizeof(ip_hdr_t) / IP_HDR_LEN_PER_BYTE;
+    ip_hdr->tos = 0;
+    ip_hdr->total_len = swap16(buf_total_len(lo));
+    ip_hdr->id = swap16(id);
+    ip_hdr->flags_fragment = 0;
+    ip_hdr->ttl = IP_DEFALUT_TTL;
+    ip_hdr->protocol = protocol;
+    ip_hdr->hdr_checksum = 0;
+    memcpy(ip_hdr->src_ip, net_if_ip, NET_IP_LEN);
+    memcpy(ip_hdr->dest_ip, net_if_ip, NET_IP_LEN);
+    lo->flags = (lo->flags & ~(BUF_FLAG_CSUM_PARTIAL | BUF_FLAG_RX_FRAME)) | BUF_FLAG_LOOPBACK;
+    ip->lo_queue[(ip->lo_head + ip->lo_count++) % IP_LOOPBACK_QUEUE] = lo;
+}
+
+/**
+ * @brief 把环回队列中的数据报交给接收方，在协议栈轮询中调用
+ * 
+ * @param budget 最多处理的数据报数
+ * @return int 处理的数据报数
+ */
+int ip_loopback_poll(int budget)
+{
+    ip_layer_t *ip = net_stack->ip;
+    buf_t *bufs[NET_BURST_MAX];
+    int n, total = 0;
+    // 接收方处理时放入的数据报留在队尾，同样受budget限制
+    while (total < budget && ip->lo_count > 0)
+    {
+        for (n = 0; n < NET_BURST_MAX && total + n < budget && ip->lo_count > 0; n++)
+        {
+            bufs[n] = ip->lo_queue[ip->lo_head];
+            ip->lo_head = (ip->lo_head + 1) % IP_LOOPBACK_QUEUE;
+            ip->lo_count--;
+        }
+        ip_in_burst(bufs, n);
+        for (int i = 0; i < n; i++)
+            buf_free(bufs[i]);
+        total += n;
+    }
+    return total;
+}
+
+/**
+ * @brief 检查并处理一个收到的数据包，udp数据报留给调用者成批交给udp层
+ *        你首先需要做报头检查，检查项包括：版本号、总长度、首部长度等，并去掉总长度之后的填充。
+ * 
+ *        接着，计算头部校验和，注意：需要先把头部校验和字段缓存起来，再将校验和字段清零，
+ *        调用checksum_data()函数计算头部检验和，比较计算的结果与之前缓存的校验和是否一致，
+ *        如果不一致，则不处理该数据报。驱动已验证或经环回队列收到的数据报不必计算。
+ * 
+ *        检查收到的数据包的目的IP地址是否为本机的IP地址，只处理目的IP为本机的数据报。
+ *        如果是分片，交给ip_reass()重组，分片到齐后继续处理重组出的完整数据报。
+ * 
+ *        检查IP报头的协议字段：
+ *        如果是ICMP协议，则去掉IP头部，发送给ICMP协议层处理
+ *        如果是UDP协议，则去掉IP头部，返回给调用者
+ *        如果是本实验中不支持的其他协议，则需要调用icmp_unreachable()函数回送一个ICMP协议不可达的报文。
+ *          
+ * @param buf 要处理的包
+ * @param src_ip 输出udp数据报的源ip地址
+ * @param dgram 输出重组出的数据报，udp层处理完后需要释放，没有重组时为NULL
+ * @return buf_t* 去掉ip报头的udp数据报，其他情况为NULL
+ */
+static buf_t *ip_in_classify(buf_t *buf, uint8_t **src_ip, buf_t **dgram)
+{
+    // TODO 
+    ip_hdr_t *ip_hdr = (ip_hdr_t*)buf->data;
+    uint16_t temp,checksum; // 缓存头部校验和字段
+    int total_len;
+    *dgram = NULL; // 重组后的数据报
+    // 报头检查：首部长度至少20字节，且首部长度 <= 总长度 <= 收到的长度
+    if(buf->len < sizeof(ip_hdr_t)){
+        return NULL;
+    }
+    total_len = swap16(ip_hdr->total_len);
+    if(ip_hdr->version != IP_VERSION_4
+        || ip_hdr->hdr_len < sizeof(ip_hdr_t) / IP_HDR_LEN_PER_BYTE
+        || ip_hdr->hdr_len * IP_HDR_LEN_PER_BYTE > total_len
+        || total_len > buf->len
+    ){
+        return NULL;
+    }
+    buf->len = total_len; // 去掉以太网最小帧长的填充，与早期分流的处理一致
+    if(!(buf->flags & BUF_FLAG_LOOPBACK)){ // 驱动只验证传输层校验和，首部校验和总要检查，环回的包不必再算
+        temp = ip_hdr->hdr_checksum;
+        ip_hdr->hdr_checksum = 0;
+        checksum = checksum_data(buf->data, ip_hdr->hdr_len*IP_HDR_LEN_PER_BYTE);
+        if(temp != checksum){ // 如果不一致，则不处理该数据报
+            return NULL;
+        }
+        ip_hdr->hdr_checksum = temp;
+    }
+    // 检查收到的数据包的目的IP地址是否为本机的IP地址，只处理目的IP为本机的数据报
+    if(memcmp(ip_hdr->dest_ip, net_if_ip, NET_IP_LEN) != 0){
+        return NULL;
+    }
+    // 分片先交给重组，到齐后处理重组出的完整数据报
+    if(swap16(ip_hdr->flags_fragment) & (IP_MORE_FRAGMENT << 8 | 0x1fff)){
+        if((*dgram = ip_reass(buf)) == NULL){
+            return NULL;
+        }
+        buf = *dgram;
+        ip_hdr = (ip_hdr_t*)buf->data;
+    }
+    
+    // 检查IP报头的协议字段
+    if(ip_hdr->protocol == NET_PROTOCOL_UDP){
+        // 调用 buf_remove_header 去掉 IP 报头
+        buf_remove_header(buf, ip_hdr->hdr_len*IP_HDR_LEN_PER_BYTE);
+        *src_ip = ip_hdr->src_ip;
+        return buf;
+    }
+    if(ip_hdr->protocol == NET_PROTOCOL_ICMP){
+        // 调用 buf_remove_header 去掉 IP 报头
+        buf_remove_header(buf, ip_hdr->hdr_len*IP_HDR_LEN_PER_BYTE);
+        icmp_in(buf, ip_hdr->src_ip);
+    }else{
+        icmp_unreachable(buf, ip_hdr->src_ip, ICMP_CODE_PROTOCOL_UNREACH);// 协议不可达
+    }
+    buf_free(*dgram);
+    *dgram = NULL;
+    return NULL;
+}
+
+/**
+ * @brief 成批处理收到的数据包
+ *        命中流缓存的udp数据报由udp_early_demux()跳过逐项检查，其余的逐个检查，icmp等就地处理；
+ *        两条路径得到的udp数据报按到达顺序组成一批交给udp_in_burst()，同一个流中的数据报不会颠倒。
+ *        处理当前包时预取下一个包的报头
+ * 
+ * @param bufs 要处理的包
+ * @param n 包数
+ */
+void ip_in_burst(buf_t **bufs, int n)
+{
+    buf_t *udp_bufs[NET_BURST_MAX], *dgrams[NET_BURST_MAX], *buf, *dgram;
+    uint8_t *src_ips[NET_BURST_MAX];
+    int nudp = 0, ndgram = 0;
+
+    for (; n > NET_BURST_MAX; bufs += NET_BURST_MAX, n -= NET_BURST_MAX)
+        ip_in_burst(bufs, NET_BURST_MAX);
+    for (int i = 0; i < n; i++)
+    {
+        if (i + 1 < n)
+            __builtin_prefetch(bufs[i + 1]->data);
+        // 已建立的udp流由早期分流跳过逐项检查，与其他udp数据报按到达顺序排在一起
+        if (udp_early_demux(bufs[i], &src_ips[nudp]))
+        {
+            udp_bufs[nudp++] = bufs[i];
+            continue;
+        }
+        if ((buf = ip_in_classify(bufs[i], &src_ips[nudp], &dgram)) != NULL)
+            udp_bufs[nudp++] = buf;
+        if (dgram != NULL)
+            dgrams[ndgram++] = dgram;
+    }
+    if (nudp > 0)
+        udp_in_burst(udp_bufs, src_ips, nudp);
+    for (int i = 0; i < ndgram; i++)
+        buf_free(dgrams[i]);
+}
+
+/**
+ * @brief 处理一个收到的数据包
+ * 
+ * @param buf 要处理的包
+ */
+void ip_in(buf_t *buf)
+{
+    ip_in_burst(&buf, 1);
+}
+
+/**
+ * @brief 处理一个要发送的分片
+ *        你需要调用buf_add_header增加IP数据报头部缓存空间。
+ *        填写IP数据报头部字段。
+ *        将checksum字段填0，再调用checksum_data()函数计算校验和，并将计算后的结果填写到checksum字段中。
+ *        将封装后的IP数据报发送到arp层，由arp解析下一跳的mac地址。
+ * 
+ * @param buf 要发送的分片
+ * @param ip 目标ip地址
+ * @param next_hop 下一跳ip地址
+ * @param protocol 上层协议
+ * @param id 数据包id
+ * @param offset 分片offset，必须被8整除
+ * @param mf 分片mf标志，是否有下一个分片
+ */
+void ip_fragment_out(buf_t *buf, uint8_t *ip, const uint8_t *next_hop, net_protocol_t protocol, int id, uint16_t offset, int mf)
+{
+    // TODO
+    ip_hdr_t *ip_hdr;
+    // 调用 buf_add_header 增加 IP 数据报头部缓存空间
+    buf_add_header(buf, sizeof(ip_hdr_t));
+    uint16_t temp;
+    //  填写 IP 数据报头部字段
+    ip_hdr = (ip_hdr_t*) buf->data;
+    memcpy(ip_hdr->dest_ip, ip, NET_IP_LEN);
+    ip_hdr->version = IP_VERSION_4;
+    ip_hdr->hdr_len = 5;
+    ip_hdr->tos = 0;
+    ip_hdr->total_len = swap16(buf_total_len(buf));
+    ip_hdr->protocol = protocol;
+    ip_hdr->id = swap16(id);
+    ip_hdr->ttl = 64;
+    ip_hdr->flags_fragment = offset/IP_HDR_OFFSET_PER_BYTE&0x1fff;
+    if(mf == 1){
+        temp = ip_hdr->flags_fragment >> 8;
+        temp = temp | IP_MORE_FRAGMENT;
+        temp = temp << 8;
+        ip_hdr->flags_fragment |= temp; 
+    }
+#if IP_PMTU_DISC
+    // 不分片、也不会由驱动分片的数据报设置DF位，路径上装不下时由路由器回送"需要分片"
+    if(offset == 0 && !mf && buf_total_len(buf) <= net_stack->if_mtu){
+        ip_hdr->flags_fragment |= (IP_DONT_FRAGMENT) << 8;
+    }
+#endif
+    ip_hdr->flags_fragment = swap16(ip_hdr->flags_fragment);
+    memcpy(ip_hdr->dest_ip, ip, NET_IP_LEN);
+    memcpy(ip_hdr->src_ip, net_if_ip, NET_IP_LEN);
+    ip_hdr->hdr_checksum = 0;
+    ip_hdr->hdr_checksum = checksum_data(buf->data, ip_hdr->hdr_len*IP_HDR_LEN_PER_BYTE);
+    arp_out(buf, (uint8_t *)next_hop, NET_PROTOCOL_IP);
+}
+
+/**
+ * @brief 在软件中补全只填了伪头部校验和的UDP校验和
+ *        校验和字段中已是伪头部的累加结果，接着累加整个UDP报文即可
+ * 
+ * @param buf 要发送的UDP报文
+ */
+static void ip_csum_complete(buf_t *buf)
+{
+    uint16_t *checksum = (uint16_t *)(buf->data + 6);
+    *checksum = checksum_fold(checksum_add(buf->data, buf->len, 0));
+    if (*checksum == 0) // UDP校验和为0表示不校验，按RFC 768发送全1
+        *checksum = 0xffff;
+    buf->flags &= ~BUF_FLAG_CSUM_PARTIAL;
+}
+
+/**
+ * @brief 处理一个要发送的数据包
+ *        发给本机的数据报放入环回队列，不经过路由、arp和驱动。
+ *        其他数据报先按目标地址查找路由，得到下一跳地址和可用的MTU(网卡、路由和路径MTU中最小的)，
+ *        各分片都发给下一跳；没有路由时丢弃。
+ *        你首先需要检查需要发送的IP数据报是否大于以太网帧的最大包长（MTU - ip包头长度）。
+ *        
+ *        如果超过，则需要分片发送。 
+ *        分片步骤：
+ *        （1）调用buf_alloc()函数分配只装协议头的空buf
+ *        （2）将数据报截断，每个截断后的包长度 = 以太网帧的最大包长，用buf_attach()把这一段挂接到buf上，
+ *             不复制数据，调用ip_fragment_out()函数发送出去
+ *        （3）如果截断后最后的一个分片小于或等于以太网帧的最大包长，同样挂接该分片的数据发送出去
+ *             注意：最后一个分片的MF = 0
+ *    
+ *        如果没有超过以太网帧的最大包长，则直接调用调用ip_fragment_out()函数发送出去。
+ * 
+ * @param buf 要处理的包
+ * @param ip 目标ip地址
+ * @param protocol 上层协议
+ */
+void ip_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol)
+{
+    // TODO 
+    buf_t *ip_buf, *payload;
+    uint16_t offset=0, total_len, Ethernet_max_len;
+    const route_t *route;
+    const uint8_t *next_hop;
+    int ip_id, mtu;
+    // 发给本机的数据报直接放入环回队列，不查路由
+    if(ip_is_local(ip)){
+        ip_loopback_out(buf, protocol, ip_next_id());
+        return;
+    }
+    // 查找路由，得到下一跳和路由MTU，没有路由时丢弃
+    if((route = route_lookup(ip)) == NULL){
+        return;
+    }
+    next_hop = route_next_hop(route, ip);
+    mtu = route_mtu(route, ip);
+    Ethernet_max_len = (mtu - sizeof(ip_hdr_t)) & ~7; // 分片最大包长，分片偏移必须是8字节的整数倍
+    ip_id = ip_next_id();
+    // 驱动只能按网卡MTU分片，路径MTU更小时先补全校验和，由协议栈分片
+    if (buf->len + (int)sizeof(ip_hdr_t) > mtu && (buf->flags & BUF_FLAG_CSUM_PARTIAL) && mtu < net_stack->if_mtu)
+        ip_csum_complete(buf);
+    //  检查从上层传递下来的数据报加上ip首部是否超过MTU，MTU不是8的倍数时装得下的数据报也不分片
+    //  校验和由驱动补全的包整个交给驱动，由驱动分片
+    if (buf->len + (int)sizeof(ip_hdr_t) > mtu && !(buf->flags & BUF_FLAG_CSUM_PARTIAL))// 超过MTU，则需要分片发送
+    {
+        // 各分片引用同一份数据，静态buffer才需要复制一次
+        if((payload = buf_ref(buf)) == NULL){
+            return;
+        }
+        while(offset < buf->len){
+            total_len = buf->len - offset > Ethernet_max_len ? Ethernet_max_len : buf->len - offset;
+            if((ip_buf = buf_alloc(0)) == NULL){
+                break;
+            }
+            buf_attach(ip_buf, payload, payload->data+offset, total_len);
+            ip_fragment_out(ip_buf, ip, next_hop, protocol, ip_id, offset, offset+total_len < buf->len);
+            buf_free(ip_buf);
+            offset += total_len;
+        }
+        buf_free(payload);
+    }
+    else
+    {
+        ip_fragment_out(buf, ip, next_hop, protocol, ip_id, 0, 0);
+    }
+}
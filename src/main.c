@@ -1,34 +1,203 @@
-#include <stdio.h>
-#include <string.h>
-#include <time.h>
-#include "net.h"
-#include "udp.h"
-
-void handler(udp_entry_t *entry, uint8_t *src_ip, uint16_t src_port, buf_t *buf)
-{
-    printf("recv udp packet from %s:%d len=%d\n", iptos(src_ip), src_port, buf->len);
-    for (int i = 0; i < buf->len; i++)
-        putchar(buf->data[i]);
-    putchar('\n');
-    uint16_t len = 1800;
-    //uint16_t len = 1000;
-    uint8_t data[len];
-
-    uint16_t dest_port = 60001;
-    for (int i = 0; i < len; i++)
-        data[i] = i;
-    udp_send(data, len, 60000, src_ip, dest_port); //发送udp包
-}
-int main(int argc, char const *argv[])
-{
-
-    net_init();               //初始化协议栈
-    udp_open(60000, handler); //注册端口的udp监听回调
-
-    while (1)
-    {
-        net_poll(); //一次主循环
-    }
-
-    return 0;
-}
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include "net.h"
+#include "udp.h"
+#include "icmp.h"
+#include "timer.h"
+#include "rss.h"
+#include "ethernet.h"
+
+void handler(udp_entry_t *entry, uint8_t *src_ip, uint16_t src_port, buf_t *buf)
+{
+    (void)entry;
+    printf("recv udp packet from %s:%d len=%d\n", iptos(src_ip), src_port, buf->len);
+    for (int i = 0; i < buf->len; i++)
+        putchar(buf->data[i]);
+    putchar('\n');
+    uint16_t len = 1800;
+    //uint16_t len = 1000;
+    uint8_t data[len];
+
+    uint16_t dest_port = 60001;
+    for (int i = 0; i < len; i++)
+        data[i] = i;
+    udp_send(data, len, 60000, src_ip, dest_port); //发送udp包
+}
+
+/**
+ * @brief RSS工作线程初始化：每个工作线程在自己的协议栈实例上注册监听
+ * 
+ * @param queue 工作线程的队列号
+ */
+void setup(int queue)
+{
+    (void)queue;
+    udp_open(60000, handler);
+}
+
+/**
+ * @brief ping客户端状态
+ * 
+ */
+static struct
+{
+    uint8_t ip[NET_IP_LEN]; //目的地址
+    int count;              //要发送的请求数
+    int interval_ms;        //发送间隔(毫秒)
+    int size;               //数据长度
+    int flood;              //为1时收到应答或超时后立即发送下一个请求，不打印每个结果
+    int sent;               //已发送的请求数
+    int received;           //收到的应答数
+    int lost;               //超时的请求数
+    timer_entry_t timer;    //按间隔发送的定时器
+    hist_t rtt;             //往返时间(纳秒)的直方图
+} ping;
+
+static void ping_send(void *arg);
+
+/**
+ * @brief 回显请求的结果：打印并记录往返时间，洪泛模式下接着发送下一个请求
+ * 
+ * @param ip 目的地址
+ * @param seq 序列号
+ * @param len 数据长度
+ * @param rtt_ns 往返时间(纳秒)，超时为-1
+ */
+static void ping_result(uint8_t *ip, uint16_t seq, int len, int64_t rtt_ns)
+{
+    if (rtt_ns >= 0)
+    {
+        ping.received++;
+        hist_record(&ping.rtt, rtt_ns);
+        if (!ping.flood)
+            printf("%d bytes from %s: icmp_seq=%d time=%.3f ms\n", len + (int)sizeof(icmp_hdr_t), iptos(ip), seq, rtt_ns / 1e6);
+    }
+    else
+    {
+        ping.lost++;
+        if (!ping.flood)
+            printf("Request timeout for icmp_seq %d\n", seq);
+    }
+    if (ping.flood)
+        ping_send(NULL);
+}
+
+/**
+ * @brief 发送下一个回显请求，按间隔发送时由定时器调用
+ * 
+ * @param arg 未使用
+ */
+static void ping_send(void *arg)
+{
+    (void)arg;
+    if (ping.sent == ping.count)
+        return;
+    if (icmp_echo_request(ping.ip, ping.sent, ping.size, ping_result) == 0)
+        ping.sent++;
+    else if (ping.flood) // 发送失败时下一个tick重试，洪泛模式不能没有等待的请求
+        timer_add(&ping.timer, 0, ping_send, NULL);
+    if (!ping.flood && ping.sent < ping.count)
+        timer_add(&ping.timer, ping.interval_ms, ping_send, NULL);
+}
+
+/**
+ * @brief ping客户端：发送回显请求直到全部收到应答或超时，然后打印统计信息
+ *        一直轮询协议栈，往返时间不包含阻塞等待的唤醒延迟，可以用来测量协议栈本身的往返开销
+ * 
+ * @return int 全部丢失为1，否则为0
+ */
+static int ping_run()
+{
+    printf("PING %s %d(%d) bytes of data.\n", iptos(ping.ip), ping.size, ping.size + (int)sizeof(icmp_hdr_t) + 20);
+    hist_init(&ping.rtt);
+    ping_send(NULL);
+    while (ping.sent < ping.count || ping.received + ping.lost < ping.sent)
+        net_poll();
+
+    printf("\n--- %s ping statistics ---\n", iptos(ping.ip));
+    printf("%d packets transmitted, %d received, %.1f%% packet loss\n", ping.sent, ping.received,
+           ping.sent ? 100.0 * ping.lost / ping.sent : 0);
+    if (ping.received)
+    {
+        printf("rtt min/avg/max = %.3f/%.3f/%.3f ms\n", ping.rtt.min / 1e6,
+               (double)ping.rtt.sum / ping.rtt.count / 1e6, ping.rtt.max / 1e6);
+        printf("rtt p50/p90/p99/p99.9 = %.3f/%.3f/%.3f/%.3f ms\n", hist_percentile(&ping.rtt, 50) / 1e6,
+               hist_percentile(&ping.rtt, 90) / 1e6, hist_percentile(&ping.rtt, 99) / 1e6,
+               hist_percentile(&ping.rtt, 99.9) / 1e6);
+    }
+    return ping.received == 0;
+}
+
+/**
+ * @brief 不带参数时作为udp服务端运行；
+ *        带目的地址时作为ping客户端：main [-c 次数] [-i 间隔毫秒] [-s 数据长度] [-f] ip
+ *        -m指定网卡MTU，例如-m 9000使用巨型帧
+ * 
+ */
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    ping.count = 4;
+    ping.interval_ms = 1000;
+    ping.size = 56;
+    while ((opt = getopt(argc, argv, "c:i:s:fm:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            ping.count = atoi(optarg);
+            break;
+        case 'i':
+            ping.interval_ms = atoi(optarg);
+            break;
+        case 's':
+            ping.size = atoi(optarg);
+            break;
+        case 'f':
+            ping.flood = 1;
+            break;
+        case 'm':
+            if (ethernet_set_mtu(atoi(optarg)) != 0) //网卡打开前设置，打开时交给驱动
+                return 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-c count] [-i interval_ms] [-s size] [-f] [-m mtu] [ip]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind < argc)
+    {
+        if (inet_pton(AF_INET, argv[optind], ping.ip) != 1 || ping.count <= 0 || ping.size < 0 ||
+            ping.size > UINT16_MAX - 28 || ping.interval_ms < 0)
+        {
+            fprintf(stderr, "Error in main: invalid ping arguments\n");
+            return 1;
+        }
+        if (net_init() != 0)
+            return 1;
+        return ping_run();
+    }
+
+#if RSS_WORKERS
+    return rss_start(RSS_WORKERS, NULL, setup); //接收线程按流分发给工作线程，不返回
+#endif
+    if (net_init() != 0) //初始化协议栈
+        return 1;
+    udp_open(60000, handler); //注册端口的udp监听回调
+
+#if NET_EVENT_LOOP
+    net_loop(); //事件驱动的主循环，空闲时阻塞等待
+#else
+    while (1)
+    {
+        net_poll(); //一次主循环
+    }
+#endif
+
+    return 0;
+}
@@ -1,24 +1,150 @@
-#include "net.h"
-#include "arp.h"
-#include "udp.h"
-#include "ethernet.h"
-
-/**
- * @brief 初始化协议栈
- * 
- */
-void net_init()
-{
-    ethernet_init();
-    arp_init();
-    udp_init();
-}
-
-/**
- * @brief 一次协议栈轮询
- * 
- */
-void net_poll()
-{
-    ethernet_poll();
-}
\ No newline at end of file
+#include "net.h"
+#include "arp.h"
+#include "ip.h"
+#include "icmp.h"
+#include "udp.h"
+#include "ethernet.h"
+#include "driver.h"
+#include "rss.h"
+#include "timer.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+/**
+ * @brief 创建net_loop()等待用的epoll描述符
+ *        同时等待网卡描述符(RSS工作线程为分发队列的通知)与其他线程投递发送的通知
+ * 
+ * @return int 成功为0，失败为-1；驱动不提供描述符时不创建，返回0
+ */
+static int net_epoll_init()
+{
+    net_stack_t *s = net_stack;
+    struct epoll_event ev = {.events = EPOLLIN};
+    int fd = s->rxq ? s->rxq->efd : driver_get_fd(), txfd = udp_get_tx_fd();
+
+    if (s->epfd > 0) // 重新初始化时先关闭原来的
+        close(s->epfd);
+    s->epfd = -1;
+    if (fd == -1)
+        return 0;
+    if ((s->epfd = epoll_create1(EPOLL_CLOEXEC)) == -1)
+        goto error;
+    ev.data.fd = fd;
+    if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, fd, &ev) == -1)
+        goto error;
+    ev.data.fd = txfd;
+    if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, txfd, &ev) == -1)
+        goto error;
+    return 0;
+
+error:
+    fprintf(stderr, "Error in net_init: %s\n", strerror(errno));
+    if (s->epfd != -1)
+        close(s->epfd);
+    s->epfd = -1;
+    return -1;
+}
+
+/**
+ * @brief 初始化当前线程绑定的协议栈
+ *        多个实例时每个线程先用net_stack_bind()绑定自己的实例，再调用本函数和net_loop()
+ * 
+ * @return int 成功为0，任何一层初始化失败为-1，错误信息由失败的一层输出
+ */
+int net_init()
+{
+    if (timer_init() != 0 || ethernet_init() != 0 || arp_init() != 0 ||
+        ip_init() != 0 || icmp_init() != 0 || udp_init() != 0)
+        return -1;
+    return net_epoll_init();
+}
+
+/**
+ * @brief 一次协议栈轮询
+ *        先更新缓存的时钟并处理到期的定时器，再最多接收NET_POLL_BUDGET个数据包，
+ *        并最多发出NET_POLL_BUDGET个其他线程投递的udp包，再用剩余的额度处理环回队列，期间产生的发送在结束时一起交给驱动
+ * 
+ * @return int 处理的数据包数
+ */
+int net_poll()
+{
+    int budget = NET_POLL_BUDGET, n, sent;
+    ethernet_batch_begin();
+    timer_poll();
+    while (budget > 0 && (n = ethernet_poll(budget)) > 0)
+        budget -= n;
+    sent = udp_tx_poll(NET_POLL_BUDGET); // 发送方向单独计额度，接收繁忙时投递的发送不会饿死
+    budget -= ip_loopback_poll(budget > 0 ? budget : 1); // 发给本机的数据报，至少处理一个以免饿死
+    ethernet_batch_end();
+    return NET_POLL_BUDGET - budget + sent;
+}
+
+/**
+ * @brief 获取单调时钟的当前时间
+ * 
+ * @return int64_t 当前时间(微秒)
+ */
+static int64_t net_now_usec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief 没有可等待的描述符时的主循环：一直轮询，定时器在轮询中处理
+ * 
+ */
+static void net_spin()
+{
+    while (1)
+        net_poll();
+}
+
+/**
+ * @brief 协议栈事件循环，不返回，须先调用net_init()
+ *        用net_init()创建的epoll同时等待网卡描述符(RSS工作线程为分发队列的通知)与其他线程投递发送的通知，
+ *        等待的超时取到下一个定时器到期的时间。
+ *        收到数据包后的NET_BUSY_POLL_USEC微秒内不阻塞，继续忙轮询以降低延迟，
+ *        这段时间内没有新数据包再回到epoll阻塞等待，空闲时不占用CPU。
+ *        驱动不提供描述符时退化为一直轮询
+ * 
+ */
+void net_loop()
+{
+    struct epoll_event events[2];
+    int64_t busy_until = 0;
+    uint64_t cnt;
+    int epfd = net_stack->epfd, txfd = udp_get_tx_fd();
+
+    if (epfd == -1)
+        net_spin();
+
+    while (1)
+    {
+        // 忙轮询期间不阻塞，否则最多等到下一个定时器到期
+        int n = epoll_wait(epfd, events, 2, net_now_usec() < busy_until ? 0 : timer_next_ms());
+        if (n == -1 && errno != EINTR)
+        {
+            fprintf(stderr, "Error in epoll_wait: %s\n", strerror(errno));
+            close(epfd);
+            net_stack->epfd = -1;
+            net_spin();
+        }
+        for (int i = 0; i < n; i++)
+        {
+            // 先清空通知再取投递的数据包，之后的投递会重新通知；RSS分发队列的通知同样先清空
+            // 网卡描述符由驱动读取，不在这里读；通知描述符都是非阻塞的，已被清空时读到EAGAIN
+            int fd = events[i].data.fd;
+            if ((fd == txfd || (net_stack->rxq && fd == net_stack->rxq->efd)) &&
+                read(fd, &cnt, sizeof(cnt)) == -1 && errno != EAGAIN)
+                fprintf(stderr, "Error in net_loop: %s\n", strerror(errno));
+        }
+        if (net_poll() > 0)
+            busy_until = net_now_usec() + NET_BUSY_POLL_USEC;
+    }
+}
@@ -0,0 +1,343 @@
+#include "route.h"
+#include "timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROUTE_STRIDE 8                    // trie每层按目的地址的8位索引
+#define ROUTE_FANOUT (1 << ROUTE_STRIDE) // 每个节点的分支数
+
+/**
+ * @brief 多比特trie的节点
+ *        第level层的节点按目的地址的第level个字节索引，前缀长度在(8*level, 8*(level+1)]之间的路由
+ *        展开到它覆盖的所有分支上，同一分支上前缀较长的路由优先
+ *
+ */
+typedef struct route_node
+{
+    uint16_t route[ROUTE_FANOUT];             // 在本层结束的最长匹配路由号(从1开始)，0表示没有
+    struct route_node *child[ROUTE_FANOUT]; // 更长前缀所在的下一层节点
+} route_node_t;
+
+/**
+ * @brief 路由缓存项
+ *
+ */
+typedef struct route_cache
+{
+    uint32_t ip;    // 目的地址
+    uint32_t gen;   // 缓存时路由表的版本号，与当前版本不同时失效
+    uint16_t route; // 查找结果的路由号，0表示没有路由
+} route_cache_t;
+
+/**
+ * @brief 路径MTU缓存项
+ *
+ */
+typedef struct route_pmtu
+{
+    uint32_t ip;      // 目的地址
+    uint16_t mtu;     // 路径MTU，0表示空闲
+    uint64_t expires; // 过期时间(毫秒，单调时钟)
+} route_pmtu_t;
+
+/**
+ * @brief 路由表，每个协议栈实例一份
+ *        路由连续存放在数组中，另用多比特trie做最长前缀匹配；
+ *        添加路由时直接插入trie，删除时重建，路由表的任何改变都使路由缓存整体失效
+ *
+ */
+typedef struct route_layer
+{
+    route_t routes[ROUTE_MAX];                // 路由表
+    int nr;                                   // 路由数
+    uint16_t default_route;                   // 默认路由的路由号，0表示没有
+    route_node_t *root;                       // trie的根节点，对应目的地址的第一个字节
+    uint32_t gen;                             // 路由表版本号
+    route_cache_t cache[ROUTE_CACHE_SIZE];    // 按目的地址直接映射的路由缓存
+    route_pmtu_t pmtu[PMTU_CACHE_SIZE];       // 按目的地址直接映射的路径MTU缓存，与路由表的改变无关
+} route_layer_t;
+
+/**
+ * @brief 释放trie的一棵子树
+ *
+ * @param node 子树的根节点
+ */
+static void route_node_free(route_node_t *node)
+{
+    if (node == NULL)
+        return;
+    for (int i = 0; i < ROUTE_FANOUT; i++)
+        route_node_free(node->child[i]);
+    free(node);
+}
+
+/**
+ * @brief 把一条路由插入trie
+ *
+ * @param table 路由表
+ * @param index 路由在数组中的下标
+ * @return int 成功为0，失败为-1
+ */
+static int route_insert(route_layer_t *table, int index)
+{
+    route_t *route = &table->routes[index];
+    route_node_t **node = &table->root;
+    int level = 0, span, start;
+
+    if (route->prefix_len == 0)
+    {
+        table->default_route = index + 1;
+        return 0;
+    }
+    for (;; level++)
+    {
+        if (*node == NULL && (*node = calloc(1, sizeof(route_node_t))) == NULL)
+        {
+            fprintf(stderr, "Error in route_insert: out of memory\n");
+            return -1;
+        }
+        if (route->prefix_len <= ROUTE_STRIDE * (level + 1))
+            break;
+        node = &(*node)->child[route->dest[level]];
+    }
+    // 前缀在本层结束，展开到它覆盖的全部分支，已有更长前缀的分支保持不变
+    span = 1 << (ROUTE_STRIDE * (level + 1) - route->prefix_len);
+    start = route->dest[level] & ~(span - 1);
+    for (int i = start; i < start + span; i++)
+    {
+        int old = (*node)->route[i];
+        if (old == 0 || table->routes[old - 1].prefix_len <= route->prefix_len)
+            (*node)->route[i] = index + 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 按路由数组重建trie
+ *
+ * @param table 路由表
+ * @return int 成功为0，失败为-1
+ */
+static int route_rebuild(route_layer_t *table)
+{
+    route_node_free(table->root);
+    table->root = NULL;
+    table->default_route = 0;
+    for (int i = 0; i < table->nr; i++)
+        if (route_insert(table, i) != 0)
+            return -1;
+    return 0;
+}
+
+/**
+ * @brief 在路由数组中查找前缀完全相同的路由
+ *
+ * @param table 路由表
+ * @param dest 目的网络，主机位为0
+ * @param prefix_len 前缀长度
+ * @return int 路由的下标，不存在为-1
+ */
+static int route_find(route_layer_t *table, const uint8_t *dest, int prefix_len)
+{
+    for (int i = 0; i < table->nr; i++)
+        if (table->routes[i].prefix_len == prefix_len && memcmp(table->routes[i].dest, dest, NET_IP_LEN) == 0)
+            return i;
+    return -1;
+}
+
+/**
+ * @brief 把地址的主机位清零
+ *
+ * @param net 输出的网络地址
+ * @param ip ip地址
+ * @param prefix_len 前缀长度
+ */
+static void route_mask(uint8_t *net, const uint8_t *ip, int prefix_len)
+{
+    for (int i = 0; i < NET_IP_LEN; i++, prefix_len -= 8)
+        net[i] = prefix_len >= 8 ? ip[i] : prefix_len <= 0 ? 0 : ip[i] & (0xff00 >> prefix_len);
+}
+
+/**
+ * @brief 初始化当前协议栈的路由表，已初始化时不做任何事
+ *        添加网卡所在子网的直连路由和默认路由，未配置网关时默认路由也按直连处理
+ *
+ * @return int 成功为0，失败为-1
+ */
+int route_init()
+{
+    uint8_t any[NET_IP_LEN] = {0}, gateway[NET_IP_LEN] = DRIVER_IF_GATEWAY;
+    if (net_stack->route != NULL)
+        return 0;
+    if ((net_stack->route = calloc(1, sizeof(route_layer_t))) == NULL)
+    {
+        fprintf(stderr, "Error in route_init: out of memory\n");
+        return -1;
+    }
+    net_stack->route->gen = 1;
+    if (route_add(net_if_ip, DRIVER_IF_PREFIX_LEN, NULL, 0) != 0)
+        return -1;
+    return route_add(any, 0, gateway, 0);
+}
+
+/**
+ * @brief 添加路由，相同前缀的路由已存在时替换
+ *
+ * @param dest 目的网络
+ * @param prefix_len 前缀长度
+ * @param gateway 网关，为NULL或全0表示直连
+ * @param mtu 路由MTU，0表示使用网卡MTU
+ * @return int 成功为0，失败为-1
+ */
+int route_add(const uint8_t *dest, int prefix_len, const uint8_t *gateway, uint16_t mtu)
+{
+    route_layer_t *table = net_stack->route;
+    uint8_t net[NET_IP_LEN];
+    route_t *route;
+    int index;
+
+    if (prefix_len < 0 || prefix_len > 32)
+    {
+        fprintf(stderr, "Error in route_add: invalid prefix length %d\n", prefix_len);
+        return -1;
+    }
+    route_mask(net, dest, prefix_len);
+    if ((index = route_find(table, net, prefix_len)) < 0)
+    {
+        if (table->nr == ROUTE_MAX)
+        {
+            fprintf(stderr, "Error in route_add: routing table full\n");
+            return -1;
+        }
+        index = table->nr++;
+    }
+    route = &table->routes[index];
+    memcpy(route->dest, net, NET_IP_LEN);
+    route->prefix_len = prefix_len;
+    if (gateway != NULL)
+        memcpy(route->gateway, gateway, NET_IP_LEN);
+    else
+        memset(route->gateway, 0, NET_IP_LEN);
+    route->mtu = mtu;
+    table->gen++;
+    return route_insert(table, index);
+}
+
+/**
+ * @brief 删除路由
+ *
+ * @param dest 目的网络
+ * @param prefix_len 前缀长度
+ * @return int 成功为0，路由不存在为-1
+ */
+int route_del(const uint8_t *dest, int prefix_len)
+{
+    route_layer_t *table = net_stack->route;
+    uint8_t net[NET_IP_LEN];
+    int index;
+
+    if (prefix_len < 0 || prefix_len > 32)
+        return -1;
+    route_mask(net, dest, prefix_len);
+    if ((index = route_find(table, net, prefix_len)) < 0)
+        return -1;
+    // 最后一条路由移到空出的位置，路由号改变，需要重建trie
+    table->routes[index] = table->routes[--table->nr];
+    table->gen++;
+    return route_rebuild(table);
+}
+
+/**
+ * @brief 最长前缀匹配查找路由
+ *        先查按目的地址直接映射的路由缓存，未命中时查多比特trie，最多访问4个节点
+ *
+ * @param ip 目的ip地址
+ * @return const route_t* 匹配的路由，没有路由为NULL；路由表改变后失效
+ */
+const route_t *route_lookup(const uint8_t *ip)
+{
+    route_layer_t *table = net_stack->route;
+    route_node_t *node = table->root;
+    route_cache_t *cache;
+    uint32_t key;
+    int best = table->default_route;
+
+    memcpy(&key, ip, NET_IP_LEN);
+    cache = &table->cache[(key * 0x9E3779B1u) >> 16 & (ROUTE_CACHE_SIZE - 1)];
+    if (cache->ip == key && cache->gen == table->gen)
+        return cache->route ? &table->routes[cache->route - 1] : NULL;
+    // 逐层向下，记住最后遇到的匹配，即最长的前缀
+    for (int level = 0; node != NULL && level < NET_IP_LEN; level++)
+    {
+        if (node->route[ip[level]])
+            best = node->route[ip[level]];
+        node = node->child[ip[level]];
+    }
+    cache->ip = key;
+    cache->gen = table->gen;
+    cache->route = best;
+    return best ? &table->routes[best - 1] : NULL;
+}
+
+/**
+ * @brief 按路由计算下一跳地址
+ *
+ * @param route 路由
+ * @param ip 目的ip地址
+ * @return const uint8_t* 直连路由为目的地址本身，否则为网关
+ */
+const uint8_t *route_next_hop(const route_t *route, const uint8_t *ip)
+{
+    static const uint8_t any[NET_IP_LEN] = {0};
+    return memcmp(route->gateway, any, NET_IP_LEN) == 0 ? ip : route->gateway;
+}
+
+/**
+ * @brief 计算发往目的地址的数据报可用的MTU
+ *        取网卡MTU、路由MTU和未过期的路径MTU中最小的一个
+ *
+ * @param route 路由
+ * @param ip 目的ip地址
+ * @return int MTU
+ */
+int route_mtu(const route_t *route, const uint8_t *ip)
+{
+    route_pmtu_t *pmtu;
+    uint32_t key;
+    int mtu = net_stack->if_mtu;
+
+    if (route->mtu != 0 && route->mtu < mtu)
+        mtu = route->mtu;
+    memcpy(&key, ip, NET_IP_LEN);
+    pmtu = &net_stack->route->pmtu[(key * 0x9E3779B1u) >> 16 & (PMTU_CACHE_SIZE - 1)];
+    if (pmtu->mtu != 0 && pmtu->ip == key && pmtu->mtu < mtu && timer_now() < pmtu->expires)
+        return pmtu->mtu;
+    return mtu;
+}
+
+/**
+ * @brief 记录到一个目的地址的路径MTU，由收到的icmp"需要分片"报文调用
+ *        只会调小，过期后恢复为路由MTU重新探测；冲突时新地址直接占用缓存项
+ *
+ * @param ip 目的ip地址
+ * @param mtu 路径MTU，小于PMTU_MIN时按PMTU_MIN记录
+ */
+void route_pmtu_update(const uint8_t *ip, int mtu)
+{
+    const route_t *route = route_lookup(ip);
+    route_pmtu_t *pmtu;
+    uint32_t key;
+
+    if (route == NULL)
+        return;
+    if (mtu < PMTU_MIN)
+        mtu = PMTU_MIN;
+    if (mtu >= route_mtu(route, ip))
+        return;
+    memcpy(&key, ip, NET_IP_LEN);
+    pmtu = &net_stack->route->pmtu[(key * 0x9E3779B1u) >> 16 & (PMTU_CACHE_SIZE - 1)];
+    pmtu->ip = key;
+    pmtu->mtu = mtu;
+    pmtu->expires = timer_now() + PMTU_TIMEOUT_SEC * 1000;
+}
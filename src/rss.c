@@ -0,0 +1,385 @@
+#define _GNU_SOURCE
+#include "rss.h"
+#include "driver.h"
+#include "ethernet.h"
+#include "ip.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#define RSS_INPUT_MAX 12 // 哈希输入的最大字节数：源地址、目的地址、源端口、目的端口
+
+typedef struct rss_worker
+{
+    net_stack_t *stack; // 工作线程的协议栈实例
+    int cpu;            // 绑定的CPU，-1表示不绑定
+    rss_setup_t setup;  // 初始化回调
+    pthread_t thread;   // 工作线程
+} rss_worker_t;
+
+/**
+ * @brief 工作线程的启动状态
+ *        全部工作线程创建成功后才开始运行，中途失败时已创建的工作线程直接退出
+ *
+ */
+static enum { RSS_WAIT, RSS_RUN, RSS_ABORT } rss_state = RSS_WAIT;
+static pthread_mutex_t rss_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rss_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief Toeplitz哈希的密钥，与常见网卡RSS的默认密钥相同
+ *
+ */
+static const uint8_t rss_key[40] = {
+    0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67,
+    0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0, 0xd0, 0xca, 0x2b, 0xcb,
+    0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30,
+    0xf2, 0x0c, 0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa};
+
+/**
+ * @brief 按输入的字节位置和取值预先算好的Toeplitz哈希，每个输入字节只需查一次表
+ *
+ */
+static uint32_t rss_table[RSS_INPUT_MAX][256];
+
+/**
+ * @brief 计算Toeplitz哈希的查找表
+ *
+ */
+static void rss_table_init()
+{
+    for (int i = 0; i < RSS_INPUT_MAX; i++)
+        for (int bit = 0; bit < 8; bit++)
+        {
+            // 输入的第i * 8 + bit位为1时，异或上密钥从该位开始的32位
+            uint32_t window = 0;
+            for (int j = 0; j < 32; j++)
+            {
+                int k = i * 8 + bit + j;
+                window = window << 1 | (rss_key[k / 8] >> (7 - k % 8) & 1);
+            }
+            for (int v = 0; v < 256; v++)
+                if (v & 0x80 >> bit)
+                    rss_table[i][v] ^= window;
+        }
+}
+
+/**
+ * @brief 计算一段输入的Toeplitz哈希
+ *
+ * @param input 输入
+ * @param len 输入长度，不超过RSS_INPUT_MAX
+ * @return uint32_t 哈希值
+ */
+static uint32_t rss_toeplitz(const uint8_t *input, int len)
+{
+    uint32_t hash = 0;
+    for (int i = 0; i < len; i++)
+        hash ^= rss_table[i][input[i]];
+    return hash;
+}
+
+/**
+ * @brief 选择数据帧要分发到的工作线程
+ *        udp包按(源地址, 目的地址, 源端口, 目的端口)，分片按(源地址, 目的地址, 标识符)，
+ *        其他IPv4包按(源地址, 目的地址)哈希；非IP的数据帧交给0号工作线程
+ *
+ * @param buf 数据帧
+ * @param workers 工作线程数
+ * @return int 工作线程号，arp包为-1，表示交给所有工作线程
+ */
+static int rss_classify(buf_t *buf, int workers)
+{
+    uint8_t *pkt = buf->data + sizeof(ether_hdr_t), input[RSS_INPUT_MAX];
+    int proto = buf->data[12] << 8 | buf->data[13], len = 8, hdr_len;
+    ip_hdr_t *ip_hdr = (ip_hdr_t *)pkt;
+
+    if (proto == NET_PROTOCOL_ARP)
+        return -1;
+    if (proto != NET_PROTOCOL_IP || buf->len < (int)(sizeof(ether_hdr_t) + sizeof(ip_hdr_t)))
+        return 0;
+    hdr_len = ip_hdr->hdr_len * IP_HDR_LEN_PER_BYTE;
+    memcpy(input, ip_hdr->src_ip, NET_IP_LEN);
+    memcpy(input + NET_IP_LEN, ip_hdr->dest_ip, NET_IP_LEN);
+    if (swap16(ip_hdr->flags_fragment) & 0x3fff) // 分片不一定带有端口，同一数据报的分片必须分到一起
+    {
+        memcpy(input + 8, &ip_hdr->id, 2);
+        len = 10;
+    }
+    else if (ip_hdr->protocol == NET_PROTOCOL_UDP && buf->len >= (int)sizeof(ether_hdr_t) + hdr_len + 4)
+    {
+        memcpy(input + 8, pkt + hdr_len, 4);
+        len = 12;
+    }
+    return (uint64_t)rss_toeplitz(input, len) * workers >> 32;
+}
+
+/**
+ * @brief 创建分发队列
+ *
+ * @param size 队列长度，必须为2的幂
+ * @return rss_queue_t* 分发队列，失败为NULL
+ */
+static rss_queue_t *rss_queue_create(int size)
+{
+    size_t bytes = (sizeof(rss_queue_t) + size * sizeof(buf_t *) + 63) & ~(size_t)63;
+    rss_queue_t *queue = aligned_alloc(64, bytes);
+    if (queue == NULL)
+        return NULL;
+    memset(queue, 0, sizeof(rss_queue_t));
+    queue->mask = size - 1;
+    if ((queue->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+    {
+        free(queue);
+        return NULL;
+    }
+    return queue;
+}
+
+/**
+ * @brief 把一个数据帧复制到工作线程的分发队列，在接收线程中调用
+ *        复制到接收线程缓存的buffer中，工作线程释放后由缓存回收；队列满或缓存用尽时丢弃
+ *
+ * @param queue 分发队列
+ * @param buf 数据帧
+ */
+static void rss_queue_put(rss_queue_t *queue, buf_t *buf)
+{
+    buf_t *copy;
+    if (queue->pending - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) > queue->mask)
+        return;
+    if ((copy = buf_thread_alloc(buf->len)) == NULL)
+        return;
+    memcpy(copy->data, buf->data, buf->len);
+    copy->flags = buf->flags;
+    queue->bufs[queue->pending++ & queue->mask] = copy;
+}
+
+/**
+ * @brief 发布这一批写入的数据帧，工作线程可能在等待时唤醒它
+ *
+ * @param queue 分发队列
+ */
+static void rss_queue_publish(rss_queue_t *queue)
+{
+    uint32_t head = queue->head;
+    if (queue->pending == head)
+        return;
+    __atomic_store_n(&queue->head, queue->pending, __ATOMIC_RELEASE);
+    // 与工作线程更新读取位置后的屏障配对，两边至少有一方能看到对方的写入
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&queue->tail, __ATOMIC_RELAXED) == head)
+        eventfd_write(queue->efd, 1);
+}
+
+/**
+ * @brief 把当前线程绑定到一个CPU
+ *
+ * @param cpu CPU号，-1表示不绑定
+ */
+static void rss_pin(int cpu)
+{
+    cpu_set_t set;
+    int err;
+    if (cpu < 0)
+        return;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if ((err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) != 0)
+        fprintf(stderr, "Error in pthread_setaffinity_np: %s\n", strerror(err));
+}
+
+/**
+ * @brief 设置工作线程的启动状态并唤醒等待的工作线程
+ *
+ * @param state 新的状态
+ */
+static void rss_set_state(int state)
+{
+    pthread_mutex_lock(&rss_lock);
+    rss_state = state;
+    pthread_cond_broadcast(&rss_cond);
+    pthread_mutex_unlock(&rss_lock);
+}
+
+/**
+ * @brief 工作线程：等待全部工作线程创建完成，绑定自己的协议栈实例，初始化后进入事件循环
+ *
+ * @param arg 工作线程参数
+ * @return void* 启动被取消或初始化失败时为NULL，否则不返回
+ */
+static void *rss_worker_main(void *arg)
+{
+    rss_worker_t *worker = arg;
+    int state;
+    pthread_mutex_lock(&rss_lock);
+    while ((state = rss_state) == RSS_WAIT)
+        pthread_cond_wait(&rss_cond, &rss_lock);
+    pthread_mutex_unlock(&rss_lock);
+    if (state != RSS_RUN)
+        return NULL;
+    rss_pin(worker->cpu);
+    net_stack_bind(worker->stack);
+    if (net_init() != 0)
+    {
+        fprintf(stderr, "Error in rss_worker_main: queue %d failed to initialize\n", worker->stack->queue);
+        return NULL;
+    }
+    if (worker->setup)
+        worker->setup(worker->stack->queue);
+    net_loop();
+    return NULL;
+}
+
+/**
+ * @brief 释放一个尚未启动的工作线程的协议栈实例，包括它的分发队列和发送句柄
+ *
+ * @param worker 工作线程
+ */
+static void rss_worker_free(rss_worker_t *worker)
+{
+    net_stack_t *stack = worker->stack, *self = net_stack;
+    if (stack == NULL)
+        return;
+    if (stack->driver != NULL)
+    {
+        net_stack_bind(stack);
+        driver_close();
+        net_stack_bind(self);
+        free(stack->driver);
+    }
+    if (stack->rxq != NULL)
+    {
+        close(stack->rxq->efd);
+        free(stack->rxq);
+    }
+    free(stack);
+    worker->stack = NULL;
+}
+
+/**
+ * @brief 接收线程的主循环：批量接收数据帧并分发给工作线程，没有数据帧时阻塞等待，不返回
+ *
+ * @param workers 工作线程
+ * @param nr 工作线程数
+ * @param bufs ETHERNET_RX_BATCH个接收缓冲区
+ */
+static void rss_rx_loop(rss_worker_t *workers, int nr, buf_t **bufs)
+{
+    struct pollfd pfd = {.fd = driver_get_fd(), .events = POLLIN};
+    int n, q;
+
+    while (1)
+    {
+        if ((n = driver_recv_batch(bufs, ETHERNET_RX_BATCH)) <= 0)
+        {
+            if (pfd.fd != -1)
+                poll(&pfd, 1, -1);
+            continue;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            if (bufs[i]->len < (int)sizeof(ether_hdr_t))
+                continue;
+            if ((q = rss_classify(bufs[i], nr)) >= 0)
+                rss_queue_put(workers[q].stack->rxq, bufs[i]);
+            else // 每个工作线程各有一张arp表
+                for (q = 0; q < nr; q++)
+                    rss_queue_put(workers[q].stack->rxq, bufs[i]);
+        }
+        for (q = 0; q < nr; q++)
+            rss_queue_publish(workers[q].stack->rxq);
+    }
+}
+
+/**
+ * @brief 启用软件RSS，成功时不返回
+ *        当前线程成为接收线程，打开网卡后按IPv4/UDP五元组的Toeplitz哈希把数据帧分发给workers个工作线程，
+ *        IP分片按(源地址, 目的地址, 标识符)哈希，同一数据报的分片总在同一个工作线程重组。
+ *        每个工作线程运行一个独立的协议栈实例，arp表、udp端口表、缓冲池和发送用的网卡句柄都不共享。
+ *        全部工作线程创建成功后才开始运行，中途失败时已创建的工作线程退出，分配的资源全部释放
+ *
+ * @param workers 工作线程数
+ * @param cpus 为NULL时不绑定CPU，否则cpus[0]为接收线程、cpus[i]为第i-1个工作线程要绑定的CPU，-1表示不绑定
+ * @param setup 工作线程初始化回调，可以为NULL
+ * @return int 失败为-1
+ */
+int rss_start(int workers, const int *cpus, rss_setup_t setup)
+{
+    rss_worker_t *worker;
+    net_stack_t *rx = net_stack;
+    buf_t *bufs[ETHERNET_RX_BATCH] = {NULL};
+    int err, started = 0;
+
+    if (workers <= 0 || workers > RSS_MAX_WORKERS)
+    {
+        fprintf(stderr, "Error in rss_start: invalid worker count %d\n", workers);
+        return -1;
+    }
+    if ((worker = calloc(workers, sizeof(rss_worker_t))) == NULL)
+    {
+        fprintf(stderr, "Error in rss_start: out of memory\n");
+        return -1;
+    }
+    rss_table_init();
+    rss_pin(cpus ? cpus[0] : -1);
+    if (driver_open() != 0)
+    {
+        free(worker);
+        return -1;
+    }
+    for (int i = 0; i < ETHERNET_RX_BATCH; i++)
+        if ((bufs[i] = buf_alloc(rx->if_mtu + sizeof(ether_hdr_t))) == NULL)
+        {
+            fprintf(stderr, "Error in rss_start: out of memory\n");
+            goto error;
+        }
+    for (int i = 0; i < workers; i++)
+    {
+        worker[i].cpu = cpus ? cpus[i + 1] : -1;
+        worker[i].setup = setup;
+        if ((worker[i].stack = net_stack_create(rx->if_name, rx->if_mac, rx->if_ip)) == NULL ||
+            (worker[i].stack->rxq = rss_queue_create(RSS_QUEUE_SIZE)) == NULL)
+        {
+            fprintf(stderr, "Error in rss_start: out of memory\n");
+            goto error;
+        }
+        worker[i].stack->if_mtu = rx->if_mtu;
+        worker[i].stack->queue = i;
+        net_stack_bind(worker[i].stack); // 发送句柄属于工作线程的协议栈实例
+        err = driver_open_tx(rx->driver);
+        net_stack_bind(rx);
+        if (err != 0)
+            goto error;
+    }
+    for (; started < workers; started++)
+        if ((err = pthread_create(&worker[started].thread, NULL, rss_worker_main, &worker[started])) != 0)
+        {
+            fprintf(stderr, "Error in pthread_create: %s\n", strerror(err));
+            goto error;
+        }
+    rss_set_state(RSS_RUN);
+    for (int i = 0; i < workers; i++)
+        pthread_detach(worker[i].thread);
+    rss_rx_loop(worker, workers, bufs);
+    return -1;
+
+error:
+    rss_set_state(RSS_ABORT); // 已创建的工作线程还没有开始运行，直接退出
+    for (int i = 0; i < started; i++)
+        pthread_join(worker[i].thread, NULL);
+    rss_set_state(RSS_WAIT);
+    for (int i = 0; i < workers; i++)
+        rss_worker_free(&worker[i]);
+    for (int i = 0; i < ETHERNET_RX_BATCH; i++)
+        buf_free(bufs[i]);
+    driver_close();
+    free(worker);
+    return -1;
+}
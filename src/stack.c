@@ -0,0 +1,63 @@
+#include "net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief 按config.h配置的默认协议栈实例
+ *        没有调用net_stack_bind()的线程都使用它，只有一块网卡时不需要创建别的实例
+ *
+ */
+static net_stack_t net_stack_default __attribute__((aligned(64))) = {
+#if DRIVER_TYPE == DRIVER_TAP
+    .if_name = TAP_IF_NAME,
+#else
+    .if_name = DRIVER_IF_NAME,
+#endif
+    .if_mac = DRIVER_IF_MAC,
+    .if_ip = DRIVER_IF_IP,
+    .if_mtu = ETHERNET_MTU};
+
+__thread net_stack_t *net_stack = &net_stack_default;
+
+/**
+ * @brief 创建一个协议栈实例
+ *        只设置网卡参数，各层状态在绑定到线程后调用net_init()时分配
+ *
+ * @param if_name 网卡名称
+ * @param mac 网卡mac地址
+ * @param ip 网卡ip地址
+ * @return net_stack_t* 协议栈实例，失败为NULL
+ */
+net_stack_t *net_stack_create(const char *if_name, const uint8_t *mac, const uint8_t *ip)
+{
+    net_stack_t *stack;
+    if (strlen(if_name) >= NET_IF_NAME_LEN)
+    {
+        fprintf(stderr, "Error in net_stack_create: interface name too long\n");
+        return NULL;
+    }
+    // 按缓存行对齐，不同核上的实例不会共享缓存行
+    if ((stack = aligned_alloc(64, (sizeof(net_stack_t) + 63) & ~63)) == NULL)
+    {
+        fprintf(stderr, "Error in net_stack_create: out of memory\n");
+        return NULL;
+    }
+    memset(stack, 0, sizeof(net_stack_t));
+    strcpy(stack->if_name, if_name);
+    memcpy(stack->if_mac, mac, NET_MAC_LEN);
+    memcpy(stack->if_ip, ip, NET_IP_LEN);
+    stack->if_mtu = ETHERNET_MTU;
+    return stack;
+}
+
+/**
+ * @brief 把协议栈实例绑定到当前线程
+ *        之后当前线程的所有协议栈调用都作用于该实例
+ *
+ * @param stack 协议栈实例
+ */
+void net_stack_bind(net_stack_t *stack)
+{
+    net_stack = stack;
+}
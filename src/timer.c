@@ -0,0 +1,222 @@
+#include "timer.h"
+#include "net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define TIMER_ROOT_BITS 8                          // 第0层的槽数为2^8，每槽1个tick
+#define TIMER_LEVEL_BITS 6                         // 上面各层的槽数为2^6，每槽是下一层一整圈
+#define TIMER_LEVELS 3                             // 第0层之上的层数
+#define TIMER_ROOT_SIZE (1 << TIMER_ROOT_BITS)
+#define TIMER_LEVEL_SIZE (1 << TIMER_LEVEL_BITS)
+#define TIMER_LEVEL_SHIFT(level) (TIMER_ROOT_BITS + (level) * TIMER_LEVEL_BITS) // 第level层(从0数起)的tick位移
+#define TIMER_MAX_DELTA ((1ull << TIMER_LEVEL_SHIFT(TIMER_LEVELS)) - 1)      // 时间轮能表示的最远到期时间
+
+/**
+ * @brief 分层时间轮，每个协议栈实例一份
+ *        第0层每槽对应1个tick，上面一层每槽对应下面一层的一整圈。
+ *        启动和停止定时器只需在槽的链表中插入或删除，为O(1)；
+ *        第0层转完一圈时把上一层的一个槽分散到下一层，处理代价只与到期和迁移的定时器数有关，与定时器总数无关
+ *
+ */
+typedef struct timer_layer
+{
+    uint64_t jiffies;                                         // 下一个要处理的tick
+    uint64_t now;                                             // 缓存的单调时钟(毫秒)
+    timer_entry_t *root[TIMER_ROOT_SIZE];                     // 第0层
+    timer_entry_t *levels[TIMER_LEVELS][TIMER_LEVEL_SIZE];    // 上面各层
+} timer_layer_t;
+
+/**
+ * @brief 读取单调时钟
+ *        CLOCK_MONOTONIC_COARSE由vDSO直接读取，不进入内核，精度为内核的一个tick
+ *
+ * @return uint64_t 当前时间(毫秒)
+ */
+static uint64_t timer_clock()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief 按到期时间把定时器挂到对应的槽上
+ *
+ * @param wheel 时间轮
+ * @param timer 定时器
+ */
+static void timer_link(timer_layer_t *wheel, timer_entry_t *timer)
+{
+    uint64_t expires = timer->expires, delta;
+    timer_entry_t **slot;
+
+    if ((int64_t)(expires - wheel->jiffies) < 0) // 已经到期，放到下一个要处理的槽
+        expires = wheel->jiffies;
+    delta = expires - wheel->jiffies;
+    if (delta < TIMER_ROOT_SIZE)
+        slot = &wheel->root[expires & (TIMER_ROOT_SIZE - 1)];
+    else
+    {
+        int level = 0;
+        if (delta > TIMER_MAX_DELTA) // 超出时间轮范围，先放在最上层最远的槽，迁移时重新计算
+            expires = wheel->jiffies + TIMER_MAX_DELTA;
+        while (level < TIMER_LEVELS - 1 && delta >> TIMER_LEVEL_SHIFT(level + 1))
+            level++;
+        slot = &wheel->levels[level][(expires >> TIMER_LEVEL_SHIFT(level)) & (TIMER_LEVEL_SIZE - 1)];
+    }
+    timer->next = *slot;
+    if (*slot)
+        (*slot)->pprev = &timer->next;
+    timer->pprev = slot;
+    *slot = timer;
+}
+
+/**
+ * @brief 把定时器从所在的槽上摘下
+ *
+ * @param timer 定时器
+ */
+static void timer_unlink(timer_entry_t *timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next)
+        timer->next->pprev = timer->pprev;
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/**
+ * @brief 把上层的一个槽分散到下层
+ *
+ * @param wheel 时间轮
+ * @param level 层号
+ * @param index 槽号
+ * @return int 槽号，为0时说明更上一层也转过了一个槽
+ */
+static int timer_cascade(timer_layer_t *wheel, int level, int index)
+{
+    timer_entry_t *timer = wheel->levels[level][index], *next;
+    wheel->levels[level][index] = NULL;
+    for (; timer != NULL; timer = next)
+    {
+        next = timer->next;
+        timer_link(wheel, timer);
+    }
+    return index;
+}
+
+/**
+ * @brief 初始化当前协议栈的时间轮，已初始化时不做任何事
+ *
+ * @return int 成功为0，失败为-1
+ */
+int timer_init()
+{
+    timer_layer_t *wheel;
+    if (net_stack->timer != NULL)
+        return 0;
+    if ((wheel = calloc(1, sizeof(timer_layer_t))) == NULL)
+    {
+        fprintf(stderr, "Error in timer_init: out of memory\n");
+        return -1;
+    }
+    wheel->now = timer_clock();
+    wheel->jiffies = wheel->now / TIMER_TICK_MS;
+    net_stack->timer = wheel;
+    return 0;
+}
+
+/**
+ * @brief 启动定时器，已启动的定时器重新计时
+ *
+ * @param timer 定时器
+ * @param delay_ms 到期时间(毫秒)
+ * @param handler 到期处理函数，在协议栈线程中调用，调用时定时器已停止
+ * @param arg 处理函数的参数
+ */
+void timer_add(timer_entry_t *timer, uint32_t delay_ms, timer_handler_t handler, void *arg)
+{
+    timer_layer_t *wheel = net_stack->timer;
+    if (timer->pprev != NULL)
+        timer_unlink(timer);
+    timer->handler = handler;
+    timer->arg = arg;
+    timer->expires = (wheel->now + delay_ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS; // 向上取整，不会提前到期
+    timer_link(wheel, timer);
+}
+
+/**
+ * @brief 停止定时器，未启动的定时器不做任何事
+ *
+ * @param timer 定时器
+ */
+void timer_del(timer_entry_t *timer)
+{
+    if (timer->pprev != NULL)
+        timer_unlink(timer);
+}
+
+/**
+ * @brief 获取缓存的单调时钟
+ *        每次协议栈轮询只读一次时钟
+ *
+ * @return uint64_t 当前时间(毫秒)
+ */
+uint64_t timer_now()
+{
+    return net_stack->timer->now;
+}
+
+/**
+ * @brief 更新缓存的时钟并处理到期的定时器，由协议栈轮询调用
+ *
+ * @return int 到期的定时器数
+ */
+int timer_poll()
+{
+    timer_layer_t *wheel = net_stack->timer;
+    timer_entry_t *timer, *expired;
+    uint64_t target;
+    int n = 0;
+
+    wheel->now = timer_clock();
+    target = wheel->now / TIMER_TICK_MS;
+    while ((int64_t)(target - wheel->jiffies) >= 0)
+    {
+        int index = wheel->jiffies & (TIMER_ROOT_SIZE - 1);
+        // 第0层转完一圈，依次把上层当前的槽分散下来
+        for (int level = 0; index == 0 && level < TIMER_LEVELS; level++)
+            index = timer_cascade(wheel, level, (wheel->jiffies >> TIMER_LEVEL_SHIFT(level)) & (TIMER_LEVEL_SIZE - 1));
+        index = wheel->jiffies++ & (TIMER_ROOT_SIZE - 1);
+        // 先把整个槽摘下，处理函数中新启动的定时器即使落在这个槽也要等下一圈
+        if ((expired = wheel->root[index]) != NULL)
+            expired->pprev = &expired;
+        wheel->root[index] = NULL;
+        while ((timer = expired) != NULL)
+        {
+            timer_unlink(timer);
+            timer->handler(timer->arg);
+            n++;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief 估计距下一个定时器到期的时间，协议栈空闲时用作阻塞等待的超时
+ *        只查看第0层到下一次迁移之前的槽，没有定时器时返回到下一次迁移的时间
+ *
+ * @return int 等待时间(毫秒)
+ */
+int timer_next_ms()
+{
+    timer_layer_t *wheel = net_stack->timer;
+    uint64_t tick = wheel->jiffies;
+    int64_t wait;
+    // 上层的定时器迁移时才落到第0层，只能看到下一次迁移为止
+    while ((tick & (TIMER_ROOT_SIZE - 1)) != 0 && wheel->root[tick & (TIMER_ROOT_SIZE - 1)] == NULL)
+        tick++;
+    wait = (int64_t)(tick * TIMER_TICK_MS) - (int64_t)wheel->now;
+    return wait > 0 ? wait : 0;
+}
@@ -1,218 +1,820 @@
-#include "udp.h"
-#include "ip.h"
-#include "icmp.h"
-#include <stdlib.h>
-#include <string.h>
-#include <stdio.h>
-#define UDP_FACK_HEAD_LEN 12
-#define UDP_HEAD_LEN 8
-/**
- * @brief udp处理程序表
- * 
- */
-static udp_entry_t udp_table[UDP_MAX_HANDLER];
-
-/**
- * @brief udp伪校验和计算
- *        1. 你首先调用buf_add_header()添加UDP伪头部
- *        2. 将IP头部拷贝出来，暂存被UDP伪头部覆盖的IP头部
- *        3. 填写UDP伪头部的12字节字段
- *        4. 计算UDP校验和，注意：UDP校验和覆盖了UDP头部、UDP数据和UDP伪头部
- *        5. 再将暂存的IP头部拷贝回来
- *        6. 调用buf_remove_header()函数去掉UDP伪头部
- *        7. 返回计算后的校验和。  
- * 
- * @param buf 要计算的包
- * @param src_ip 源ip地址
- * @param dest_ip 目的ip地址
- * @return uint16_t 伪校验和
- */
-static uint16_t udp_checksum(buf_t *buf, uint8_t *src_ip, uint8_t *dest_ip)
-{
-    // TODO
-    ip_hdr_t ip_hdr;
-    udp_hdr_t udp_hdr;
-    uint16_t data16[BUF_MAX_LEN],checksum,temp;
-    // 获取UDP头部
-    memcpy(&udp_hdr, buf->data, sizeof(udp_hdr_t));
-    // 将IP头部拷贝出来
-    memcpy(&ip_hdr, buf->data-IP_HDR_LEN, IP_HDR_LEN); // 传入的buf指向UDP头
-    // 增加一个12字节的伪头部
-    buf_add_header(buf, UDP_FACK_HEAD_LEN); 
-    // 填写UDP伪头部
-    memcpy(buf->data, src_ip, NET_IP_LEN); // 填写源IP地址
-    memcpy(buf->data+NET_IP_LEN, dest_ip, NET_IP_LEN); // 填写目的IP地址
-    buf->data[2*NET_IP_LEN] = 0;
-    buf->data[2*NET_IP_LEN+1] = ip_hdr.protocol; // 填写协议号
-    memcpy(buf->data+2*NET_IP_LEN+2, &udp_hdr.total_len, 2); // 填写2字节的UDP长度
-    // 计算UDP校验和，覆盖了UDP头部、UDP数据和UDP伪头部
-    // 将1字节转为2字节一组，累加后进位加到尾部，若还有进位再加一次
-    // buf->data中存放着UPD伪头部、UDP头部以及数据部分
-    if(buf->len % 2 == 1){ // 数据报是奇数字节，最后用0填充
-        buf->data[buf->len] = 0;
-        buf->len++;
-    }
-    for(int i = 0; i < buf->len/2; i++){
-        temp = (buf->data[2*i] << 8)&0xff00;
-        data16[i] = temp + buf->data[2*i+1];
-        data16[i] = swap16(data16[i]);
-    }
-    checksum = checksum16(data16, buf->len/2); 
-    // 去掉伪头部
-    buf_remove_header(buf, UDP_FACK_HEAD_LEN);
-    // 再将IP头部拷贝回来
-    memcpy(buf->data-IP_HDR_LEN, &ip_hdr, IP_HDR_LEN);
-    return checksum;
-}
-
-/**
- * @brief 处理一个收到的udp数据包
- *        你首先需要检查UDP报头长度
- *        接着计算checksum，步骤如下：
- *          （1）先将UDP首部的checksum缓存起来
- *          （2）再将UDP首都的checksum字段清零
- *          （3）调用udp_checksum()计算UDP校验和
- *          （4）比较计算后的校验和与之前缓存的checksum进行比较，如不相等，则不处理该数据报。
- *       然后，根据该数据报目的端口号查找udp_table，查看是否有对应的处理函数（回调函数）
- *       
- *       如果没有找到，则调用buf_add_header()函数增加IP数据报头部(想一想，此处为什么要增加IP头部？？)
- *       然后调用icmp_unreachable()函数发送一个端口不可达的ICMP差错报文。
- * 
- *       如果能找到，则去掉UDP报头，调用处理函数（回调函数）来做相应处理。
- * 
- * @param buf 要处理的包
- * @param src_ip 源ip地址
- */
-void udp_in(buf_t *buf, uint8_t *src_ip)
-{
-    // TODO
-    uint16_t checksum_udp_head,checksum;
-    udp_hdr_t *udp_hdr;
-    int flag=0; // 标志位，标志能否在udp_table中找到目的端口号
-    // 检测报头长度
-    if(buf->len < UDP_HEAD_LEN){
-        return;
-    }
-    udp_hdr = (udp_hdr_t*) buf->data;
-    // 重新计算checksum
-    // 先将UDP首部的checksum缓存起来
-    checksum_udp_head = udp_hdr->checksum;
-    // 再将UDP首部的checksum字段清零
-    udp_hdr->checksum = 0;
-    // 调用udp_checksum函数计算UDP校验和
-    checksum = udp_checksum(buf, src_ip, net_if_ip);
-    // 比对两个校验和，若不相等，则不处理该数据
-    if(checksum_udp_head != checksum){
-        return;
-    }
-    udp_hdr->checksum = checksum;
-    // 根据UDP数据报中的目的端口号查找udp_table
-    // 查看是否有该目的端口号对应的处理函数
-    for(int i = 0; i < UDP_MAX_HANDLER; i++){
-        if(udp_table[i].port == swap16(udp_hdr->dest_port)){
-            flag = 1;
-            // 去掉UDP报头
-            buf_remove_header(buf, sizeof(udp_hdr_t));
-            // 回调函数
-            udp_table[i].handler(&udp_table[i], src_ip, udp_hdr->src_port, buf);
-            break;
-        }
-    }
-    if(flag == 0){ // 表示没找到
-        // 增加IPv4数据报头部
-        buf_add_header(buf, IP_HDR_LEN);
-        icmp_unreachable(buf, src_ip, ICMP_CODE_PORT_UNREACH);
-    }
-}
-
-/**
- * @brief 处理一个要发送的数据包
- *        你首先需要调用buf_add_header()函数增加UDP头部长度空间
- *        填充UDP首部字段
- *        调用udp_checksum()函数计算UDP校验和
- *        将封装的UDP数据报发送到IP层。    
- * 
- * @param buf 要处理的包
- * @param src_port 源端口号
- * @param dest_ip 目的ip地址
- * @param dest_port 目的端口号
- */
-void udp_out(buf_t *buf, uint16_t src_port, uint8_t *dest_ip, uint16_t dest_port)
-{
-    // TODO
-    udp_hdr_t *udp_hdr;
-    buf_add_header(buf, sizeof(udp_hdr_t)); // 增加UDP报头
-    // 填充UDP首部字段
-    udp_hdr = (udp_hdr_t*) buf->data;
-    udp_hdr->src_port = swap16(src_port);
-    udp_hdr->dest_port = swap16(dest_port);
-    udp_hdr->total_len = swap16(buf->len); // 长度为UDP头部和UDP数据报的总长度
-    udp_hdr->checksum = udp_checksum(buf, net_if_ip, dest_ip);
-    ip_out(buf, dest_ip, NET_PROTOCOL_UDP);
-}
-
-/**
- * @brief 初始化udp协议
- * 
- */
-void udp_init()
-{
-    for (int i = 0; i < UDP_MAX_HANDLER; i++)
-        udp_table[i].valid = 0;
-}
-
-/**
- * @brief 打开一个udp端口并注册处理程序
- * 
- * @param port 端口号
- * @param handler 处理程序
- * @return int 成功为0，失败为-1
- */
-int udp_open(uint16_t port, udp_handler_t handler)
-{
-    for (int i = 0; i < UDP_MAX_HANDLER; i++) //试图更新
-        if (udp_table[i].port == port)
-        {
-            udp_table[i].handler = handler;
-            udp_table[i].valid = 1;
-            return 0;
-        }
-
-    for (int i = 0; i < UDP_MAX_HANDLER; i++) //试图插入
-        if (udp_table[i].valid == 0)
-        {
-            udp_table[i].handler = handler;
-            udp_table[i].port = port;
-            udp_table[i].valid = 1;
-            return 0;
-        }
-    return -1;
-}
-
-/**
- * @brief 关闭一个udp端口
- * 
- * @param port 端口号
- */
-void udp_close(uint16_t port)
-{
-    for (int i = 0; i < UDP_MAX_HANDLER; i++)
-        if (udp_table[i].port == port)
-            udp_table[i].valid = 0;
-}
-
-/**
- * @brief 发送一个udp包
- * 
- * @param data 要发送的数据
- * @param len 数据长度
- * @param src_port 源端口号
- * @param dest_ip 目的ip地址
- * @param dest_port 目的端口号
- */
-void udp_send(uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dest_ip, uint16_t dest_port)
-{
-    buf_init(&txbuf, len);
-    memcpy(txbuf.data, data, len);
-    udp_out(&txbuf, src_port, dest_ip, dest_port);
-}
\ No newline at end of file
+#include "udp.h"
+#include "ip.h"
+#include "icmp.h"
+#include "ethernet.h"
+#include "arp.h"
+#include "route.h"
+#include "timer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#define UDP_HEAD_LEN 8
+
+/**
+ * @brief udp接收队列
+ *        协议栈线程是唯一的生产者，应用线程是唯一的消费者。
+ *        应用线程用完的buffer经归还队列交回协议栈线程释放，两个方向都是单生产者单消费者，不需要加锁。
+ *        按写入的线程把下标分在不同的缓存行上
+ * 
+ */
+typedef struct udp_ring
+{
+    uint32_t head __attribute__((aligned(64))); // 协议栈线程写入消息的位置
+    uint32_t free_tail;                         // 协议栈线程回收buffer的位置
+    uint32_t tail __attribute__((aligned(64))); // 应用线程读取消息的位置
+    uint32_t free_head;                         // 应用线程归还buffer的位置
+    uint32_t mask __attribute__((aligned(64))); // 队列长度 - 1
+    int efd;                                    // 队列由空变为非空时通知应用线程
+    udp_msg_t *msgs;                            // 消息队列
+    buf_t **freed;                              // 归还队列
+} udp_ring_t;
+
+/**
+ * @brief 早期分流的流缓存项
+ *        地址和端口按报文中的网络字节序原样保存，匹配时只需整数比较
+ * 
+ */
+typedef struct udp_flow
+{
+    uint32_t src_ip;    // 源ip地址
+    uint32_t dest_ip;   // 目的ip地址
+    uint32_t ports;     // 源端口和目的端口，即udp报头的前4字节
+    uint32_t gen;       // 缓存时处理程序表的版本号，与当前版本不同时失效
+} udp_flow_t;
+
+/**
+ * @brief udp层状态，每个协议栈实例一份
+ *        处理程序表按端口号直接索引，查找代价与打开的端口数无关，未打开的端口为NULL。
+ *        按(源ip, 目的ip, 源端口, 目的端口)直接映射的流缓存记住已正常处理过的流，
+ *        端口打开或关闭时整体失效。
+ *        其他线程投递的待发送数据报由投递的线程用CAS压入链表头，协议栈线程一次取走整个链表再逆序成投递顺序，
+ *        多个生产者之间、生产者与协议栈线程之间都不需要加锁。链表头单独占一个缓存行。
+ *        取走的数据报每次轮询最多发出给定的额度，其余按顺序留到下一次轮询
+ * 
+ */
+typedef struct udp_layer
+{
+    udp_entry_t *table[UINT16_MAX + 1];            // udp处理程序表
+    uint32_t gen;                                  // 处理程序表版本号
+    udp_flow_t flows[UDP_FLOW_CACHE_SIZE];         // 早期分流的流缓存
+    buf_t *tx_pending;                             // 已取走尚未发出的投递数据报，按投递顺序，只由协议栈线程访问
+    buf_t *tx_list __attribute__((aligned(64)));   // 其他线程投递的待发送数据报
+    int tx_efd;                                    // 链表由空变为非空时唤醒协议栈线程
+} udp_layer_t;
+
+typedef struct udp_tx_meta
+{
+    uint16_t src_port;           // 源端口号
+    uint16_t dest_port;          // 目的端口号
+    uint8_t dest_ip[NET_IP_LEN]; // 目的ip地址
+} udp_tx_meta_t; // 投递的发送参数，暂存在buffer头部预留空间的最前面，离协议头要写入的位置足够远
+
+/**
+ * @brief 累加UDP伪头部的反码和
+ * 
+ * @param src_ip 源ip地址
+ * @param dest_ip 目的ip地址
+ * @param len UDP头部和数据的总长度
+ * @return uint32_t 伪头部的累加和（未取反）
+ */
+static uint32_t udp_pseudo_sum(uint8_t *src_ip, uint8_t *dest_ip, uint16_t len)
+{
+    udp_peso_hdr_t peso_hdr;
+    memcpy(peso_hdr.src_ip, src_ip, NET_IP_LEN);
+    memcpy(peso_hdr.dest_ip, dest_ip, NET_IP_LEN);
+    peso_hdr.placeholder = 0;
+    peso_hdr.protocol = NET_PROTOCOL_UDP;
+    peso_hdr.total_len = swap16(len);
+    return checksum_add(&peso_hdr, sizeof(peso_hdr), 0);
+}
+
+/**
+ * @brief udp伪校验和计算
+ *        UDP校验和覆盖了UDP伪头部、UDP头部和UDP数据。
+ *        伪头部单独累加后接着累加UDP头部和数据，不需要把伪头部拼到数据前面
+ * 
+ * @param buf 要计算的包
+ * @param src_ip 源ip地址
+ * @param dest_ip 目的ip地址
+ * @return uint16_t 伪校验和
+ */
+static uint16_t udp_checksum(buf_t *buf, uint8_t *src_ip, uint8_t *dest_ip)
+{
+    uint32_t sum = udp_pseudo_sum(src_ip, dest_ip, buf->len);
+    return checksum_fold(checksum_add(buf->data, buf->len, sum));
+}
+
+/**
+ * @brief 释放应用线程已归还的buffer，在协议栈线程中调用
+ * 
+ * @param ring 接收队列
+ */
+static void udp_ring_reclaim(udp_ring_t *ring)
+{
+    uint32_t free_head = __atomic_load_n(&ring->free_head, __ATOMIC_ACQUIRE);
+    for (; ring->free_tail != free_head; ring->free_tail++)
+        buf_free(ring->freed[ring->free_tail & ring->mask]);
+}
+
+/**
+ * @brief 把收到的数据放入接收队列，在协议栈线程中调用
+ *        队列中与应用线程尚未归还的数据总数达到队列长度时丢弃，保证归还队列不会溢出
+ * 
+ * @param ring 接收队列
+ * @param buf 去掉udp报头的数据
+ * @param src_ip 源ip地址
+ * @param src_port 源端口号
+ */
+static void udp_ring_put(udp_ring_t *ring, buf_t *buf, uint8_t *src_ip, uint16_t src_port)
+{
+    udp_msg_t *msg;
+    udp_ring_reclaim(ring);
+    if (ring->head - ring->free_tail > ring->mask)
+        return;
+    if ((buf = buf_ref(buf)) == NULL)
+        return;
+    msg = &ring->msgs[ring->head & ring->mask];
+    msg->buf = buf;
+    memcpy(msg->src_ip, src_ip, NET_IP_LEN);
+    msg->src_port = src_port;
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+    // 与udp_recv_batch()中的屏障配对：要么这里看到消费者已取空队列，要么消费者看到新消息
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == ring->head - 1)
+        eventfd_write(ring->efd, 1);
+}
+
+/**
+ * @brief 释放接收队列，队列中尚未取出的数据一并释放
+ * 
+ * @param ring 接收队列
+ */
+static void udp_ring_free(udp_ring_t *ring)
+{
+    udp_ring_reclaim(ring);
+    for (uint32_t i = ring->tail; i != ring->head; i++)
+        buf_free(ring->msgs[i & ring->mask].buf);
+    close(ring->efd);
+    free(ring->msgs);
+    free(ring->freed);
+    free(ring);
+}
+
+/**
+ * @brief 计算流在流缓存中的位置
+ * 
+ * @param src_ip 源ip地址
+ * @param ports 源端口和目的端口
+ * @return uint32_t 缓存项下标
+ */
+static uint32_t udp_flow_hash(uint32_t src_ip, uint32_t ports)
+{
+    return ((src_ip ^ ports) * 0x9E3779B1u) >> 16 & (UDP_FLOW_CACHE_SIZE - 1);
+}
+
+/**
+ * @brief 把去掉udp报头的数据交给端口的处理程序或接收队列
+ * 
+ * @param entry 目的端口的处理程序表项
+ * @param buf 去掉udp报头的数据
+ * @param src_ip 源ip地址
+ * @param src_port 源端口号，网络字节序
+ */
+static void udp_deliver(udp_entry_t *entry, buf_t *buf, uint8_t *src_ip, uint16_t src_port)
+{
+    if(entry->ring != NULL){
+        // 放入接收队列，由应用线程处理
+        udp_ring_put(entry->ring, buf, src_ip, swap16(src_port));
+    }else{
+        // 回调函数
+        entry->handler(entry, src_ip, src_port, buf);
+    }
+}
+
+/**
+ * @brief 早期分流：按流缓存跳过ip层的逐项检查，直接得到udp数据报
+ *        只处理不带选项、未分片、长度一致的数据报，四元组命中流缓存后检查ip首部和udp校验和，
+ *        之后的udp_in()不再重复计算。命中的数据报与走正常路径的udp数据报按到达顺序一起交给udp_in_burst()，
+ *        同一个流中的数据报不会颠倒。
+ *        未命中或有任何异常都返回0，由ip_in()逐层处理，正常处理过的流在udp_in()中加入缓存
+ * 
+ * @param buf 去掉以太网包头的数据包，命中时去掉ip报头
+ * @param src_ip_out 命中时输出源ip地址
+ * @return int 命中为1，未命中为0，需按正常路径处理
+ */
+int udp_early_demux(buf_t *buf, uint8_t **src_ip_out)
+{
+    net_stack_t *s = net_stack;
+    ip_hdr_t *ip_hdr = (ip_hdr_t *)buf->data;
+    udp_hdr_t *udp_hdr = (udp_hdr_t *)(buf->data + IP_HDR_LEN);
+    udp_flow_t *flow;
+    uint32_t src_ip, dest_ip, ports;
+    int total_len;
+
+    if (buf->len < IP_HDR_LEN + UDP_HEAD_LEN || buf->data[0] != (IP_VERSION_4 << 4 | IP_HDR_LEN / IP_HDR_LEN_PER_BYTE) ||
+        ip_hdr->protocol != NET_PROTOCOL_UDP || (ip_hdr->flags_fragment & swap16(IP_MORE_FRAGMENT << 8 | 0x1fff)) != 0)
+        return 0;
+    memcpy(&src_ip, ip_hdr->src_ip, NET_IP_LEN);
+    memcpy(&dest_ip, ip_hdr->dest_ip, NET_IP_LEN);
+    memcpy(&ports, udp_hdr, sizeof(ports));
+    flow = &s->udp->flows[udp_flow_hash(src_ip, ports)];
+    if (flow->gen != s->udp->gen || flow->ports != ports || flow->src_ip != src_ip || flow->dest_ip != dest_ip)
+        return 0;
+    total_len = swap16(ip_hdr->total_len);
+    if (total_len > buf->len || swap16(udp_hdr->total_len) != total_len - IP_HDR_LEN)
+        return 0;
+    // 包含校验和字段一起累加，结果为0说明校验和正确；ip首部校验和总要检查，驱动只验证过udp校验和
+    if (!(buf->flags & BUF_FLAG_LOOPBACK) && checksum_data(ip_hdr, IP_HDR_LEN) != 0)
+        return 0;
+    if (!(buf->flags & (BUF_FLAG_CSUM_VALID | BUF_FLAG_LOOPBACK)) &&
+        checksum_fold(checksum_add(udp_hdr, total_len - IP_HDR_LEN, udp_pseudo_sum(ip_hdr->src_ip, ip_hdr->dest_ip, total_len - IP_HDR_LEN))) != 0)
+        return 0;
+    buf->len = total_len; // 去掉以太网最小帧长的填充
+    buf->flags |= BUF_FLAG_CSUM_VALID; // udp_in()不再验证
+    buf_remove_header(buf, IP_HDR_LEN);
+    *src_ip_out = ip_hdr->src_ip;
+    return 1;
+}
+
+/**
+ * @brief 处理一个收到的udp数据包
+ *        你首先需要检查UDP报头长度
+ *        接着计算checksum，步骤如下：
+ *          （1）先将UDP首部的checksum缓存起来
+ *          （2）再将UDP首都的checksum字段清零
+ *          （3）调用udp_checksum()计算UDP校验和
+ *          （4）比较计算后的校验和与之前缓存的checksum进行比较，如不相等，则不处理该数据报。
+ *       然后，以该数据报目的端口号为下标查找udp_table，查看是否有对应的处理函数（回调函数）
+ *       
+ *       如果没有找到，则调用buf_add_header()函数增加IP数据报头部(想一想，此处为什么要增加IP头部？？)
+ *       然后调用icmp_unreachable()函数发送一个端口不可达的ICMP差错报文。
+ * 
+ *       如果能找到，则去掉UDP报头，调用处理函数（回调函数）来做相应处理，并把这个流加入早期分流的流缓存。
+ * 
+ * @param buf 要处理的包
+ * @param src_ip 源ip地址
+ */
+void udp_in(buf_t *buf, uint8_t *src_ip)
+{
+    net_stack_t *s = net_stack;
+    // TODO
+    uint16_t checksum_udp_head,checksum;
+    udp_hdr_t *udp_hdr;
+    udp_entry_t *entry;
+    udp_flow_t *flow;
+    uint32_t key, ports;
+    // 检测报头长度
+    if(buf->len < UDP_HEAD_LEN){
+        return;
+    }
+    udp_hdr = (udp_hdr_t*) buf->data;
+    if(!(buf->flags & (BUF_FLAG_CSUM_VALID | BUF_FLAG_LOOPBACK))){ // 驱动已验证过校验和或环回的包不必再算
+        // 重新计算checksum
+        // 先将UDP首部的checksum缓存起来
+        checksum_udp_head = udp_hdr->checksum;
+        // 再将UDP首部的checksum字段清零
+        udp_hdr->checksum = 0;
+        // 调用udp_checksum函数计算UDP校验和
+        checksum = udp_checksum(buf, src_ip, net_if_ip);
+        // 比对两个校验和，若不相等，则不处理该数据
+        if(checksum_udp_head != checksum){
+            return;
+        }
+        udp_hdr->checksum = checksum;
+    }
+    // 根据UDP数据报中的目的端口号查找udp_table
+    // 查看是否有该目的端口号对应的处理函数
+    entry = s->udp->table[swap16(udp_hdr->dest_port)];
+    if(entry != NULL && entry->valid){
+        // 记住这个流，之后的数据报由udp_early_demux()跳过ip层的逐项检查
+        memcpy(&key, src_ip, NET_IP_LEN);
+        memcpy(&ports, udp_hdr, sizeof(ports));
+        flow = &s->udp->flows[udp_flow_hash(key, ports)];
+        flow->src_ip = key;
+        memcpy(&flow->dest_ip, net_if_ip, NET_IP_LEN);
+        flow->ports = ports;
+        flow->gen = s->udp->gen;
+        // 去掉UDP报头
+        buf_remove_header(buf, sizeof(udp_hdr_t));
+        udp_deliver(entry, buf, src_ip, udp_hdr->src_port);
+    }else{ // 表示没找到
+        // 增加IPv4数据报头部
+        buf_add_header(buf, IP_HDR_LEN);
+        icmp_unreachable(buf, src_ip, ICMP_CODE_PORT_UNREACH);
+    }
+}
+
+/**
+ * @brief 成批处理收到的udp数据包
+ *        逐个交给udp_in()，处理当前包时预取再下一个包的报头，以及下一个包在处理程序表中的位置
+ * 
+ * @param bufs 要处理的包
+ * @param src_ips 各包的源ip地址
+ * @param n 包数
+ */
+void udp_in_burst(buf_t **bufs, uint8_t **src_ips, int n)
+{
+    net_stack_t *s = net_stack;
+    for (int i = 0; i < n; i++)
+    {
+        if (i + 1 < n && bufs[i + 1]->len >= UDP_HEAD_LEN)
+            __builtin_prefetch(&s->udp->table[swap16(((udp_hdr_t *)bufs[i + 1]->data)->dest_port)]);
+        if (i + 2 < n)
+            __builtin_prefetch(bufs[i + 2]->data);
+        udp_in(bufs[i], src_ips[i]);
+    }
+}
+
+/**
+ * @brief 处理一个要发送的数据包
+ *        你首先需要调用buf_add_header()函数增加UDP头部长度空间
+ *        填充UDP首部字段
+ *        调用udp_checksum()函数计算UDP校验和
+ *        将封装的UDP数据报发送到IP层。    
+ * 
+ * @param buf 要处理的包
+ * @param src_port 源端口号
+ * @param dest_ip 目的ip地址
+ * @param dest_port 目的端口号
+ */
+void udp_out(buf_t *buf, uint16_t src_port, uint8_t *dest_ip, uint16_t dest_port)
+{
+    // TODO
+    udp_hdr_t *udp_hdr;
+    buf_add_header(buf, sizeof(udp_hdr_t)); // 增加UDP报头
+    // 填充UDP首部字段
+    udp_hdr = (udp_hdr_t*) buf->data;
+    udp_hdr->src_port = swap16(src_port);
+    udp_hdr->dest_port = swap16(dest_port);
+    udp_hdr->total_len = swap16(buf->len); // 长度为UDP头部和UDP数据报的总长度
+    if (ip_is_local(dest_ip)) // 环回不需要校验和，0表示未计算
+        udp_hdr->checksum = 0;
+    else
+    {
+#if DRIVER_TX_OFFLOAD
+        // 只填伪头部校验和，剩余部分与分片交给驱动
+        udp_hdr->checksum = udp_pseudo_sum(net_if_ip, dest_ip, buf->len);
+        buf->flags |= BUF_FLAG_CSUM_PARTIAL;
+#else
+        udp_hdr->checksum = 0; // 缓冲池中的buffer留有之前的数据，先清零再计算
+        udp_hdr->checksum = udp_checksum(buf, net_if_ip, dest_ip);
+        if (udp_hdr->checksum == 0) // 0表示不校验，按RFC 768发送全1
+            udp_hdr->checksum = 0xffff;
+#endif
+    }
+    ip_out(buf, dest_ip, NET_PROTOCOL_UDP);
+}
+
+/**
+ * @brief 初始化udp协议
+ *        同时创建投递发送的通知描述符
+ * 
+ * @return int 成功为0，失败为-1
+ */
+int udp_init()
+{
+    net_stack_t *s = net_stack;
+    if (s->udp == NULL)
+    {
+        if ((s->udp = aligned_alloc(64, sizeof(udp_layer_t))) == NULL)
+        {
+            fprintf(stderr, "Error in udp_init: out of memory\n");
+            return -1;
+        }
+        memset(s->udp, 0, sizeof(udp_layer_t));
+        s->udp->gen = 1;
+        s->udp->tx_efd = -1;
+    }
+    for (int i = 0; i <= UINT16_MAX; i++)
+        udp_close(i);
+    if (s->udp->tx_efd == -1 && (s->udp->tx_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+    {
+        fprintf(stderr, "Error in udp_init: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 查找或新建端口的处理程序表项
+ *        已有的表项原来以另一种方式打开时先关闭
+ * 
+ * @param port 端口号
+ * @param ring 是否以接收队列方式打开
+ * @return udp_entry_t* 表项，失败为NULL
+ */
+static udp_entry_t *udp_entry_get(uint16_t port, int ring)
+{
+    net_stack_t *s = net_stack;
+    udp_entry_t *entry = s->udp->table[port];
+    if (entry != NULL && (entry->ring != NULL) != ring)
+    {
+        udp_close(port);
+        entry = NULL;
+    }
+    if (entry == NULL)
+    {
+        if ((entry = calloc(1, sizeof(udp_entry_t))) == NULL)
+        {
+            fprintf(stderr, "Error in udp_open: out of memory\n");
+            return NULL;
+        }
+        entry->port = port;
+        s->udp->table[port] = entry;
+        s->udp->gen++;
+    }
+    return entry;
+}
+
+/**
+ * @brief 打开一个udp端口并注册处理程序
+ *        端口已打开时更新处理程序
+ * 
+ * @param port 端口号
+ * @param handler 处理程序
+ * @return int 成功为0，失败为-1
+ */
+int udp_open(uint16_t port, udp_handler_t handler)
+{
+    udp_entry_t *entry = udp_entry_get(port, 0);
+    if (entry == NULL)
+        return -1;
+    entry->handler = handler;
+    entry->valid = 1;
+    return 0;
+}
+
+/**
+ * @brief 关闭一个udp端口
+ * 
+ * @param port 端口号
+ */
+void udp_close(uint16_t port)
+{
+    net_stack_t *s = net_stack;
+    if (s->udp->table[port] == NULL)
+        return;
+    if (s->udp->table[port]->ring != NULL)
+        udp_ring_free(s->udp->table[port]->ring);
+    free(s->udp->table[port]);
+    s->udp->table[port] = NULL;
+    s->udp->gen++;
+}
+
+/**
+ * @brief 以接收队列方式打开一个udp端口
+ *        协议栈线程把收到的数据放入该端口的单生产者单消费者队列，不再内联调用处理程序，
+ *        由一个应用线程用udp_recv()/udp_recv_batch()取出。应在协议栈线程中调用
+ * 
+ * @param port 端口号
+ * @param size 队列长度，会向上取整为2的幂，不大于0时为UDP_RING_SIZE
+ * @return int 队列有数据时可读的eventfd，可用于epoll，失败为-1
+ */
+int udp_open_ring(uint16_t port, int size)
+{
+    udp_entry_t *entry;
+    udp_ring_t *ring;
+    uint32_t len = 1;
+    if (size <= 0)
+        size = UDP_RING_SIZE;
+    while (len < (uint32_t)size)
+        len <<= 1;
+    if ((entry = udp_entry_get(port, 1)) == NULL)
+        return -1;
+    if (entry->ring != NULL)
+        return entry->ring->efd;
+    ring = aligned_alloc(64, sizeof(udp_ring_t));
+    if (ring == NULL || (ring->msgs = malloc(len * sizeof(udp_msg_t))) == NULL)
+    {
+        fprintf(stderr, "Error in udp_open_ring: out of memory\n");
+        free(ring);
+        udp_close(port);
+        return -1;
+    }
+    ring->head = ring->tail = ring->free_head = ring->free_tail = 0;
+    ring->mask = len - 1;
+    ring->freed = malloc(len * sizeof(buf_t *));
+    ring->efd = eventfd(0, EFD_CLOEXEC);
+    if (ring->freed == NULL || ring->efd == -1)
+    {
+        fprintf(stderr, "Error in udp_open_ring: %s\n", ring->efd == -1 ? strerror(errno) : "out of memory");
+        if (ring->efd != -1)
+            close(ring->efd);
+        free(ring->freed);
+        free(ring->msgs);
+        free(ring);
+        udp_close(port);
+        return -1;
+    }
+    entry->ring = ring;
+    entry->valid = 1;
+    return ring->efd;
+}
+
+/**
+ * @brief 从以接收队列方式打开的端口批量取出数据，队列为空时阻塞等待
+ *        每个端口只能有一个应用线程接收
+ * 
+ * @param port 端口号
+ * @param msgs 取出的数据
+ * @param max 最多取出的个数
+ * @return int 取出的个数，失败为-1
+ */
+int udp_recv_batch(uint16_t port, udp_msg_t *msgs, int max)
+{
+    net_stack_t *s = net_stack;
+    udp_entry_t *entry = s->udp->table[port];
+    udp_ring_t *ring;
+    uint32_t head, tail;
+    eventfd_t cnt;
+    int n;
+    if (entry == NULL || entry->ring == NULL)
+        return -1;
+    ring = entry->ring;
+    tail = ring->tail;
+    for (;;)
+    {
+        // 与udp_ring_put()中的屏障配对，保证阻塞前协议栈线程能看到队列已空
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (head != tail)
+            break;
+        if (eventfd_read(ring->efd, &cnt) == -1 && errno != EINTR)
+        {
+            fprintf(stderr, "Error in udp_recv_batch: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+    n = head - tail < (uint32_t)max ? (int)(head - tail) : max;
+    for (int i = 0; i < n; i++)
+        msgs[i] = ring->msgs[(tail + i) & ring->mask];
+    __atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+/**
+ * @brief 从以接收队列方式打开的端口取出一个数据，队列为空时阻塞等待
+ * 
+ * @param port 端口号
+ * @param msg 取出的数据
+ * @return int 成功为0，失败为-1
+ */
+int udp_recv(uint16_t port, udp_msg_t *msg)
+{
+    return udp_recv_batch(port, msg, 1) == 1 ? 0 : -1;
+}
+
+/**
+ * @brief 归还udp_recv()取出的数据，由接收的应用线程调用
+ *        buffer交回协议栈线程释放，应用线程不直接操作缓冲池；端口未以接收队列方式打开时什么也不做
+ * 
+ * @param port 端口号
+ * @param buf 要归还的数据
+ */
+void udp_release(uint16_t port, buf_t *buf)
+{
+    net_stack_t *s = net_stack;
+    udp_ring_t *ring;
+    if (s->udp->table[port] == NULL || s->udp->table[port]->ring == NULL) // 端口已关闭或不是以接收队列方式打开
+        return;
+    ring = s->udp->table[port]->ring;
+    ring->freed[ring->free_head & ring->mask] = buf;
+    __atomic_store_n(&ring->free_head, ring->free_head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief 发送一个udp包
+ * 
+ * @param data 要发送的数据
+ * @param len 数据长度
+ * @param src_port 源端口号
+ * @param dest_ip 目的ip地址
+ * @param dest_port 目的端口号
+ */
+void udp_send(uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dest_ip, uint16_t dest_port)
+{
+    buf_t *txbuf = buf_alloc(len);
+    if (txbuf == NULL)
+        return;
+    memcpy(txbuf->data, data, len);
+    ethernet_batch_begin(); //分片后的数据帧一次交给驱动
+    udp_out(txbuf, src_port, dest_ip, dest_port);
+    ethernet_batch_end();
+    buf_free(txbuf);
+}
+
+/**
+ * @brief 重新查找连接的路由和下一跳的mac地址，重建报头模板
+ *        报头中只有ip总长度、标识、首部校验和以及udp长度、校验和随每个包变化，模板中填0，
+ *        其余字段的累加和预先算好
+ * 
+ * @param conn 连接
+ */
+static void udp_conn_refresh(udp_conn_t *conn)
+{
+    ether_hdr_t *ether_hdr = (ether_hdr_t *)conn->hdr;
+    ip_hdr_t *ip_hdr = (ip_hdr_t *)(ether_hdr + 1);
+    udp_hdr_t *udp_hdr = (udp_hdr_t *)(ip_hdr + 1);
+    const route_t *route;
+    uint8_t *mac;
+
+    conn->valid = 0;
+    conn->expires = timer_now() + UDP_CONN_REFRESH_MS;
+    if (ip_is_local(conn->dest_ip) || (route = route_lookup(conn->dest_ip)) == NULL ||
+        (mac = arp_lookup((uint8_t *)route_next_hop(route, conn->dest_ip))) == NULL)
+        return;
+    conn->mtu = route_mtu(route, conn->dest_ip);
+
+    memcpy(ether_hdr->dest, mac, NET_MAC_LEN);
+    memcpy(ether_hdr->src, net_if_mac, NET_MAC_LEN);
+    ether_hdr->protocol = swap16(NET_PROTOCOL_IP);
+
+    memset(ip_hdr, 0, sizeof(ip_hdr_t));
+    ip_hdr->version = IP_VERSION_4;
+    ip_hdr->hdr_len = sizeof(ip_hdr_t) / IP_HDR_LEN_PER_BYTE;
+    ip_hdr->ttl = IP_DEFALUT_TTL;
+    ip_hdr->protocol = NET_PROTOCOL_UDP;
+#if IP_PMTU_DISC
+    ip_hdr->flags_fragment = swap16(IP_DONT_FRAGMENT << 8); // 超过mtu的包不走模板，都不会再分片
+#endif
+    memcpy(ip_hdr->src_ip, net_if_ip, NET_IP_LEN);
+    memcpy(ip_hdr->dest_ip, conn->dest_ip, NET_IP_LEN);
+    conn->ip_sum = checksum_add(ip_hdr, sizeof(ip_hdr_t), 0);
+
+    udp_hdr->src_port = swap16(conn->src_port);
+    udp_hdr->dest_port = swap16(conn->dest_port);
+    udp_hdr->total_len = 0;
+    udp_hdr->checksum = 0;
+    conn->pseudo_sum = udp_pseudo_sum(net_if_ip, conn->dest_ip, 0);
+    conn->udp_sum = checksum_add(udp_hdr, sizeof(udp_hdr_t), conn->pseudo_sum);
+    conn->valid = 1;
+}
+
+/**
+ * @brief 连接到一个固定的对端，之后用udp_conn_send()发送
+ *        只记录参数，路由和mac地址在第一次发送时查找，应在协议栈线程中调用
+ * 
+ * @param src_port 源端口号
+ * @param dest_ip 目的ip地址
+ * @param dest_port 目的端口号
+ * @return udp_conn_t* 连接，失败为NULL
+ */
+udp_conn_t *udp_connect(uint16_t src_port, uint8_t *dest_ip, uint16_t dest_port)
+{
+    udp_conn_t *conn = calloc(1, sizeof(udp_conn_t));
+    if (conn == NULL)
+    {
+        fprintf(stderr, "Error in udp_connect: out of memory\n");
+        return NULL;
+    }
+    memcpy(conn->dest_ip, dest_ip, NET_IP_LEN);
+    conn->src_port = src_port;
+    conn->dest_port = dest_port;
+    return conn;
+}
+
+/**
+ * @brief 在已连接的udp流上发送一个udp包，在协议栈线程中调用
+ *        复制报头模板后只填写长度、标识和校验和，校验和在预先算好的累加和上加上长度、标识和数据；
+ *        驱动能补全校验和时只填伪头部校验和。
+ *        mac地址未解析、发往本机或超过MTU需要分片时按udp_send()的方式发送，
+ *        未解析的地址由此触发arp请求，缓存的mac地址每UDP_CONN_REFRESH_MS毫秒重新确认一次
+ * 
+ * @param conn 连接
+ * @param data 要发送的数据
+ * @param len 数据长度
+ * @return int 成功为0，失败为-1
+ */
+int udp_conn_send(udp_conn_t *conn, const uint8_t *data, uint16_t len)
+{
+    ip_hdr_t *ip_hdr;
+    udp_hdr_t *udp_hdr;
+    buf_t *txbuf;
+
+    if (!conn->valid || timer_now() >= conn->expires)
+        udp_conn_refresh(conn);
+    if (!conn->valid || sizeof(ip_hdr_t) + sizeof(udp_hdr_t) + len > conn->mtu)
+    {
+        udp_send((uint8_t *)data, len, conn->src_port, conn->dest_ip, conn->dest_port);
+        return 0;
+    }
+    if ((txbuf = buf_alloc(len)) == NULL)
+        return -1;
+    memcpy(txbuf->data, data, len);
+    buf_add_header(txbuf, sizeof(conn->hdr));
+    memcpy(txbuf->data, conn->hdr, sizeof(conn->hdr));
+    ip_hdr = (ip_hdr_t *)(txbuf->data + sizeof(ether_hdr_t));
+    udp_hdr = (udp_hdr_t *)(ip_hdr + 1);
+
+    // 总长度与标识相邻，一起累加
+    ip_hdr->total_len = swap16(sizeof(ip_hdr_t) + sizeof(udp_hdr_t) + len);
+    ip_hdr->id = swap16(ip_next_id());
+    ip_hdr->hdr_checksum = checksum_fold(checksum_add(&ip_hdr->total_len, 4, conn->ip_sum));
+
+    // udp长度在伪头部和报头中各出现一次
+    udp_hdr->total_len = swap16(sizeof(udp_hdr_t) + len);
+#if DRIVER_TX_OFFLOAD
+    udp_hdr->checksum = checksum_add(&udp_hdr->total_len, 2, conn->pseudo_sum);
+    txbuf->flags |= BUF_FLAG_CSUM_PARTIAL;
+#else
+    udp_hdr->checksum = checksum_fold(checksum_add(data, len, conn->udp_sum + 2u * udp_hdr->total_len));
+    if (udp_hdr->checksum == 0) // 0表示不校验，按RFC 768发送全1
+        udp_hdr->checksum = 0xffff;
+#endif
+    ethernet_xmit(txbuf);
+    buf_free(txbuf);
+    return 0;
+}
+
+/**
+ * @brief 释放连接
+ * 
+ * @param conn 连接，为NULL时什么也不做
+ */
+void udp_disconnect(udp_conn_t *conn)
+{
+    free(conn);
+}
+
+/**
+ * @brief 在协议栈线程以外的线程中发送一个udp包
+ *        数据复制到当前线程缓存的buffer中，投递给协议栈线程，由udp_tx_poll()发出，不加锁。
+ *        投递到当前线程绑定的协议栈实例
+ * 
+ * @param data 要发送的数据
+ * @param len 数据长度
+ * @param src_port 源端口号
+ * @param dest_ip 目的ip地址
+ * @param dest_port 目的端口号
+ * @return int 成功投递为0，线程缓存的buffer全部在途或失败为-1
+ */
+int udp_post(uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dest_ip, uint16_t dest_port)
+{
+    net_stack_t *s = net_stack;
+    udp_tx_meta_t *meta;
+    buf_t *txbuf = buf_thread_alloc(len), *head;
+    if (txbuf == NULL)
+        return -1;
+    memcpy(txbuf->data, data, len);
+    meta = (udp_tx_meta_t *)txbuf->payload;
+    meta->src_port = src_port;
+    meta->dest_port = dest_port;
+    memcpy(meta->dest_ip, dest_ip, NET_IP_LEN);
+    head = __atomic_load_n(&s->udp->tx_list, __ATOMIC_RELAXED);
+    do
+        txbuf->next = head;
+    while (!__atomic_compare_exchange_n(&s->udp->tx_list, &head, txbuf, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    if (head == NULL) // 协议栈线程可能在等待
+        eventfd_write(s->udp->tx_efd, 1);
+    return 0;
+}
+
+/**
+ * @brief 发出其他线程投递的udp包，在协议栈线程中调用
+ *        上一次没发完的先发，发完后才取走新投递的，保持投递顺序
+ * 
+ * @param budget 最多发出的数据包数
+ * @return int 发出的数据包数
+ */
+int udp_tx_poll(int budget)
+{
+    net_stack_t *s = net_stack;
+    buf_t *fifo = s->udp->tx_pending, *list, *next;
+    udp_tx_meta_t *meta;
+    int n = 0;
+    if (fifo == NULL)
+    {
+        list = __atomic_exchange_n(&s->udp->tx_list, NULL, __ATOMIC_ACQUIRE);
+        for (; list != NULL; list = next) // 链表头是最后投递的，逆序
+        {
+            next = list->next;
+            list->next = fifo;
+            fifo = list;
+        }
+    }
+    for (; fifo != NULL && n < budget; fifo = next, n++)
+    {
+        next = fifo->next;
+        fifo->next = NULL;
+        meta = (udp_tx_meta_t *)fifo->payload;
+        udp_out(fifo, meta->src_port, meta->dest_ip, meta->dest_port);
+        buf_free(fifo);
+    }
+    s->udp->tx_pending = fifo;
+    return n;
+}
+
+/**
+ * @brief 获取投递发送的通知描述符，有其他线程投递时可读
+ *        协议栈事件循环把它加入epoll，可读时先读出计数再调用udp_tx_poll()
+ * 
+ * @return int 描述符，未初始化时为-1
+ */
+int udp_get_tx_fd()
+{
+    net_stack_t *s = net_stack;
+    return s->udp->tx_efd;
+}
@@ -2,8 +2,88 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #define IPTOSBUFFERS 12
 
+/**
+ * @brief 清空直方图
+ * 
+ * @param hist 直方图
+ */
+void hist_init(hist_t *hist)
+{
+    memset(hist, 0, sizeof(hist_t));
+    hist->min = UINT64_MAX;
+}
+
+/**
+ * @brief 计算值所在的桶
+ * 
+ * @param value 值
+ * @return int 桶号
+ */
+static int hist_bucket(uint64_t value)
+{
+    int shift;
+    if (value < 2u << HIST_SUB_BITS)
+        return (int)value;
+    shift = 63 - __builtin_clzll(value) - HIST_SUB_BITS; // 保留最高的HIST_SUB_BITS+1位
+    return (shift << HIST_SUB_BITS) + (int)(value >> shift);
+}
+
+/**
+ * @brief 计算桶能容纳的最大值
+ * 
+ * @param bucket 桶号
+ * @return uint64_t 桶上界
+ */
+static uint64_t hist_bucket_max(int bucket)
+{
+    int shift;
+    if (bucket < 2 << HIST_SUB_BITS)
+        return bucket;
+    shift = (bucket >> HIST_SUB_BITS) - 1;
+    return ((uint64_t)((bucket & ((1 << HIST_SUB_BITS) - 1)) + (1 << HIST_SUB_BITS) + 1) << shift) - 1;
+}
+
+/**
+ * @brief 向直方图记录一个值
+ * 
+ * @param hist 直方图
+ * @param value 值
+ */
+void hist_record(hist_t *hist, uint64_t value)
+{
+    hist->buckets[hist_bucket(value)]++;
+    hist->count++;
+    hist->sum += value;
+    if (value < hist->min)
+        hist->min = value;
+    if (value > hist->max)
+        hist->max = value;
+}
+
+/**
+ * @brief 计算百分位数
+ * 
+ * @param hist 直方图
+ * @param percent 百分比，0到100
+ * @return uint64_t 不小于percent%记录值的最小桶上界，没有记录时为0
+ */
+uint64_t hist_percentile(const hist_t *hist, double percent)
+{
+    uint64_t target, seen = 0;
+    if (hist->count == 0)
+        return 0;
+    target = (uint64_t)(percent / 100 * hist->count + 0.5);
+    if (target == 0)
+        target = 1;
+    for (int i = 0; i < HIST_BUCKETS; i++)
+        if ((seen += hist->buckets[i]) >= target)
+            return hist_bucket_max(i) < hist->max ? hist_bucket_max(i) : hist->max;
+    return hist->max;
+}
+
 /**
  * @brief ip转字符串
  * 
@@ -12,23 +92,286 @@
  */
 char *iptos(uint8_t *ip)
 {
-    static char output[IPTOSBUFFERS][3 * 4 + 3 + 1];
-    static short which;
+    static __thread char output[IPTOSBUFFERS][3 * 4 + 3 + 1]; //每个线程一份，RSS工作线程可以同时调用
+    static __thread short which;
     which = (which + 1 == IPTOSBUFFERS ? 0 : which + 1);
     sprintf(output[which], "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
     return output[which];
 }
 
+static const int buf_class_len[BUF_CLASS_NR] = { //各大小类能装载的数据长度
+    [BUF_CLASS_MTU] = ETHERNET_MTU + 14,
+    [BUF_CLASS_JUMBO] = BUF_JUMBO_LEN,
+    [BUF_CLASS_MAX] = BUF_MAX_LEN,
+};
+static __thread buf_t *buf_free_list[BUF_CLASS_NR]; //各大小类的空闲链表，每个协议栈线程各有一份
+
+/**
+ * @brief 协议栈线程以外的线程的缓冲区缓存
+ *        线程从自己的空闲链表分配，协议栈线程用完后无锁地压入归还链表，
+ *        线程的空闲链表用完时一次取走整个归还链表，不需要加锁。
+ *        所属线程和每个在途的buffer各持有一个引用，线程退出后最后一个buffer归还时释放整个缓存
+ * 
+ */
+struct buf_cache
+{
+    buf_t *free_list[BUF_CLASS_NR]; //各大小类的空闲链表，只由所属线程使用
+    buf_t *returned[BUF_CLASS_NR];  //各大小类的归还链表
+    size_t size;                    //向系统申请的内存总量
+    uint8_t *slabs;                 //向系统申请的slab链表，释放缓存时一起归还
+    int ref;                        //引用计数
+};
+static __thread buf_cache_t *buf_thread_cache; //当前线程的缓存
+static pthread_key_t buf_cache_key;             //线程退出时通过它的析构函数释放缓存
+static pthread_once_t buf_cache_once = PTHREAD_ONCE_INIT;
+
+#define BUF_SLAB_HEAD 64 //线程缓存的slab前面留出的链表指针空间，不改变buffer的对齐
+
 /**
  * @brief 初始化buffer为给定的长度，用于装载数据包
+ *        数据前预留BUF_HEADROOM字节，供协议头的添加
  * 
  * @param buf 要初始化的buffer
  * @param len 长度
+ * @return int 成功为0，长度超过buffer容量为-1
  */
-void buf_init(buf_t *buf, int len)
+int buf_init(buf_t *buf, int len)
 {
+    if (buf->payload == NULL) // 未初始化的静态buffer，分配最大长度的存储
+    {
+        buf->payload = malloc(BUF_HEADROOM + BUF_MAX_LEN + 1);
+        if (buf->payload == NULL)
+            return -1;
+        buf->size = BUF_HEADROOM + BUF_MAX_LEN + 1;
+        buf->class = BUF_CLASS_STATIC;
+    }
+    if (len > buf_capacity(buf))
+        return -1;
+    if (buf->seg_owner != NULL) // 重新装载数据，放弃挂接的外部数据段
+    {
+        buf_free(buf->seg_owner);
+        buf->seg_owner = NULL;
+    }
+    buf->seg_len = 0;
     buf->len = len;
-    buf->data = buf->payload + BUF_MAX_LEN - len;
+    buf->flags = 0;
+    buf->data = buf->payload + BUF_HEADROOM;
+    return 0;
+}
+
+/**
+ * @brief 向系统申请一块slab，切分成BUF_SLAB_NR个buffer放入空闲链表
+ *        buffer头部与存储区连续存放
+ * 
+ * @param class 大小类
+ * @param free_list 要放入的空闲链表数组
+ * @param cache buffer所属的线程缓存，协议栈线程的缓冲池为NULL
+ * @return int 成功为0，失败为-1
+ */
+static int buf_pool_grow(int class, buf_t **free_list, buf_cache_t *cache)
+{
+    size_t obj_size = (sizeof(buf_t) + BUF_HEADROOM + buf_class_len[class] + 1 + 63) & ~(size_t)63;
+    if (cache != NULL && cache->size + obj_size * BUF_SLAB_NR > BUF_THREAD_CACHE_SIZE)
+        return -1; // 线程缓存已满，等协议栈线程归还
+    uint8_t *slab = malloc((cache != NULL ? BUF_SLAB_HEAD : 0) + obj_size * BUF_SLAB_NR);
+    if (slab == NULL)
+    {
+        fprintf(stderr, "Error in buf_pool_grow: out of memory\n");
+        return -1;
+    }
+    if (cache != NULL) // 记入缓存的slab链表，协议栈线程的缓冲池不释放
+    {
+        cache->size += obj_size * BUF_SLAB_NR;
+        *(uint8_t **)slab = cache->slabs;
+        cache->slabs = slab;
+        slab += BUF_SLAB_HEAD;
+    }
+    for (int i = 0; i < BUF_SLAB_NR; i++)
+    {
+        buf_t *buf = (buf_t *)(slab + obj_size * i);
+        buf->class = class;
+        buf->cache = cache;
+        buf->payload = (uint8_t *)(buf + 1);
+        buf->size = obj_size - sizeof(buf_t);
+        buf->seg_owner = NULL; // buf_init()会释放挂接的外部数据段，新切分的buffer必须清零
+        buf->seg_len = 0;
+        buf->next = free_list[class];
+        free_list[class] = buf;
+    }
+    return 0;
+}
+
+/**
+ * @brief 从缓冲池分配一个能装下len字节的buffer，引用计数为1
+ * 
+ * @param len 长度
+ * @return buf_t* 分配的buffer，失败为NULL
+ */
+buf_t *buf_alloc(int len)
+{
+    int class = BUF_CLASS_MTU;
+    buf_t *buf;
+    while (class < BUF_CLASS_NR && len > buf_class_len[class])
+        class++;
+    if (class == BUF_CLASS_NR)
+        return NULL;
+    if (buf_free_list[class] == NULL && buf_pool_grow(class, buf_free_list, NULL) != 0)
+        return NULL;
+    buf = buf_free_list[class];
+    buf_free_list[class] = buf->next;
+    buf->next = NULL;
+    buf->ref = 1;
+    buf_init(buf, len);
+    return buf;
+}
+
+/**
+ * @brief 增加一个buffer的引用，用于保留buffer而不复制
+ *        静态buffer或数据不在自身存储区中（如指向驱动的接收环）时无法保留，复制一份
+ * 
+ * @param buf 要保留的buffer
+ * @return buf_t* 保留的buffer，之后需要buf_free，失败为NULL
+ */
+buf_t *buf_ref(buf_t *buf)
+{
+    if (buf->class == BUF_CLASS_STATIC || buf->data < buf->payload || buf->data + buf->len > buf->payload + buf->size)
+        return buf_clone(buf);
+    buf->ref++;
+    return buf;
+}
+
+/**
+ * @brief 释放线程缓存的一个引用，减到0时把全部slab归还系统
+ * 
+ * @param cache 线程缓存
+ */
+static void buf_cache_put(buf_cache_t *cache)
+{
+    uint8_t *slab, *next;
+    if (__atomic_sub_fetch(&cache->ref, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+    for (slab = cache->slabs; slab != NULL; slab = next)
+    {
+        next = *(uint8_t **)slab;
+        free(slab);
+    }
+    free(cache);
+}
+
+/**
+ * @brief 线程退出时释放所属线程的引用，在途的buffer全部归还后缓存才真正释放
+ * 
+ * @param cache 线程缓存
+ */
+static void buf_cache_exit(void *cache)
+{
+    buf_thread_cache = NULL;
+    buf_cache_put(cache);
+}
+
+static void buf_cache_key_create()
+{
+    if (pthread_key_create(&buf_cache_key, buf_cache_exit) != 0)
+        fprintf(stderr, "Error in buf_thread_alloc: failed to create thread cache key\n");
+}
+
+/**
+ * @brief 创建当前线程的缓存，并登记线程退出时的释放
+ * 
+ * @return buf_cache_t* 线程缓存，失败为NULL
+ */
+static buf_cache_t *buf_cache_create()
+{
+    buf_cache_t *cache;
+    pthread_once(&buf_cache_once, buf_cache_key_create);
+    if ((cache = calloc(1, sizeof(buf_cache_t))) == NULL)
+        return NULL;
+    cache->ref = 1; // 所属线程的引用
+    if (pthread_setspecific(buf_cache_key, cache) != 0)
+    {
+        free(cache);
+        return NULL;
+    }
+    return buf_thread_cache = cache;
+}
+
+/**
+ * @brief 释放一个buffer的引用，引用计数为0时归还缓冲池
+ * 
+ * @param buf 要释放的buffer，为NULL或静态buffer时什么也不做
+ */
+void buf_free(buf_t *buf)
+{
+    if (buf == NULL || buf->class == BUF_CLASS_STATIC || --buf->ref > 0)
+        return;
+    if (buf->seg_owner != NULL)
+    {
+        buf_free(buf->seg_owner);
+        buf->seg_owner = NULL;
+        buf->seg_len = 0;
+    }
+    if (buf->cache != NULL) // 归还所属线程的缓存，可能与其他线程同时归还
+    {
+        buf_cache_t *cache = buf->cache;
+        buf_t **returned = &cache->returned[buf->class];
+        buf->next = __atomic_load_n(returned, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(returned, &buf->next, buf, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+        buf_cache_put(cache); // 所属线程已退出时，最后一个归还的buffer释放整个缓存
+        return;
+    }
+    buf->next = buf_free_list[buf->class];
+    buf_free_list[buf->class] = buf;
+}
+
+/**
+ * @brief 在协议栈线程以外的线程中分配buffer，引用计数为1
+ *        从当前线程的缓存分配，释放后回到该缓存，不与协议栈线程的缓冲池竞争。
+ *        缓存最多占用BUF_THREAD_CACHE_SIZE字节，全部在途时失败，调用者应稍后重试。
+ *        线程退出后，等在途的buffer全部释放再把缓存归还系统
+ * 
+ * @param len 长度
+ * @return buf_t* 分配的buffer，失败为NULL
+ */
+buf_t *buf_thread_alloc(int len)
+{
+    buf_cache_t *cache = buf_thread_cache;
+    int class = BUF_CLASS_MTU;
+    buf_t *buf;
+    while (class < BUF_CLASS_NR && len > buf_class_len[class])
+        class++;
+    if (class == BUF_CLASS_NR)
+        return NULL;
+    if (cache == NULL && (cache = buf_cache_create()) == NULL)
+        return NULL;
+    if (cache->free_list[class] == NULL) // 一次取走协议栈线程归还的全部buffer
+        cache->free_list[class] = __atomic_exchange_n(&cache->returned[class], NULL, __ATOMIC_ACQUIRE);
+    if (cache->free_list[class] == NULL && buf_pool_grow(class, cache->free_list, cache) != 0)
+        return NULL;
+    buf = cache->free_list[class];
+    cache->free_list[class] = buf->next;
+    __atomic_add_fetch(&cache->ref, 1, __ATOMIC_RELAXED); // 在途的buffer持有缓存的引用
+    buf->next = NULL;
+    buf->ref = 1;
+    buf_init(buf, len);
+    return buf;
+}
+
+/**
+ * @brief 从缓冲池分配一个新buffer并复制数据，外部数据段一并复制
+ * 
+ * @param src 源buffer
+ * @return buf_t* 新buffer，失败为NULL
+ */
+buf_t *buf_clone(buf_t *src)
+{
+    buf_t *buf = buf_alloc(buf_total_len(src));
+    if (buf == NULL)
+        return NULL;
+    memcpy(buf->data, src->data, src->len);
+    memcpy(buf->data + src->len, src->seg_data, src->seg_len);
+    buf->flags = src->flags & ~(BUF_FLAG_RX_FRAME | BUF_FLAG_QUEUED); // 只复制了数据，头部空间中没有以太网包头，也不在队列中
+    return buf;
 }
 
 /**
@@ -60,11 +403,53 @@ void buf_remove_header(buf_t *buf, int len)
  * 
  * @param dst 目的buffer
  * @param src 源buffer
+ * @return int 成功为0，目的buffer容量不足为-1
+ */
+int buf_copy(buf_t *dst, buf_t *src)
+{
+    if (buf_init(dst, buf_total_len(src)) != 0)
+        return -1;
+    dst->flags = src->flags & ~BUF_FLAG_RX_FRAME;
+    memcpy(dst->data, src->data, src->len);
+    memcpy(dst->data + src->len, src->seg_data, src->seg_len);
+    return 0;
+}
+
+/**
+ * @brief 为buffer挂接一段外部数据，发送时紧接在buffer自身的数据之后，不复制数据
+ *        外部数据所属的buffer增加一个引用，在buffer归还缓冲池时释放
+ * 
+ * @param buf 要挂接的buffer，必须来自缓冲池
+ * @param owner 外部数据所属的buffer，必须来自缓冲池
+ * @param data 外部数据起始地址
+ * @param len 外部数据长度
  */
-void buf_copy(buf_t *dst, buf_t *src)
+void buf_attach(buf_t *buf, buf_t *owner, uint8_t *data, int len)
 {
-    buf_init(dst, src->len);
-    memcpy(dst->payload, src->payload, BUF_MAX_LEN);
+    owner->ref++;
+    if (buf->seg_owner != NULL)
+        buf_free(buf->seg_owner);
+    buf->seg_owner = owner;
+    buf->seg_data = data;
+    buf->seg_len = len;
+}
+
+/**
+ * @brief 把buffer的数据段依次填入iovec数组，供驱动用writev/sendmsg发送
+ * 
+ * @param buf 要发送的buffer
+ * @param iov iovec数组，至少有2项
+ * @return int 填入的项数
+ */
+int buf_iovec(buf_t *buf, struct iovec *iov)
+{
+    iov[0].iov_base = buf->data;
+    iov[0].iov_len = buf->len;
+    if (buf->seg_len == 0)
+        return 1;
+    iov[1].iov_base = buf->seg_data;
+    iov[1].iov_len = buf->seg_len;
+    return 2;
 }
 
 /**
@@ -82,12 +467,204 @@ void buf_copy(buf_t *dst, buf_t *src)
  */
 uint16_t checksum16(uint16_t *buf, int len)
 {
-    // TODO
-    uint32_t checksum=0,temp;
-    for(int i = 0; i < len; i++){
-        checksum += buf[i];
+    return checksum_fold(checksum_add(buf, len * 2, 0));
+}
+
+/**
+ * @brief 把累加和折叠到16位
+ * 
+ * @param sum 累加和
+ * @return uint32_t 折叠后的累加和，不超过0xffff
+ */
+static uint32_t checksum_reduce(uint64_t sum)
+{
+    sum = (sum >> 32) + (sum & 0xffffffff);
+    sum = (sum >> 16) + (sum & 0xffff);
+    sum = (sum >> 16) + (sum & 0xffff);
+    sum = (sum >> 16) + (sum & 0xffff);
+    return (uint32_t)sum;
+}
+
+/**
+ * @brief 通用的累加实现，按本机字节序每次累加32位
+ *        反码和与字节序无关，按本机字节序累加后直接存回即为网络字节序的结果
+ * 
+ * @param data 数据
+ * @param len 数据长度，必须为4的整数倍
+ * @return uint64_t 累加和
+ */
+static uint64_t checksum_add_generic(const uint8_t *data, size_t len)
+{
+    uint64_t sum = 0;
+    uint32_t word;
+    for (size_t i = 0; i < len; i += 4)
+    {
+        memcpy(&word, data + i, 4); // 不要求对齐
+        sum += word;
     }
-    checksum = (checksum >> 16) + (checksum & 0xffff); // 第一次将高16位加到低16位
-    checksum += (checksum >> 16) & 0xffff;// 上面那次加法若有进位，再次加到低16位
-    return (uint16_t)(~checksum); // 将上述的和取反，即得到校验和
-}
\ No newline at end of file
+    return sum;
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define CHECKSUM_SIMD_CHUNK 65536 //每个32位通道最多累加的次数，超过后可能溢出
+
+/**
+ * @brief SSE2实现，每次处理16字节，把16位字零扩展到32位通道累加
+ * 
+ * @param data 数据
+ * @param len 数据长度，必须为16的整数倍
+ * @return uint64_t 累加和
+ */
+__attribute__((target("sse2"))) static uint64_t checksum_add_sse2(const uint8_t *data, size_t len)
+{
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t sum = 0;
+    uint32_t lanes[4];
+    while (len > 0)
+    {
+        size_t n = len < CHECKSUM_SIMD_CHUNK * 16 ? len : CHECKSUM_SIMD_CHUNK * 16;
+        __m128i acc_lo = zero, acc_hi = zero;
+        for (size_t i = 0; i < n; i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+            acc_lo = _mm_add_epi32(acc_lo, _mm_unpacklo_epi16(v, zero));
+            acc_hi = _mm_add_epi32(acc_hi, _mm_unpackhi_epi16(v, zero));
+        }
+        _mm_storeu_si128((__m128i *)lanes, acc_lo);
+        sum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        _mm_storeu_si128((__m128i *)lanes, acc_hi);
+        sum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        data += n;
+        len -= n;
+    }
+    return sum;
+}
+
+/**
+ * @brief AVX2实现，每次处理32字节
+ * 
+ * @param data 数据
+ * @param len 数据长度，必须为32的整数倍
+ * @return uint64_t 累加和
+ */
+__attribute__((target("avx2"))) static uint64_t checksum_add_avx2(const uint8_t *data, size_t len)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t sum = 0;
+    uint32_t lanes[8];
+    while (len > 0)
+    {
+        size_t n = len < CHECKSUM_SIMD_CHUNK * 32 ? len : CHECKSUM_SIMD_CHUNK * 32;
+        __m256i acc_lo = zero, acc_hi = zero;
+        for (size_t i = 0; i < n; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+            acc_lo = _mm256_add_epi32(acc_lo, _mm256_unpacklo_epi16(v, zero));
+            acc_hi = _mm256_add_epi32(acc_hi, _mm256_unpackhi_epi16(v, zero));
+        }
+        _mm256_storeu_si256((__m256i *)lanes, acc_lo);
+        for (int i = 0; i < 8; i++)
+            sum += lanes[i];
+        _mm256_storeu_si256((__m256i *)lanes, acc_hi);
+        for (int i = 0; i < 8; i++)
+            sum += lanes[i];
+        data += n;
+        len -= n;
+    }
+    return sum;
+}
+#endif
+
+/**
+ * @brief 累加一段数据的16位反码和，不取反
+ *        直接在字节流上计算，不要求对齐，长度可以为奇数；
+ *        分多段累加时，除最后一段外每段长度都应为偶数。
+ *        x86上运行时检测CPU，选用AVX2或SSE2实现
+ * 
+ * @param data 数据
+ * @param len 数据长度(字节)
+ * @param sum 之前的累加结果，第一段为0
+ * @return uint32_t 累加结果，不超过0xffff
+ */
+uint32_t checksum_add(const void *data, int len, uint32_t sum)
+{
+    const uint8_t *p = data;
+    uint64_t total = sum;
+    size_t n = len > 0 ? len : 0, done = 0;
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    static int simd_detected = -1; // 0:通用实现，1:SSE2，2:AVX2，多个协议栈线程可能同时检测，结果相同
+    int simd = __atomic_load_n(&simd_detected, __ATOMIC_RELAXED);
+    if (simd < 0)
+    {
+        __builtin_cpu_init();
+        simd = __builtin_cpu_supports("avx2") ? 2 : __builtin_cpu_supports("sse2") ? 1 : 0;
+        __atomic_store_n(&simd_detected, simd, __ATOMIC_RELAXED);
+    }
+    if (simd == 2 && n >= 64)
+    {
+        done = n & ~(size_t)31;
+        total += checksum_add_avx2(p, done);
+    }
+    else if (simd >= 1 && n >= 32)
+    {
+        done = n & ~(size_t)15;
+        total += checksum_add_sse2(p, done);
+    }
+#endif
+    total += checksum_add_generic(p + done, (n - done) & ~(size_t)3);
+    done += (n - done) & ~(size_t)3;
+    if (n - done >= 2) // 剩余的16位
+    {
+        uint16_t word;
+        memcpy(&word, p + done, 2);
+        total += word;
+        done += 2;
+    }
+    if (n - done == 1) // 奇数长度，最后一个字节后补0
+    {
+        uint16_t word = 0;
+        memcpy(&word, p + done, 1);
+        total += word;
+    }
+    return checksum_reduce(total);
+}
+
+/**
+ * @brief 把累加结果取反得到校验和
+ * 
+ * @param sum checksum_add()的累加结果
+ * @return uint16_t 校验和
+ */
+uint16_t checksum_fold(uint32_t sum)
+{
+    return (uint16_t)~checksum_reduce(sum);
+}
+
+/**
+ * @brief 计算一段数据的校验和
+ * 
+ * @param data 数据
+ * @param len 数据长度(字节)
+ * @return uint16_t 校验和
+ */
+uint16_t checksum_data(const void *data, int len)
+{
+    return checksum_fold(checksum_add(data, len, 0));
+}
+
+/**
+ * @brief 一个16位字段改变后增量更新校验和(RFC 1624)
+ *        HC' = ~(~HC + ~m + m')，不需要重新累加整段数据；
+ *        校验和与字段都按内存中的字节序传入即可
+ * 
+ * @param checksum 原校验和
+ * @param old_val 字段原来的值
+ * @param new_val 字段新的值
+ * @return uint16_t 新校验和
+ */
+uint16_t checksum_update(uint16_t checksum, uint16_t old_val, uint16_t new_val)
+{
+    return checksum_fold((uint16_t)~checksum + (uint16_t)~old_val + new_val);
+}
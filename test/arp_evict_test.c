@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <string.h>
+#include "driver.h"
+#include "ethernet.h"
+#include "arp.h"
+#include "timer.h"
+
+extern FILE *pcap_in;
+extern FILE *pcap_out;
+extern FILE *pcap_demo;
+extern FILE *ip_fout;
+extern FILE *control_flow;
+extern FILE *demo_log;
+extern FILE *out_log;
+extern FILE *arp_log_f;
+extern uint64_t fake_clock_ms;
+
+int check_log();
+int check_pcap();
+void log_tab_buf();
+
+#define TABLE_SIZE 100   // arp表容量
+#define ADDR_NR 400      // 依次加入的地址数，是容量的4倍
+#define HOT_FIRST 50     // 一直被访问的地址从这里开始，第一次淘汰时所有表项都刚被访问过，会淘汰最前面的表项
+#define HOT_NR 10        // 一直被访问的地址数，不应被淘汰
+#define PENDING_NR 150   // 未解析的地址数，超过容量
+#define BURST_NR (ARP_PENDING_MAX + 6) // 发往同一个未解析地址的包数，超过等待队列上限
+
+static uint8_t *test_ip(int i)
+{
+        static uint8_t ip[NET_IP_LEN];
+        ip[0] = 10;
+        ip[1] = 0;
+        ip[2] = i >> 8;
+        ip[3] = i & 0xff;
+        return ip;
+}
+
+static uint8_t *test_mac(int i)
+{
+        static uint8_t mac[NET_MAC_LEN];
+        mac[0] = 0x02;
+        mac[1] = mac[2] = mac[3] = 0;
+        mac[4] = i >> 8;
+        mac[5] = i & 0xff;
+        return mac;
+}
+
+/**
+ * @brief 检查arp表与哈希索引是否一致，结果写入日志
+ *        有效表项都能通过arp_lookup找到自己的mac地址，表中没有重复的ip地址
+ *
+ */
+static void check_table()
+{
+        int nr[ARP_INVALID + 1] = {0};
+        int duplicate = 0, mismatch = 0;
+        for(int i = 0; i < net_stack->arp->table_size; i++){
+                arp_entry_t *entry = &net_stack->arp->table[i];
+                nr[entry->state]++;
+                if(entry->state == ARP_INVALID)
+                        continue;
+                for(int j = i + 1; j < net_stack->arp->table_size; j++)
+                        if(net_stack->arp->table[j].state != ARP_INVALID && memcmp(net_stack->arp->table[j].ip, entry->ip, NET_IP_LEN) == 0)
+                                duplicate++;
+                if(entry->state == ARP_VALID && arp_lookup(entry->ip) != entry->mac)
+                        mismatch++;
+        }
+        fprintf(control_flow,"table:\tvalid:%d\tpending:%d\tinvalid:%d\tduplicate:%d\tmismatch:%d\n",
+                nr[ARP_VALID],nr[ARP_PENDING],nr[ARP_INVALID],duplicate,mismatch);
+}
+
+/**
+ * @brief 统计仍被arp表持有的数据包
+ *
+ * @param bufs 数据包
+ * @param n 包数
+ * @return int 引用计数大于1的包数
+ */
+static int held(buf_t **bufs, int n)
+{
+        int count = 0;
+        for(int i = 0; i < n; i++)
+                count += bufs[i]->ref > 1;
+        return count;
+}
+
+buf_t *bufs[PENDING_NR];
+buf_t *burst[BURST_NR];
+
+/**
+ * @brief 向超过容量的未解析地址发送数据包，再向同一个地址发送超过等待队列上限的数据包并解析它
+ *
+ */
+static void pending_test()
+{
+        int pending = 0, queued = 0;
+        for(int i = 0; i < PENDING_NR; i++){
+                bufs[i] = buf_alloc(8);
+                memset(bufs[i]->data, i, 8);
+                arp_out(bufs[i], test_ip(1000 + i), NET_PROTOCOL_IP);
+        }
+        fprintf(control_flow,"pending:\theld:%d\tdropped:%d\n",held(bufs,PENDING_NR),PENDING_NR - held(bufs,PENDING_NR));
+        check_table();
+
+        fprintf(control_flow,"\nRound 03 -----------------------------\n");
+        for(int i = 0; i < BURST_NR; i++){
+                burst[i] = buf_alloc(8);
+                memset(burst[i]->data, 0xb0 + i % 16, 8);
+                arp_out(burst[i], test_ip(2000), NET_PROTOCOL_IP);
+        }
+        for(int i = 0; i < net_stack->arp->table_size; i++){
+                if(memcmp(net_stack->arp->table[i].ip, test_ip(2000), NET_IP_LEN) == 0){
+                        pending = net_stack->arp->table[i].state == ARP_PENDING;
+                        queued = net_stack->arp->table[i].pending_nr;
+                }
+        }
+        fprintf(control_flow,"burst:\tpending:%d\tqueued:%d\theld:%d\n",pending,queued,held(burst,BURST_NR));
+        arp_update(test_ip(2000), test_mac(2000), ARP_VALID);
+        fprintf(control_flow,"resolved:\tlookup:%s\theld:%d\n",arp_lookup(test_ip(2000)) ? "ok" : "null",held(burst,BURST_NR));
+        check_table();
+}
+
+int main(){
+        int hot = 0, recent = 0, stale = 0, lost = 0;
+        printf("\e[0;34mTest begin.\n");
+        pcap_in = fopen("data/arp_evict_test/in.pcap","r");
+        pcap_out = fopen("data/arp_evict_test/out.pcap","w");
+        control_flow = fopen("data/arp_evict_test/log","w");
+        if(pcap_in == 0 || pcap_out == 0 || control_flow == 0){
+                if(pcap_in) fclose(pcap_in); else printf("\e[1;31mFailed to open in.pcap\n");
+                if(pcap_out)fclose(pcap_out); else printf("\e[1;31mFailed to open out.pcap\n");
+                if(control_flow) fclose(control_flow); else printf("\e[1;31mFailed to open log\n");
+                return 0;
+        }
+        arp_log_f = control_flow;
+        ip_fout = control_flow;
+
+        printf("\e[0;34mTest start\n");
+        if(ethernet_init()){
+                fprintf(stderr,"\e[1;31mDriver open failed,exiting\n");
+                fclose(pcap_in);
+                fclose(pcap_out);
+                fclose(control_flow);
+                return 0;
+        }
+        arp_init();
+        arp_table_init(TABLE_SIZE);
+
+        // 400个地址依次加入100个表项，其中10个地址加入后每次都被访问
+        fprintf(control_flow,"\nRound 01 -----------------------------\n");
+        for(int i = 0; i < ADDR_NR; i++){
+                arp_update(test_ip(i), test_mac(i), ARP_VALID);
+                uint8_t *mac = arp_lookup(test_ip(i));
+                if(mac == NULL || memcmp(mac, test_mac(i), NET_MAC_LEN))
+                        lost++;
+                for(int j = HOT_FIRST; j < HOT_FIRST + HOT_NR && j <= i; j++)
+                        arp_lookup(test_ip(j));
+        }
+        for(int i = 0; i < ADDR_NR; i++){
+                if(arp_lookup(test_ip(i)) == NULL)
+                        continue;
+                if(i >= HOT_FIRST && i < HOT_FIRST + HOT_NR)
+                        hot++;
+                else if(i >= ADDR_NR - (TABLE_SIZE - HOT_NR))
+                        recent++;
+                else
+                        stale++;
+        }
+        fprintf(control_flow,"evict:\tlost:%d\thot:%d\trecent:%d\tstale:%d\n",lost,hot,recent,stale);
+        check_table();
+        log_tab_buf();
+
+        // 未解析的地址超过容量时，被淘汰的表项的等待队列一并释放
+        fprintf(control_flow,"\nRound 02 -----------------------------\n");
+        arp_table_init(TABLE_SIZE);
+        pending_test();
+
+        // 按加倍的间隔重传arp请求，重传ARP_MAX_RETRY次后删除表项并释放等待的包
+        for(int i = 0, ms = 0; i <= ARP_MAX_RETRY; i++){
+                ms += ARP_MIN_INTERVAL * 1000 << i;
+                fake_clock_ms = ms;
+                timer_poll();
+                fprintf(control_flow,"\nRound %02d -----------------------------\n",i + 4);
+                fprintf(control_flow,"retry:\ttime:%d\theld:%d\n",ms,held(bufs,PENDING_NR));
+                check_table();
+        }
+        log_tab_buf();
+        for(int i = 0; i < PENDING_NR; i++)
+                buf_free(bufs[i]);
+        for(int i = 0; i < BURST_NR; i++)
+                buf_free(burst[i]);
+        driver_close();
+        printf("\e[0;34m\nSample input all processed, checking output\n");
+
+        fclose(control_flow);
+
+        demo_log = fopen("data/arp_evict_test/demo_log","r");
+        out_log = fopen("data/arp_evict_test/log","r");
+        pcap_out = fopen("data/arp_evict_test/out.pcap","r");
+        pcap_demo = fopen("data/arp_evict_test/demo_out.pcap","r");
+        if(demo_log == 0 || out_log == 0 || pcap_out == 0 || pcap_demo == 0){
+                if(demo_log) fclose(demo_log); else printf("\e[1;31mFailed to open demo_log\n");
+                if(out_log) fclose(out_log); else printf("\e[1;31mFailed to open log\n");
+                if(pcap_demo) fclose(pcap_demo); else printf("\e[1;31mFailed to open demo_out.pcap\n");
+                if(pcap_out) fclose(pcap_out); else printf("\e[1;31mFailed to open out.pcap\n");
+                return 0;
+        }
+        check_log();
+        check_pcap();
+        fclose(demo_log);
+        fclose(out_log);
+        return 0;
+}
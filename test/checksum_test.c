@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+extern FILE *control_flow;
+extern FILE *demo_log;
+extern FILE *out_log;
+
+int check_log();
+
+#define DATA_LEN 4096              // 随机数据的长度
+#define OFFSET_MAX 64              // 起始位置覆盖各种对齐
+#define SCAN_LEN 300               // 逐个检查的长度，覆盖16、32、64字节附近的分界
+#define RANDOM_NR 20000            // 随机起始位置和长度的次数
+#define LARGE_LEN (3 << 20 | 1)    // 超过SIMD每个通道一次最多累加的长度
+
+/**
+ * @brief 按RFC 1071逐字节计算的参考实现
+ *
+ * @param data 数据
+ * @param len 数据长度(字节)
+ * @return uint16_t 校验和，高字节在前
+ */
+static uint16_t checksum_ref(const uint8_t *data, size_t len)
+{
+        uint64_t sum = 0;
+        for(size_t i = 0; i < len; i += 2)
+                sum += (uint32_t)data[i] << 8 | (i + 1 < len ? data[i + 1] : 0);
+        while(sum >> 16)
+                sum = (sum & 0xffff) + (sum >> 16);
+        return ~sum;
+}
+
+/**
+ * @brief 校验和写入内存后与参考实现的字节比较
+ *
+ */
+static int checksum_same(uint16_t checksum, uint16_t ref)
+{
+        uint8_t bytes[2] = {ref >> 8, ref & 0xff};
+        return memcmp(&checksum, bytes, 2) == 0;
+}
+
+static uint8_t data[DATA_LEN + OFFSET_MAX];
+
+int main(){
+        int cases, wrong;
+        printf("\e[0;34mTest begin.\n");
+        control_flow = fopen("data/checksum_test/log","w");
+        if(control_flow == 0){
+                printf("\e[1;31mFailed to open log\n");
+                return 0;
+        }
+        srand(1);
+        for(size_t i = 0; i < sizeof(data); i++)
+                data[i] = rand();
+
+        // 每个起始位置上逐个长度，包括奇数长度
+        fprintf(control_flow,"\nRound 01 -----------------------------\n");
+        for(int len = 0; len <= SCAN_LEN; len++){
+                wrong = 0;
+                for(int off = 0; off < OFFSET_MAX; off++)
+                        wrong += !checksum_same(checksum_data(data + off, len), checksum_ref(data + off, len));
+                if(wrong || len % 16 <= 1 || len % 16 == 15)
+                        fprintf(control_flow,"len:\t%d\toffsets:%d\twrong:%d\n",len,OFFSET_MAX,wrong);
+        }
+
+        // 随机的起始位置和长度
+        fprintf(control_flow,"\nRound 02 -----------------------------\n");
+        cases = wrong = 0;
+        for(int i = 0; i < RANDOM_NR; i++){
+                int off = rand() % OFFSET_MAX;
+                int len = rand() % (DATA_LEN + 1);
+                wrong += !checksum_same(checksum_data(data + off, len), checksum_ref(data + off, len));
+                cases++;
+        }
+        fprintf(control_flow,"random:\tcases:%d\twrong:%d\n",cases,wrong);
+
+        // 分段累加，除最后一段外每段长度为偶数
+        fprintf(control_flow,"\nRound 03 -----------------------------\n");
+        cases = wrong = 0;
+        for(int i = 0; i < RANDOM_NR; i++){
+                int off = rand() % OFFSET_MAX;
+                int len = rand() % (DATA_LEN + 1);
+                int done = 0;
+                uint32_t sum = 0;
+                while(done < len){
+                        int seg = (rand() % 200) & ~1;
+                        if(seg > len - done || seg == 0)
+                                seg = len - done;
+                        sum = checksum_add(data + off + done, seg, sum);
+                        done += seg;
+                }
+                wrong += !checksum_same(checksum_fold(sum), checksum_ref(data + off, len));
+                cases++;
+        }
+        fprintf(control_flow,"segments:\tcases:%d\twrong:%d\n",cases,wrong);
+
+        // 全为0xff的长数据，检查通道累加不溢出
+        fprintf(control_flow,"\nRound 04 -----------------------------\n");
+        uint8_t *large = malloc(LARGE_LEN + 1);
+        if(large == NULL){
+                fprintf(control_flow,"out of memory\n");
+        }else{
+                memset(large, 0xff, LARGE_LEN + 1);
+                fprintf(control_flow,"large:\tlen:%d\t%s\n",LARGE_LEN,
+                        checksum_same(checksum_data(large, LARGE_LEN), checksum_ref(large, LARGE_LEN)) ? "ok" : "WRONG");
+                fprintf(control_flow,"large:\tlen:%d\t%s\n",LARGE_LEN - 1,
+                        checksum_same(checksum_data(large + 1, LARGE_LEN - 1), checksum_ref(large + 1, LARGE_LEN - 1)) ? "ok" : "WRONG");
+                free(large);
+        }
+
+        printf("\e[0;34mChecksums all computed, checking output\n");
+        fclose(control_flow);
+
+        demo_log = fopen("data/checksum_test/demo_log","r");
+        out_log = fopen("data/checksum_test/log","r");
+        if(demo_log == 0 || out_log == 0){
+                if(demo_log) fclose(demo_log); else printf("\e[1;31mFailed to open demo_log\n");
+                if(out_log) fclose(out_log); else printf("\e[1;31mFailed to open log\n");
+                return 0;
+        }
+        check_log();
+        fclose(demo_log);
+        fclose(out_log);
+        return 0;
+}
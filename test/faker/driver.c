@@ -1,63 +1,92 @@
-#include <pcap.h>
-#include <string.h>
-#include <utils.h>
-#include "config.h"
-static pcap_t *pcap;
-static pcap_dumper_t *pdump;
-static char pcap_errbuf[PCAP_ERRBUF_SIZE];
-extern FILE* pcap_in;
-extern FILE* pcap_out;
-extern FILE *control_flow;
-
-int driver_open()
-{
-        pcap = pcap_fopen_offline(pcap_in,pcap_errbuf);
-        if(pcap == NULL){
-                fprintf(stderr,"pcap_open_offline() failed:%s\n",pcap_errbuf);
-                return -1;
-        }
-
-        pdump = pcap_dump_fopen(pcap,pcap_out);
-        if(pdump == NULL){
-                fprintf(stderr,"pcap_dump_fopen() failed:%s\n", pcap_geterr(pcap));
-                return -1;
-        }
-
-        fprintf(control_flow,"driver opened\n");
-        return 0;
-}
-
-int driver_recv(buf_t *buf)
-{
-        struct pcap_pkthdr *pkt_hdr;
-        const uint8_t *pkt_data;
-        int ret = pcap_next_ex(pcap, &pkt_hdr, &pkt_data);
-        if (ret == PCAP_ERROR_BREAK){
-                // printf("meet end of file\n");
-                return 0;
-        }else if (ret == 1){
-                buf_init(buf,pkt_hdr->len);
-                memcpy(buf->data, pkt_data, pkt_hdr->len);
-                return pkt_hdr->len;
-        }else{
-                fprintf(stderr, "Error in driver_recv: %s\n", pcap_geterr(pcap));
-                return -1;
-        }
-}
-
-int driver_send(buf_t *buf)
-{
-        struct pcap_pkthdr header;
-        memset(&header.ts,0,sizeof(header.ts));
-        header.caplen = buf->len;
-        header.len = buf->len;
-        pcap_dump((u_char *)pdump,&header,buf->data);
-        return 0;
-}
-
-void driver_close()
-{
-        fprintf(control_flow,"\ndriver closed\n");
-        pcap_dump_close(pdump);
-        pcap_close(pcap);
-}
+#include <pcap.h>
+#include <string.h>
+#include <utils.h>
+#include "config.h"
+static pcap_t *pcap;
+static pcap_dumper_t *pdump;
+static char pcap_errbuf[PCAP_ERRBUF_SIZE];
+extern FILE* pcap_in;
+extern FILE* pcap_out;
+extern FILE *control_flow;
+
+int driver_open()
+{
+        pcap = pcap_fopen_offline(pcap_in,pcap_errbuf);
+        if(pcap == NULL){
+                fprintf(stderr,"pcap_open_offline() failed:%s\n",pcap_errbuf);
+                return -1;
+        }
+
+        pdump = pcap_dump_fopen(pcap,pcap_out);
+        if(pdump == NULL){
+                fprintf(stderr,"pcap_dump_fopen() failed:%s\n", pcap_geterr(pcap));
+                return -1;
+        }
+
+        fprintf(control_flow,"driver opened\n");
+        return 0;
+}
+
+int driver_recv(buf_t *buf)
+{
+        struct pcap_pkthdr *pkt_hdr;
+        const uint8_t *pkt_data;
+        int ret = pcap_next_ex(pcap, &pkt_hdr, &pkt_data);
+        if (ret == PCAP_ERROR_BREAK){
+                // printf("meet end of file\n");
+                return 0;
+        }else if (ret == 1){
+                buf_init(buf,pkt_hdr->len);
+                memcpy(buf->data, pkt_data, pkt_hdr->len);
+                return pkt_hdr->len;
+        }else{
+                fprintf(stderr, "Error in driver_recv: %s\n", pcap_geterr(pcap));
+                return -1;
+        }
+}
+
+int driver_send(buf_t *buf)
+{
+        static uint8_t frame[BUF_MAX_LEN];
+        struct pcap_pkthdr header;
+        memset(&header.ts,0,sizeof(header.ts));
+        header.caplen = buf_total_len(buf);
+        header.len = buf_total_len(buf);
+        memcpy(frame, buf->data, buf->len);
+        memcpy(frame + buf->len, buf->seg_data, buf->seg_len);
+        pcap_dump((u_char *)pdump,&header,frame);
+        return 0;
+}
+
+int driver_recv_batch(buf_t **bufs, int max)
+{
+        int n = 0, ret = 0;
+        while (n < max && (ret = driver_recv(bufs[n])) > 0)
+                n++;
+        return n == 0 && ret < 0 ? -1 : n;
+}
+
+int driver_send_batch(buf_t **bufs, int n)
+{
+        for (int i = 0; i < n; i++)
+                driver_send(bufs[i]);
+        return n;
+}
+
+int driver_get_fd()
+{
+        return -1;
+}
+
+int driver_set_mtu(int mtu)
+{
+        (void)mtu;
+        return 0;
+}
+
+void driver_close()
+{
+        fprintf(control_flow,"\ndriver closed\n");
+        pcap_dump_close(pdump);
+        pcap_close(pcap);
+}
@@ -1,59 +1,71 @@
-#include "udp.h"
-#include "ip.h"
-#include "icmp.h"
-#include <stdlib.h>
-#include <string.h>
-#include <stdio.h>
-
-extern FILE *udp_fin;
-extern FILE *udp_fout;
-char* print_ip(uint8_t *ip);
-void fprint_buf(FILE* f, buf_t* buf);
-
-void udp_in(buf_t *buf, uint8_t *src_ip)
-{
-        fprintf(udp_fout,"udp_in:\tsrc_ip:%s\n",print_ip(src_ip));
-        fprint_buf(udp_fout, buf);
-}
-
-void udp_out(buf_t *buf, uint16_t src_port, uint8_t *dest_ip, uint16_t dest_port)
-{
-        fprintf(udp_fout,"udp_out:\t");
-        fprintf(udp_fout,"src_port: %d\t", src_port);
-        fprintf(udp_fout,"dest_ip: %s\t", print_ip(dest_ip));
-        fprintf(udp_fout,"dest_port: %d\n", dest_port);
-        fprint_buf(udp_fout, buf);
-}
-
-void udp_init()
-{
-        fprintf(udp_fout,"udp_init\n");
-}
-
-int udp_open(uint16_t port, udp_handler_t handler)
-{
-        fprintf(udp_fout,"udp_open: port:%d\n",port);
-}
-
-void udp_close(uint16_t port)
-{
-        fprintf(udp_fout,"udp_close: port:%d\n",port);
-}
-
-
-void udp_send(uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dest_ip, uint16_t dest_port)
-{
-        fprintf(udp_fout,"udp_send: len:%d\t",len);
-        fprintf(udp_fout,"src_port:%d\t",src_port);
-        fprintf(udp_fout,"dest_ip:%s\t",print_ip(dest_ip));
-        fprintf(udp_fout,"dest_port:%d\n",dest_port);
-        fprintf(udp_fout,"\tdata:");
-        if(data){
-                for(int i = 0; i < len; i++){
-                        fprintf(udp_fout," %02x",data[i]);
-                }
-                fprintf(udp_fout,"\n");
-        }else{
-                fprintf(udp_fout," (null)\n");
-        }
+#include "udp.h"
+#include "ip.h"
+#include "icmp.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+extern FILE *udp_fin;
+extern FILE *udp_fout;
+char* print_ip(uint8_t *ip);
+void fprint_buf(FILE* f, buf_t* buf);
+
+void udp_in(buf_t *buf, uint8_t *src_ip)
+{
+        fprintf(udp_fout,"udp_in:\tsrc_ip:%s\n",print_ip(src_ip));
+        fprint_buf(udp_fout, buf);
+}
+
+int udp_early_demux(buf_t *buf, uint8_t **src_ip)
+{
+        return 0;
+}
+
+void udp_in_burst(buf_t **bufs, uint8_t **src_ips, int n)
+{
+        for(int i = 0; i < n; i++)
+                udp_in(bufs[i], src_ips[i]);
+}
+
+void udp_out(buf_t *buf, uint16_t src_port, uint8_t *dest_ip, uint16_t dest_port)
+{
+        fprintf(udp_fout,"udp_out:\t");
+        fprintf(udp_fout,"src_port: %d\t", src_port);
+        fprintf(udp_fout,"dest_ip: %s\t", print_ip(dest_ip));
+        fprintf(udp_fout,"dest_port: %d\n", dest_port);
+        fprint_buf(udp_fout, buf);
+}
+
+int udp_init()
+{
+        fprintf(udp_fout,"udp_init\n");
+        return 0;
+}
+
+int udp_open(uint16_t port, udp_handler_t handler)
+{
+        fprintf(udp_fout,"udp_open: port:%d\n",port);
+}
+
+void udp_close(uint16_t port)
+{
+        fprintf(udp_fout,"udp_close: port:%d\n",port);
+}
+
+
+void udp_send(uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dest_ip, uint16_t dest_port)
+{
+        fprintf(udp_fout,"udp_send: len:%d\t",len);
+        fprintf(udp_fout,"src_port:%d\t",src_port);
+        fprintf(udp_fout,"dest_ip:%s\t",print_ip(dest_ip));
+        fprintf(udp_fout,"dest_port:%d\n",dest_port);
+        fprintf(udp_fout,"\tdata:");
+        if(data){
+                for(int i = 0; i < len; i++){
+                        fprintf(udp_fout," %02x",data[i]);
+                }
+                fprintf(udp_fout,"\n");
+        }else{
+                fprintf(udp_fout," (null)\n");
+        }
 }
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "net.h"
+#include "ip.h"
+#include "icmp.h"
+#include "timer.h"
+
+extern FILE *control_flow;
+extern FILE *ip_fout;
+extern FILE *demo_log;
+extern FILE *out_log;
+extern uint64_t fake_clock_ms;
+
+int check_log();
+
+#define START_MS 5000ull // 时钟的起点
+
+static icmp_stats_t last; // 上一次输出时的计数
+static buf_t recv_buf;    // 触发差错报文的数据报，内容不影响限速
+
+/**
+ * @brief 把时钟推进到距起点ms毫秒处
+ *
+ */
+static void test_clock(uint64_t ms)
+{
+        fake_clock_ms = START_MS + ms;
+        timer_poll();
+}
+
+/**
+ * @brief 输出上一次输出之后发出和丢弃的差错报文数
+ *
+ */
+static void log_stats(const char *name)
+{
+        const icmp_stats_t *stats = icmp_get_stats();
+        fprintf(control_flow,"%s\tnow:%lu\tsent:%lu\tsuppressed:%lu\tsuppressed_src:%lu\n",name,
+                (unsigned long)(fake_clock_ms - START_MS),
+                (unsigned long)(stats->err_sent - last.err_sent),
+                (unsigned long)(stats->err_suppressed - last.err_suppressed),
+                (unsigned long)(stats->err_suppressed_src - last.err_suppressed_src));
+        last = *stats;
+}
+
+/**
+ * @brief 向一个源地址发送n个端口不可达，并输出计数
+ *
+ */
+static void test_send(const char *name, uint8_t *ip, int n)
+{
+        for(int i = 0; i < n; i++)
+                icmp_unreachable(&recv_buf, ip, ICMP_CODE_PORT_UNREACH);
+        log_stats(name);
+}
+
+/**
+ * @brief 依次向count个不同的源地址各发送一个端口不可达，每个地址的令牌桶都是满的
+ *
+ */
+static void test_sources(const char *name, int first, int count)
+{
+        uint8_t ip[NET_IP_LEN] = {10, 1, 0, 0};
+        for(int i = first; i < first + count; i++){
+                ip[2] = i >> 8;
+                ip[3] = i & 0xff;
+                icmp_unreachable(&recv_buf, ip, ICMP_CODE_PORT_UNREACH);
+        }
+        log_stats(name);
+}
+
+int main(){
+        uint8_t src[NET_IP_LEN] = {192, 168, 1, 7};
+        printf("\e[0;34mTest begin.\n");
+        control_flow = fopen("data/icmp_rate_test/log","w");
+        ip_fout = fopen("/dev/null","w"); // 只比较计数，不记录发出的报文
+        if(control_flow == 0 || ip_fout == 0){
+                if(control_flow) fclose(control_flow); else printf("\e[1;31mFailed to open log\n");
+                if(ip_fout) fclose(ip_fout); else printf("\e[1;31mFailed to open /dev/null\n");
+                return 0;
+        }
+        fake_clock_ms = START_MS;
+        icmp_init();
+        buf_init(&recv_buf, IP_HDR_LEN + 8);
+        memset(recv_buf.data, 0, recv_buf.len);
+
+        // 单个源地址：满桶ICMP_ERR_SRC_BURST个，之后每100毫秒补充一个
+        fprintf(control_flow,"\nRound 01 -----------------------------\n");
+        test_send("burst", src, ICMP_ERR_SRC_BURST + 5);
+        test_clock(50);
+        test_send("50ms", src, 1);
+        test_clock(100);
+        test_send("100ms", src, 2);
+        // 补充时不足一个令牌的余数留到下次：250毫秒补充一个后，300毫秒时又满100毫秒
+        test_clock(250);
+        test_send("250ms", src, 1);
+        test_clock(300);
+        test_send("300ms", src, 1);
+        test_clock(399);
+        test_send("399ms", src, 1);
+        // 空闲很久也只补满到桶容量
+        test_clock(10300);
+        test_send("idle", src, ICMP_ERR_SRC_BURST + 5);
+
+        // 全局令牌桶：不同源地址各自的桶都是满的，由全局的ICMP_ERR_BURST个兜底，之后每毫秒补充一个
+        fprintf(control_flow,"\nRound 02 -----------------------------\n");
+        test_clock(20000);
+        test_sources("global", 0, ICMP_ERR_BURST + 20);
+        test_clock(20010);
+        test_sources("10ms", 1000, 15);
+        test_clock(30000);
+        test_sources("idle", 2000, ICMP_ERR_BURST + 20);
+
+        // 重新初始化后两个桶都是满的
+        fprintf(control_flow,"\nRound 03 -----------------------------\n");
+        icmp_init();
+        memset(&last, 0, sizeof(last));
+        test_send("reinit", src, ICMP_ERR_SRC_BURST + 1);
+
+        printf("\e[0;34mErrors all sent, checking output\n");
+        fclose(control_flow);
+        fclose(ip_fout);
+
+        demo_log = fopen("data/icmp_rate_test/demo_log","r");
+        out_log = fopen("data/icmp_rate_test/log","r");
+        if(demo_log == 0 || out_log == 0){
+                if(demo_log) fclose(demo_log); else printf("\e[1;31mFailed to open demo_log\n");
+                if(out_log) fclose(out_log); else printf("\e[1;31mFailed to open log\n");
+                return 0;
+        }
+        check_log();
+        fclose(demo_log);
+        fclose(out_log);
+        return 0;
+}
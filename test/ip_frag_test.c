@@ -1,72 +1,153 @@
-#include <stdio.h>
-#include <string.h>
-
-#include "net.h"
-#include "ip.h"
-#include "utils.h"
-
-extern FILE *control_flow;
-extern FILE *arp_fout;
-
-buf_t buf;
-int main()
-{
-        FILE *in = fopen("data/ip_frag_test/in.txt","r");
-        control_flow = fopen("data/ip_frag_test/log","w");
-        if(in == 0 || control_flow == 0){
-                in && fclose(in);
-                control_flow && fclose(control_flow);
-                return 0;
-        }
-        arp_fout = control_flow;
-        char * p = buf.payload + 1000;
-        buf.data = p;
-        buf.len = 0;
-        char c;
-        while(fread(&c,1,1,in)){
-                *p = c;
-                p++;
-                buf.len++;
-        }
-        printf("\e[0;34mFeeding input.\n");
-        ip_out(&buf,net_if_ip,NET_PROTOCOL_TCP);
-
-        fclose(in);
-        fclose(control_flow);
-
-        FILE * demo = fopen("data/ip_frag_test/demo_log","r");
-        FILE * log = fopen("data/ip_frag_test/log","r");
-        int line = 1;
-        int column = 0;
-        int diff = 0;
-        char c1,c2;
-        printf("\e[0;34mComparing logs.\n");
-        while(fread(&c1,1,1,demo)){
-                column++;
-                if(fread(&c2,1,1,log) <= 0){
-                        printf("\e[0;31mLog file shorter than expected.\n");
-                        diff = 1;
-                        break;
-                }
-                if(c1 != c2){
-                        printf("\e[0;31mDifferent char found at line %d column %d.\n",line,column);
-                        diff = 1;
-                        break;
-                }
-                if(c1 == '\n'){
-                        line ++;
-                        column = 0;
-                }
-        }
-        if(diff == 0 && fread(&c2,1,1,log) == 1){
-                printf("\e[0;31mLog file longer than expected.\n");
-                diff = 1;
-        }
-        if(diff == 0){
-                printf("\e[1;32mLog file check passed\n");
-        }
-        fclose(log);
-        fclose(demo);
-        return 0;
-}
-
+#include <stdio.h>
+#include <string.h>
+#include <pcap.h>
+
+#include "net.h"
+#include "ethernet.h"
+#include "ip.h"
+#include "utils.h"
+#include "timer.h"
+
+#if IP_LOOPBACK
+#error "本测试检查向本机ip发送时的分片输出，须以IP_LOOPBACK=0编译(见CMakeLists.txt)"
+#endif
+
+extern FILE *control_flow;
+extern FILE *arp_fout;
+extern FILE *icmp_fout;
+extern FILE *udp_fout;
+extern FILE *demo_log;
+extern FILE *out_log;
+extern uint64_t fake_clock_ms;
+
+int check_log();
+
+/**
+ * @brief 分片重组测试
+ *        in.pcap中的分片按时间戳推进时钟后逐个交给ip_in()，
+ *        覆盖顺序、乱序、重叠、重复、与已知末尾矛盾的分片、超时以及占用内存超限时的淘汰，
+ *        重组出的数据报由udp faker记录到日志
+ * 
+ */
+static void reass_test()
+{
+        char errbuf[PCAP_ERRBUF_SIZE];
+        struct pcap_pkthdr *pkt_hdr;
+        const uint8_t *pkt_data;
+        FILE *in = fopen("data/ip_frag_test/in.pcap","r");
+        control_flow = fopen("data/ip_frag_test/reass_log","w");
+        if(in == 0 || control_flow == 0){
+                if(in) fclose(in); else printf("\e[1;31mFailed to open in.pcap\n");
+                if(control_flow) fclose(control_flow); else printf("\e[1;31mFailed to open reass_log\n");
+                return;
+        }
+        pcap_t *pcap = pcap_fopen_offline(in,errbuf);
+        if(pcap == 0){
+                fprintf(stderr,"\e[1;31mLoad in.pcap failed:%s\n",errbuf);
+                fclose(control_flow);
+                return;
+        }
+        icmp_fout = control_flow;
+        udp_fout = control_flow;
+        int i = 1;
+        printf("\e[0;34mFeeding fragments %02d",i);
+        while(pcap_next_ex(pcap,&pkt_hdr,&pkt_data) == 1){
+                printf("\b\b%02d",i);
+                fprintf(control_flow,"\nRound %02d -----------------------------\n",i++);
+                fake_clock_ms = (uint64_t)pkt_hdr->ts.tv_sec * 1000 + pkt_hdr->ts.tv_usec / 1000;
+                timer_poll();
+                buf_t *buf = buf_alloc(pkt_hdr->len);
+                memcpy(buf->data, pkt_data, pkt_hdr->len);
+                buf_remove_header(buf, sizeof(ether_hdr_t));
+                ip_hdr_t *ip_hdr = (ip_hdr_t *)buf->data;
+                fprintf(control_flow,"ip_in:\tid:%d\toffset:%d\tlen:%d\tmf:%d\ttime:%lu\n",
+                        swap16(ip_hdr->id),
+                        (swap16(ip_hdr->flags_fragment) & 0x1fff) * IP_HDR_OFFSET_PER_BYTE,
+                        swap16(ip_hdr->total_len) - (int)sizeof(ip_hdr_t),
+                        swap16(ip_hdr->flags_fragment) >> 13 & 1,
+                        (unsigned long)fake_clock_ms);
+                ip_in(buf);
+                buf_free(buf);
+        }
+        pcap_close(pcap);
+        fclose(control_flow);
+
+        printf("\e[0;34m\nFragments all processed, checking output\n");
+        demo_log = fopen("data/ip_frag_test/demo_reass_log","r");
+        out_log = fopen("data/ip_frag_test/reass_log","r");
+        if(demo_log == 0 || out_log == 0){
+                if(demo_log) fclose(demo_log); else printf("\e[1;31mFailed to open demo_reass_log\n");
+                if(out_log) fclose(out_log); else printf("\e[1;31mFailed to open reass_log\n");
+                return;
+        }
+        check_log();
+        fclose(demo_log);
+        fclose(out_log);
+}
+
+buf_t buf;
+int main()
+{
+        FILE *in = fopen("data/ip_frag_test/in.txt","r");
+        control_flow = fopen("data/ip_frag_test/log","w");
+        if(in == 0 || control_flow == 0){
+                in && fclose(in);
+                control_flow && fclose(control_flow);
+                return 0;
+        }
+        arp_fout = control_flow;
+        ip_init();
+        buf_init(&buf, 0);
+        char * p = buf.payload + 1000;
+        buf.data = p;
+        buf.len = 0;
+        char c;
+        while(fread(&c,1,1,in)){
+                *p = c;
+                p++;
+                buf.len++;
+        }
+        printf("\e[0;34mFeeding input.\n");
+        ip_out(&buf,net_if_ip,NET_PROTOCOL_TCP);
+
+        fclose(in);
+        fclose(control_flow);
+
+        FILE * demo = fopen("data/ip_frag_test/demo_log","r");
+        FILE * log = fopen("data/ip_frag_test/log","r");
+        int line = 1;
+        int column = 0;
+        int diff = 0;
+        char c1,c2;
+        printf("\e[0;34mComparing logs.\n");
+        while(fread(&c1,1,1,demo)){
+                column++;
+                if(fread(&c2,1,1,log) <= 0){
+                        printf("\e[0;31mLog file shorter than expected.\n");
+                        diff = 1;
+                        break;
+                }
+                if(c1 != c2){
+                        printf("\e[0;31mDifferent char found at line %d column %d.\n",line,column);
+                        diff = 1;
+                        break;
+                }
+                if(c1 == '\n'){
+                        line ++;
+                        column = 0;
+                }
+        }
+        if(diff == 0 && fread(&c2,1,1,log) == 1){
+                printf("\e[0;31mLog file longer than expected.\n");
+                diff = 1;
+        }
+        if(diff == 0){
+                printf("\e[1;32mLog file check passed\n");
+        }
+        fclose(log);
+        fclose(demo);
+
+        reass_test();
+        return 0;
+}
+
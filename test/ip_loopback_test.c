@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "net.h"
+#include "ip.h"
+#include "utils.h"
+
+#if !IP_LOOPBACK
+#error "本测试检查环回路径，须以IP_LOOPBACK=1编译(见CMakeLists.txt)"
+#endif
+
+extern FILE *control_flow;
+extern FILE *arp_fout;
+extern FILE *icmp_fout;
+extern FILE *udp_fout;
+extern FILE *demo_log;
+extern FILE *out_log;
+
+int check_log();
+
+/**
+ * @brief 发送一个数据报，数据为从first开始递增的字节
+ *        环回队列持有自己的引用，发送后立即释放也不影响接收
+ *
+ */
+static void test_send(uint8_t *ip, net_protocol_t protocol, int len, uint8_t first)
+{
+        buf_t *buf = buf_alloc(len);
+        for(int i = 0; i < len; i++)
+                buf->data[i] = first + i;
+        ip_out(buf, ip, protocol);
+        buf_free(buf);
+}
+
+/**
+ * @brief 处理环回队列，记录交给接收方的数据报数
+ *
+ */
+static void test_poll(int budget)
+{
+        fprintf(control_flow,"ip_loopback_poll:\tbudget:%d\n",budget);
+        fprintf(control_flow,"delivered:\t%d\n",ip_loopback_poll(budget));
+}
+
+int main()
+{
+        uint8_t peer[NET_IP_LEN];
+        FILE *null;
+        printf("\e[0;34mTest begin.\n");
+        control_flow = fopen("data/ip_loopback_test/log","w");
+        null = fopen("/dev/null","w");
+        if(control_flow == 0 || null == 0){
+                if(control_flow) fclose(control_flow); else printf("\e[1;31mFailed to open log\n");
+                if(null) fclose(null); else printf("\e[1;31mFailed to open /dev/null\n");
+                return 0;
+        }
+        arp_fout = control_flow;
+        icmp_fout = control_flow;
+        udp_fout = control_flow;
+        ip_init();
+        memcpy(peer, net_if_ip, NET_IP_LEN);
+        peer[3]++;
+
+        // 发给本机的数据报不经过arp，放入环回队列，轮询时按顺序交给上层，受budget限制
+        fprintf(control_flow,"\nRound 01 -----------------------------\n");
+        test_send(net_if_ip, NET_PROTOCOL_UDP, 8, 0x10);
+        test_send(net_if_ip, NET_PROTOCOL_UDP, 8, 0x20);
+        test_send(net_if_ip, NET_PROTOCOL_ICMP, 8, 0x30);
+        test_poll(2);
+        test_poll(NET_POLL_BUDGET);
+        test_poll(NET_POLL_BUDGET);
+
+        // 超过MTU的数据报在环回路径上不分片
+        fprintf(control_flow,"\nRound 02 -----------------------------\n");
+        test_send(net_if_ip, NET_PROTOCOL_UDP, ETHERNET_MTU + 100, 0);
+        test_poll(NET_POLL_BUDGET);
+
+        // 发给其他地址的数据报仍经过arp，不进环回队列
+        fprintf(control_flow,"\nRound 03 -----------------------------\n");
+        test_send(peer, NET_PROTOCOL_UDP, 8, 0x40);
+        test_poll(NET_POLL_BUDGET);
+
+        // 队列满时丢弃，不影响已经排队的数据报
+        fprintf(control_flow,"\nRound 04 -----------------------------\n");
+        udp_fout = null; // 只记录数量
+        for(int i = 0; i < IP_LOOPBACK_QUEUE + 3; i++)
+                test_send(net_if_ip, NET_PROTOCOL_UDP, 8, i);
+        test_poll(IP_LOOPBACK_QUEUE * 2);
+        udp_fout = control_flow;
+        test_send(net_if_ip, NET_PROTOCOL_UDP, 8, 0x50);
+        test_poll(NET_POLL_BUDGET);
+
+        printf("\e[0;34mDatagrams all delivered, checking output\n");
+        fclose(control_flow);
+        fclose(null);
+
+        demo_log = fopen("data/ip_loopback_test/demo_log","r");
+        out_log = fopen("data/ip_loopback_test/log","r");
+        if(demo_log == 0 || out_log == 0){
+                if(demo_log) fclose(demo_log); else printf("\e[1;31mFailed to open demo_log\n");
+                if(out_log) fclose(out_log); else printf("\e[1;31mFailed to open log\n");
+                return 0;
+        }
+        check_log();
+        fclose(demo_log);
+        fclose(out_log);
+        return 0;
+}
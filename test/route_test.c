@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "net.h"
+#include "route.h"
+#include "timer.h"
+
+extern FILE *control_flow;
+extern FILE *demo_log;
+extern FILE *out_log;
+extern uint64_t fake_clock_ms;
+
+char* print_ip(uint8_t *ip);
+int check_log();
+
+typedef struct route_case
+{
+        uint8_t ip[NET_IP_LEN];   // 目的地址
+        uint8_t dest[NET_IP_LEN]; // 应该匹配的路由的目的网络
+        int prefix_len;           // 应该匹配的路由的前缀长度
+        int mtu;                  // route_mtu应该返回的MTU，为0时不检查
+} route_case_t;
+
+typedef struct route_spec
+{
+        uint8_t dest[NET_IP_LEN];
+        int prefix_len;
+        uint8_t gateway[NET_IP_LEN];
+        uint16_t mtu;
+} route_spec_t;
+
+// 前缀长度跨过trie每层8位的边界，按打乱的顺序添加，较长的前缀总是优先
+static const route_spec_t routes[] = {
+        {{10, 129, 5, 77},  32, {1, 1, 1, 32}, 1300},
+        {{10, 128, 0, 0},   9,  {1, 1, 1, 9},  0},
+        {{10, 0, 0, 0},     7,  {1, 1, 1, 7},  0},
+        {{10, 129, 5, 0},   24, {1, 1, 1, 24}, 1400},
+        {{10, 0, 0, 0},     8,  {1, 1, 1, 8},  0},
+        {{11, 22, 33, 0},   24, {0, 0, 0, 0},  0},
+        {{172, 16, 0, 0},   12, {1, 1, 1, 12}, 0},
+        {{172, 17, 128, 0}, 17, {1, 1, 1, 17}, 0},
+};
+
+static const route_case_t lookup_cases[] = {
+        {{10, 1, 2, 3},       {10, 0, 0, 0},     8,  0},
+        {{10, 127, 255, 255}, {10, 0, 0, 0},     8,  0},
+        {{10, 200, 0, 1},     {10, 128, 0, 0},   9,  0},
+        {{10, 129, 6, 1},     {10, 128, 0, 0},   9,  0},
+        {{10, 129, 5, 1},     {10, 129, 5, 0},   24, 0},
+        {{10, 129, 5, 78},    {10, 129, 5, 0},   24, 0},
+        {{10, 129, 5, 77},    {10, 129, 5, 77},  32, 0},
+        {{11, 0, 0, 1},       {10, 0, 0, 0},     7,  0},
+        {{11, 22, 33, 44},    {11, 22, 33, 0},   24, 0},
+        {{11, 22, 34, 44},    {10, 0, 0, 0},     7,  0},
+        {{12, 0, 0, 1},       {0, 0, 0, 0},      0,  0},
+        {{9, 255, 255, 255},  {0, 0, 0, 0},      0,  0},
+        {{172, 17, 200, 1},   {172, 17, 128, 0}, 17, 0},
+        {{172, 17, 100, 1},   {172, 16, 0, 0},   12, 0},
+        {{172, 32, 0, 1},     {0, 0, 0, 0},      0,  0},
+        {{192, 168, 133, 7},  {192, 168, 133, 0}, 24, 0},
+};
+
+// 删除/32和/9之后，缓存中的旧结果必须失效
+static const route_case_t del_cases[] = {
+        {{10, 129, 5, 77},    {10, 129, 5, 0},   24, 0},
+        {{10, 200, 0, 1},     {10, 0, 0, 0},     8,  0},
+        {{10, 129, 6, 1},     {10, 0, 0, 0},     8,  0},
+        {{10, 129, 5, 1},     {10, 129, 5, 0},   24, 0},
+        {{11, 0, 0, 1},       {10, 0, 0, 0},     7,  0},
+        {{172, 17, 200, 1},   {172, 17, 128, 0}, 17, 0},
+};
+
+// 取网卡MTU、路由MTU和路径MTU中最小的一个
+static const route_case_t mtu_cases[] = {
+        {{10, 1, 2, 3},       {10, 0, 0, 0},     8,  1500},
+        {{10, 129, 5, 1},     {10, 129, 5, 0},   24, 1400},
+        {{10, 129, 5, 77},    {10, 129, 5, 77},  32, 1300},
+};
+
+// route_pmtu_update()之后
+static const route_case_t pmtu_cases[] = {
+        {{10, 1, 2, 3},       {10, 0, 0, 0},     8,  1200},
+        {{10, 1, 2, 4},       {10, 0, 0, 0},     8,  1500},
+        {{10, 129, 5, 1},     {10, 129, 5, 0},   24, PMTU_MIN},
+        {{10, 129, 5, 77},    {10, 129, 5, 77},  32, 1300},
+};
+
+// 网卡MTU调小到1100之后
+static const route_case_t if_mtu_cases[] = {
+        {{10, 1, 2, 3},       {10, 0, 0, 0},     8,  1100},
+        {{10, 1, 2, 4},       {10, 0, 0, 0},     8,  1100},
+        {{10, 129, 5, 1},     {10, 129, 5, 0},   24, PMTU_MIN},
+};
+
+// 路径MTU过期之后
+static const route_case_t expired_cases[] = {
+        {{10, 1, 2, 3},       {10, 0, 0, 0},     8,  1500},
+        {{10, 129, 5, 1},     {10, 129, 5, 0},   24, 1400},
+};
+
+/**
+ * @brief 逐个查找路由，与预期的前缀和MTU比较，结果写入日志
+ *
+ */
+static void run_cases(const route_case_t *cases, int n)
+{
+        for(int i = 0; i < n; i++){
+                const route_case_t *c = &cases[i];
+                const route_t *route = route_lookup(c->ip);
+                int ok, mtu = 0;
+                fprintf(control_flow,"lookup:\t%s\t",print_ip((uint8_t *)c->ip));
+                if(route == NULL){
+                        fprintf(control_flow,"-> (null)\tWRONG\n");
+                        continue;
+                }
+                ok = route->prefix_len == c->prefix_len && memcmp(route->dest, c->dest, NET_IP_LEN) == 0;
+                fprintf(control_flow,"-> %s/%d\t",print_ip((uint8_t *)route->dest),route->prefix_len);
+                fprintf(control_flow,"next hop: %s\t",print_ip((uint8_t *)route_next_hop(route, c->ip)));
+                if(c->mtu){
+                        mtu = route_mtu(route, c->ip);
+                        ok = ok && mtu == c->mtu;
+                        fprintf(control_flow,"mtu: %d\t",mtu);
+                }
+                fprintf(control_flow,"%s\n",ok ? "ok" : "WRONG");
+        }
+}
+
+#define RUN_CASES(cases) run_cases(cases, sizeof(cases) / sizeof(cases[0]))
+
+int main(){
+        printf("\e[0;34mTest begin.\n");
+        control_flow = fopen("data/route_test/log","w");
+        if(control_flow == 0){
+                printf("\e[1;31mFailed to open log\n");
+                return 0;
+        }
+        timer_init();
+        route_init();
+
+        fprintf(control_flow,"\nRound 01 -----------------------------\n");
+        for(size_t i = 0; i < sizeof(routes) / sizeof(routes[0]); i++){
+                const route_spec_t *r = &routes[i];
+                fprintf(control_flow,"route_add:\t%s/%d\t%d\n",print_ip((uint8_t *)r->dest),r->prefix_len,
+                        route_add(r->dest, r->prefix_len, r->gateway, r->mtu));
+        }
+        RUN_CASES(lookup_cases);
+        // 第二遍命中路由缓存
+        RUN_CASES(lookup_cases);
+
+        fprintf(control_flow,"\nRound 02 -----------------------------\n");
+        fprintf(control_flow,"route_del:\t10.129.5.77/32\t%d\n",route_del(routes[0].dest, 32));
+        fprintf(control_flow,"route_del:\t10.128.0.0/9\t%d\n",route_del(routes[1].dest, 9));
+        fprintf(control_flow,"route_del:\t10.128.0.0/9\t%d\n",route_del(routes[1].dest, 9));
+        RUN_CASES(del_cases);
+        // 重新添加，并把/8的网关换掉
+        uint8_t gateway[NET_IP_LEN] = {2, 2, 2, 8};
+        fprintf(control_flow,"route_add:\t10.129.5.77/32\t%d\n",route_add(routes[0].dest, 32, routes[0].gateway, routes[0].mtu));
+        fprintf(control_flow,"route_add:\t10.128.0.0/9\t%d\n",route_add(routes[1].dest, 9, routes[1].gateway, routes[1].mtu));
+        fprintf(control_flow,"route_add:\t10.1.2.3/8\t%d\n",route_add(lookup_cases[0].ip, 8, gateway, 0));
+        RUN_CASES(lookup_cases);
+
+        fprintf(control_flow,"\nRound 03 -----------------------------\n");
+        RUN_CASES(mtu_cases);
+        route_pmtu_update(mtu_cases[0].ip, 1200);
+        route_pmtu_update(mtu_cases[1].ip, 1450); // 不小于路由MTU，忽略
+        route_pmtu_update(mtu_cases[1].ip, 1000);
+        route_pmtu_update(mtu_cases[1].ip, 100);  // 按PMTU_MIN记录
+        route_pmtu_update(mtu_cases[2].ip, 1350); // 不小于路由MTU，忽略
+        RUN_CASES(pmtu_cases);
+        net_stack->if_mtu = 1100;
+        RUN_CASES(if_mtu_cases);
+        net_stack->if_mtu = ETHERNET_MTU;
+        fake_clock_ms += PMTU_TIMEOUT_SEC * 1000;
+        timer_poll();
+        RUN_CASES(expired_cases);
+
+        printf("\e[0;34mLookups all processed, checking output\n");
+        fclose(control_flow);
+
+        demo_log = fopen("data/route_test/demo_log","r");
+        out_log = fopen("data/route_test/log","r");
+        if(demo_log == 0 || out_log == 0){
+                if(demo_log) fclose(demo_log); else printf("\e[1;31mFailed to open demo_log\n");
+                if(out_log) fclose(out_log); else printf("\e[1;31mFailed to open log\n");
+                return 0;
+        }
+        check_log();
+        fclose(demo_log);
+        fclose(out_log);
+        return 0;
+}
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "net.h"
+#include "timer.h"
+
+extern FILE *control_flow;
+extern FILE *demo_log;
+extern FILE *out_log;
+extern uint64_t fake_clock_ms;
+
+int check_log();
+
+#define START_MS 12345678ull // 时钟的起点，不与任何一层的槽对齐
+
+typedef struct test_timer
+{
+        timer_entry_t entry;
+        const char *name;
+        uint64_t expect;  // 应该到期的时间(毫秒)
+} test_timer_t;
+
+static int fired;
+static uint64_t last_poll = START_MS; // 上一次轮询的时间
+
+/**
+ * @brief 定时器必须在到期后的第一次轮询中处理
+ *
+ */
+static void test_handler(void *arg)
+{
+        test_timer_t *t = arg;
+        int on_time = last_poll < t->expect && t->expect <= timer_now();
+        fprintf(control_flow,"fired:\t%s\tnow:%lu\t%s\n",t->name,
+                (unsigned long)(timer_now() - START_MS),on_time ? "on time" : "WRONG TIME");
+        fired++;
+}
+
+/**
+ * @brief 启动定时器，记下按tick向上取整后应该到期的时间
+ *
+ */
+static void test_add(test_timer_t *t, const char *name, uint32_t delay_ms)
+{
+        t->name = name;
+        t->expect = (timer_now() + delay_ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS * TIMER_TICK_MS;
+        timer_add(&t->entry, delay_ms, test_handler, t);
+}
+
+/**
+ * @brief 把时钟推进到距起点ms毫秒处并处理到期的定时器
+ *
+ */
+static void test_poll(uint64_t ms)
+{
+        fake_clock_ms = START_MS + ms;
+        fired = 0;
+        int n = timer_poll();
+        last_poll = fake_clock_ms;
+        fprintf(control_flow,"poll:\t%lu\texpired:%d\n",(unsigned long)ms,n);
+        if(n != fired)
+                fprintf(control_flow,"WRONG COUNT:\t%d\n",fired);
+}
+
+/**
+ * @brief 在到期前一个tick和到期时各轮询一次，定时器只能在后一次到期
+ *
+ */
+static void test_expire(test_timer_t *t)
+{
+        test_poll(t->expect - TIMER_TICK_MS - START_MS);
+        test_poll(t->expect - START_MS);
+}
+
+static test_timer_t timers[16];
+
+int main(){
+        printf("\e[0;34mTest begin.\n");
+        control_flow = fopen("data/timer_test/log","w");
+        if(control_flow == 0){
+                printf("\e[1;31mFailed to open log\n");
+                return 0;
+        }
+        fake_clock_ms = START_MS;
+        timer_init();
+
+        // 第0层：到期时间向上取整到tick，0毫秒在下一个tick到期
+        fprintf(control_flow,"\nRound 01 -----------------------------\n");
+        test_add(&timers[0], "0ms", 0);
+        test_add(&timers[1], "15ms", 15);
+        test_add(&timers[2], "2550ms", 2550);
+        test_poll(0);
+        test_expire(&timers[1]);
+        test_expire(&timers[2]);
+
+        // 在各层之间迁移：第0层一圈为256个tick，第1层一圈为2^14个tick，第2层一圈为2^20个tick
+        fprintf(control_flow,"\nRound 02 -----------------------------\n");
+        test_add(&timers[3], "level0+1", 2570);
+        test_add(&timers[4], "level1-1", 163830);
+        test_add(&timers[5], "level1", 163840);
+        test_add(&timers[6], "level1+1", 163850);
+        test_add(&timers[7], "level2", 10485760);
+        test_add(&timers[8], "level2+1", 10485770);
+        test_add(&timers[9], "level2*13", 136314880);
+        for(int i = 3; i <= 9; i++)
+                test_expire(&timers[i]);
+
+        // 超出时间轮范围的定时器先放在最远的槽，迁移时重新计算，不会提前到期
+        fprintf(control_flow,"\nRound 03 -----------------------------\n");
+        test_add(&timers[10], "max", UINT32_MAX);
+        test_add(&timers[11], "wheel", 671088630);
+        test_expire(&timers[11]);
+        test_expire(&timers[10]);
+
+        // 停止尚未到期的定时器，重新启动正在计时的定时器
+        fprintf(control_flow,"\nRound 04 -----------------------------\n");
+        uint64_t base = timer_now() - START_MS;
+        test_add(&timers[0], "kept", 100);
+        test_add(&timers[1], "deleted", 100);
+        test_add(&timers[2], "deleted upper", 5000000);
+        test_add(&timers[3], "restarted", 50);
+        timer_del(&timers[1].entry);
+        timer_del(&timers[2].entry);
+        timer_del(&timers[2].entry);
+        timer_del(&timers[12].entry);
+        test_add(&timers[3], "restarted", 200);
+        test_poll(base + 100);
+        test_expire(&timers[3]);
+        test_poll(base + 5000000);
+        fprintf(control_flow,"stopped:\t%d %d %d %d\n",timers[0].entry.pprev == NULL,timers[1].entry.pprev == NULL,
+                timers[2].entry.pprev == NULL,timers[3].entry.pprev == NULL);
+
+        // 空闲时的等待时间：看到第0层下一次迁移之前最近的定时器
+        fprintf(control_flow,"\nRound 05 -----------------------------\n");
+        base = timer_now() - START_MS;
+        fprintf(control_flow,"next:\tempty\t%d\n",timer_next_ms());
+        test_add(&timers[0], "near", 50);
+        test_add(&timers[1], "far", 100000);
+        fprintf(control_flow,"next:\tnear\t%d\n",timer_next_ms());
+        test_poll(base + 25);
+        fprintf(control_flow,"next:\tnear-25\t%d\n",timer_next_ms());
+        test_poll(base + 50);
+        fprintf(control_flow,"next:\tfar\t%d\n",timer_next_ms());
+        test_expire(&timers[1]);
+        fprintf(control_flow,"next:\tempty\t%d\n",timer_next_ms());
+
+        printf("\e[0;34mTimers all processed, checking output\n");
+        fclose(control_flow);
+
+        demo_log = fopen("data/timer_test/demo_log","r");
+        out_log = fopen("data/timer_test/log","r");
+        if(demo_log == 0 || out_log == 0){
+                if(demo_log) fclose(demo_log); else printf("\e[1;31mFailed to open demo_log\n");
+                if(out_log) fclose(out_log); else printf("\e[1;31mFailed to open log\n");
+                return 0;
+        }
+        check_log();
+        fclose(demo_log);
+        fclose(out_log);
+        return 0;
+}
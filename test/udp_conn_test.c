@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "net.h"
+#include "driver.h"
+#include "ethernet.h"
+#include "arp.h"
+#include "ip.h"
+#include "udp.h"
+#include "route.h"
+#include "timer.h"
+
+extern FILE *control_flow;
+extern FILE *icmp_fout;
+extern FILE *demo_log;
+extern FILE *out_log;
+extern uint64_t fake_clock_ms;
+
+int check_log();
+
+#if DRIVER_TX_OFFLOAD
+#define TEST_LOG "data/udp_conn_test/offload_log"
+#define TEST_DEMO_LOG "data/udp_conn_test/demo_offload_log"
+#else
+#define TEST_LOG "data/udp_conn_test/log"
+#define TEST_DEMO_LOG "data/udp_conn_test/demo_log"
+#endif
+
+#define FRAME_MAX 8      // 一个用例两种方式最多发出的数据帧数
+#define PAYLOAD_MAX 3000 // 最长的数据
+
+typedef struct frame
+{
+        int len;
+        uint8_t data[BUF_MAX_LEN];
+} frame_t;
+
+static frame_t frames[FRAME_MAX]; // 驱动收到的数据帧，先是udp_send()的，后是udp_conn_send()的
+static int frame_nr;
+static uint8_t payload[PAYLOAD_MAX];
+
+/**
+ * @brief 链接时加-Wl,--wrap=driver_open等，驱动不打开文件，发出的数据帧留在内存中比较
+ *
+ */
+int __wrap_driver_open()
+{
+        return 0;
+}
+
+int __wrap_driver_send(buf_t *buf)
+{
+        if(frame_nr < FRAME_MAX){
+                frames[frame_nr].len = buf_total_len(buf);
+                memcpy(frames[frame_nr].data, buf->data, buf->len);
+                memcpy(frames[frame_nr].data + buf->len, buf->seg_data, buf->seg_len);
+        }
+        frame_nr++;
+        return 0;
+}
+
+int __wrap_driver_send_batch(buf_t **bufs, int n)
+{
+        for(int i = 0; i < n; i++)
+                __wrap_driver_send(bufs[i]);
+        return n;
+}
+
+/**
+ * @brief 把udp_send()发出的数据帧的ip标识改为udp_conn_send()发出的，并重新计算首部校验和
+ *        两次发送各自分配标识，其余字节必须完全相同
+ *
+ */
+static void frame_fix_id(frame_t *ref, const frame_t *conn)
+{
+        ip_hdr_t *ref_hdr = (ip_hdr_t *)(ref->data + sizeof(ether_hdr_t));
+        const ip_hdr_t *conn_hdr = (const ip_hdr_t *)(conn->data + sizeof(ether_hdr_t));
+        if(ref->len < (int)(sizeof(ether_hdr_t) + sizeof(ip_hdr_t)) || conn->len < (int)(sizeof(ether_hdr_t) + sizeof(ip_hdr_t)))
+                return;
+        ref_hdr->id = conn_hdr->id;
+        ref_hdr->hdr_checksum = 0;
+        ref_hdr->hdr_checksum = checksum_data((uint8_t *)ref_hdr, ref_hdr->hdr_len * IP_HDR_LEN_PER_BYTE);
+}
+
+/**
+ * @brief 用udp_send()和udp_conn_send()发送同样的数据，逐字节比较发出的数据帧，结果写入日志
+ *
+ */
+static void test_case(const char *name, udp_conn_t *conn, int len)
+{
+        int ref_nr, diff = -1, frame = 0;
+        frame_nr = 0;
+        udp_send(payload, len, conn->src_port, conn->dest_ip, conn->dest_port);
+        ref_nr = frame_nr;
+        udp_conn_send(conn, payload, len);
+        fprintf(control_flow,"%s\tlen:%d\tframes:%d/%d\t",name,len,ref_nr,frame_nr - ref_nr);
+        if(frame_nr > FRAME_MAX || ref_nr * 2 != frame_nr){
+                fprintf(control_flow,"WRONG COUNT\n");
+                return;
+        }
+        for(frame = 0; frame < ref_nr && diff == -1; frame++){
+                frame_t *ref = &frames[frame], *out = &frames[ref_nr + frame];
+                frame_fix_id(ref, out);
+                if(ref->len != out->len)
+                        diff = ref->len < out->len ? ref->len : out->len;
+                for(int i = 0; i < ref->len && i < out->len && diff == -1; i++)
+                        if(ref->data[i] != out->data[i])
+                                diff = i;
+        }
+        if(diff == -1)
+                fprintf(control_flow,"same\n");
+        else
+                fprintf(control_flow,"WRONG: frame %d byte %d\n",frame - 1,diff);
+}
+
+/**
+ * @brief 调整数据最后两个字节，使udp校验和的计算结果为0，发送时应改为全1
+ *
+ */
+static void make_zero_checksum(udp_conn_t *conn, int len)
+{
+        uint8_t pseudo[12 + 8] = {0}; // 伪头部和校验和为0的udp报头
+        uint32_t sum;
+        memcpy(pseudo, net_if_ip, NET_IP_LEN);
+        memcpy(pseudo + 4, conn->dest_ip, NET_IP_LEN);
+        pseudo[9] = NET_PROTOCOL_UDP;
+        pseudo[10] = pseudo[16] = (8 + len) >> 8;
+        pseudo[11] = pseudo[17] = (8 + len) & 0xff;
+        pseudo[12] = conn->src_port >> 8;
+        pseudo[13] = conn->src_port & 0xff;
+        pseudo[14] = conn->dest_port >> 8;
+        pseudo[15] = conn->dest_port & 0xff;
+        for(int x = 0; x <= UINT16_MAX; x++){
+                payload[len - 2] = x >> 8;
+                payload[len - 1] = x & 0xff;
+                sum = checksum_add(payload, len, checksum_add(pseudo, sizeof(pseudo), 0));
+                if(checksum_fold(sum) == 0)
+                        return;
+        }
+}
+
+int main(){
+        uint8_t peer[NET_IP_LEN], gateway[NET_IP_LEN], far[NET_IP_LEN] = {10, 20, 30, 40}, net10[NET_IP_LEN] = {10, 0, 0, 0};
+        uint8_t peer_mac[NET_MAC_LEN] = {0x02, 0x11, 0x22, 0x33, 0x44, 0x55};
+        uint8_t gateway_mac[NET_MAC_LEN] = {0x02, 0x66, 0x77, 0x88, 0x99, 0xaa};
+        udp_conn_t *conn, *far_conn, *local_conn;
+        printf("\e[0;34mTest begin.\n");
+        control_flow = fopen(TEST_LOG,"w");
+        if(control_flow == 0){
+                printf("\e[1;31mFailed to open log\n");
+                return 0;
+        }
+        icmp_fout = control_flow;
+        if(ethernet_init() || arp_init() || ip_init() || udp_init()){
+                fprintf(stderr,"\e[1;31mInit failed,exiting\n");
+                fclose(control_flow);
+                return 0;
+        }
+        memcpy(peer, net_if_ip, NET_IP_LEN);
+        peer[3]++;
+        memcpy(gateway, net_if_ip, NET_IP_LEN);
+        gateway[3] = 1;
+        route_add(net10, 8, gateway, 1000);
+        arp_update(peer, peer_mac, ARP_VALID);
+        arp_update(gateway, gateway_mac, ARP_VALID);
+        for(int i = 0; i < PAYLOAD_MAX; i++)
+                payload[i] = i * 7 + 3;
+        conn = udp_connect(60000, peer, 4321);
+        far_conn = udp_connect(60001, far, 53);
+        local_conn = udp_connect(60002, net_if_ip, 60000);
+
+        // 报头模板：奇偶长度，udp长度的高低字节都不为0，累加和中长度出现两次
+        fprintf(control_flow,"\nRound 01 -----------------------------\n");
+        test_case("empty", conn, 0);
+        test_case("odd", conn, 1);
+        test_case("small", conn, 18);
+        test_case("low byte", conn, 255 - 8);
+        test_case("high byte", conn, 256 - 8);
+        test_case("odd large", conn, 1001);
+        test_case("mtu", conn, ETHERNET_MTU - 28);
+
+        // 校验和的计算结果为0时两种方式都发送全1(卸载时只填伪头部校验和，不受影响)
+        fprintf(control_flow,"\nRound 02 -----------------------------\n");
+        make_zero_checksum(conn, 64);
+        test_case("zero sum", conn, 64);
+        make_zero_checksum(conn, 333);
+        test_case("zero sum odd", conn, 333);
+        for(int i = 0; i < PAYLOAD_MAX; i++)
+                payload[i] = i * 7 + 3;
+
+        // 超过MTU时按udp_send()发送
+        fprintf(control_flow,"\nRound 03 -----------------------------\n");
+        test_case("mtu+1", conn, ETHERNET_MTU - 28 + 1);
+        test_case("large", conn, PAYLOAD_MAX);
+
+        // 经过网关且路由MTU较小
+        fprintf(control_flow,"\nRound 04 -----------------------------\n");
+        test_case("gateway", far_conn, 500);
+        test_case("route mtu", far_conn, 1000 - 28);
+        test_case("route mtu+1", far_conn, 1000 - 28 + 1);
+
+        // 缓存的mac地址过期后重新查找
+        fprintf(control_flow,"\nRound 05 -----------------------------\n");
+        peer_mac[5] = 0x56;
+        arp_update(peer, peer_mac, ARP_VALID);
+        fake_clock_ms += UDP_CONN_REFRESH_MS;
+        timer_poll();
+        test_case("refreshed", conn, 100);
+
+        // 发往本机时走环回，不经过驱动
+        fprintf(control_flow,"\nRound 06 -----------------------------\n");
+        test_case("local", local_conn, 100);
+
+        udp_disconnect(conn);
+        udp_disconnect(far_conn);
+        udp_disconnect(local_conn);
+        printf("\e[0;34mDatagrams all sent, checking output\n");
+        fclose(control_flow);
+
+        demo_log = fopen(TEST_DEMO_LOG,"r");
+        out_log = fopen(TEST_LOG,"r");
+        if(demo_log == 0 || out_log == 0){
+                if(demo_log) fclose(demo_log); else printf("\e[1;31mFailed to open demo_log\n");
+                if(out_log) fclose(out_log); else printf("\e[1;31mFailed to open log\n");
+                return 0;
+        }
+        check_log();
+        fclose(demo_log);
+        fclose(out_log);
+        return 0;
+}